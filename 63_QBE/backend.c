@@ -0,0 +1,32 @@
+#include "defs.h"
+#include "data.h"
+#include "decl.h"
+
+// Choose the code generator for each operation
+// Copyright (c) 2019 Warren Toomey, GPL3
+
+// The rest of the compiler calls the cgxxx() functions made
+// here from the list in backend.h. Each one calls qbexxx() in
+// cg.c, or x64xxx() in cgx64.c once -O0 has set O_x64 in main.c.
+// cwj can't call through a function pointer, so this list
+// stands in for a table of them, and this is the only place
+// which looks at O_x64 to choose the code generator.
+/*编译器的其余部分调用这里根据 backend.h 中的列表生成的 cgxxx() 函数。每个函数调用 cg.c 中的 qbexxx()，
+或者在 main.c 因 -O0 置位 O_x64 后调用 cgx64.c 中的 x64xxx()。cwj 不能通过函数指针调用，
+所以用这个列表代替函数指针表，这里也是唯一根据 O_x64 选择代码生成器的地方。*/
+
+#define CGOP(type, name, params, args) \
+  type cg##name params { \
+    if (O_x64) \
+      return (x64##name args); \
+    return (qbe##name args); \
+  }
+#define CGVOP(name, params, args) \
+  void cg##name params { \
+    if (O_x64) { \
+      x64##name args; \
+      return; \
+    } \
+    qbe##name args; \
+  }
+#include "backend.h"
@@ -0,0 +1,62 @@
+// The operations of the code generator
+// Copyright (c) 2019 Warren Toomey, GPL3
+
+// Each operation is listed once here. CGOP() is an operation
+// which returns a value of the given type, CGVOP() one which
+// returns nothing. The parameters are given with their types
+// and then as the arguments which pass them on. Define these
+// two macros before including this file: backend.c makes the
+// cgxxx() functions from them and decl.h the prototypes of the
+// cgxxx(), qbexxx() and x64xxx() functions.
+/*代码生成器的每个操作都在这里列出一次。CGOP() 是返回给定类型值的操作，CGVOP() 是没有返回值的操作。
+参数先带类型给出，然后作为传递它们的实参给出。包含本文件之前先定义这两个宏：
+backend.c 用它们生成 cgxxx() 函数，decl.h 用它们声明 cgxxx()、qbexxx() 和 x64xxx() 函数的原型。*/
+
+CGVOP(preamble, (char *filename), (filename))
+CGVOP(funcpreamble, (struct symtable *sym), (sym))
+CGVOP(funcpostamble, (struct symtable *sym), (sym))
+CGOP(int, loadint, (int value, int type), (value, type))
+CGOP(int, loadvar, (struct symtable *sym, int op), (sym, op))
+CGOP(int, loadglobstr, (int label), (label))
+CGOP(int, add, (int r1, int r2, int type), (r1, r2, type))
+CGOP(int, sub, (int r1, int r2, int type), (r1, r2, type))
+CGOP(int, mul, (int r1, int r2, int type), (r1, r2, type))
+CGOP(int, divmod, (int r1, int r2, int op, int type), (r1, r2, op, type))
+CGOP(int, shlconst, (int r, int val, int type), (r, val, type))
+CGOP(int, call, (struct symtable *sym, int numargs, int *arglist,
+		 int *typelist), (sym, numargs, arglist, typelist))
+CGOP(int, storglob, (int r, struct symtable *sym), (r, sym))
+CGOP(int, storlocal, (int r, struct symtable *sym), (r, sym))
+CGVOP(globsym, (struct symtable *node), (node))
+CGVOP(globstr, (int l, char *strvalue, int append), (l, strvalue, append))
+CGVOP(globstrend, (void), ())
+CGOP(int, compare_and_set, (int ASTop, int r1, int r2, int type),
+     (ASTop, r1, r2, type))
+CGOP(int, compare_and_jump, (int ASTop, int r1, int r2, int label,
+			     int type), (ASTop, r1, r2, label, type))
+CGVOP(compare_and_branch, (int ASTop, int r1, int r2, int Ltrue,
+			   int Lfalse, int type),
+      (ASTop, r1, r2, Ltrue, Lfalse, type))
+CGVOP(branch, (int r, int Ltrue, int Lfalse, int type),
+      (r, Ltrue, Lfalse, type))
+CGOP(int, range_and_jump, (int r, int lo, int hi, int label, int type),
+     (r, lo, hi, label, type))
+CGVOP(label, (int l), (l))
+CGVOP(jump, (int l), (l))
+CGOP(int, widen, (int r, int oldtype, int newtype), (r, oldtype, newtype))
+CGVOP(return, (int reg, struct symtable *sym), (reg, sym))
+CGOP(int, address, (struct symtable *sym), (sym))
+CGOP(int, deref, (int r, int type), (r, type))
+CGOP(int, storderef, (int r1, int r2, int type), (r1, r2, type))
+CGOP(int, negate, (int r, int type), (r, type))
+CGOP(int, invert, (int r, int type), (r, type))
+CGOP(int, lognot, (int r, int type), (r, type))
+CGVOP(loadboolean, (int r, int val, int type), (r, val, type))
+CGOP(int, boolean, (int r, int type), (r, type))
+CGOP(int, and, (int r1, int r2, int type), (r1, r2, type))
+CGOP(int, or, (int r1, int r2, int type), (r1, r2, type))
+CGOP(int, xor, (int r1, int r2, int type), (r1, r2, type))
+CGOP(int, shl, (int r1, int r2, int type), (r1, r2, type))
+CGOP(int, shr, (int r1, int r2, int type), (r1, r2, type))
+CGVOP(move, (int r1, int r2, int type), (r1, r2, type))
+CGOP(int, cast, (int t, int oldtype, int newtype), (t, oldtype, newtype))
@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+// Benchmark: recursive Fibonacci, which is all calls and returns
+
+int fib(int n) {
+  if (n < 2)
+    return (n);
+  return (fib(n - 1) + fib(n - 2));
+}
+
+int main() {
+  int i, total;
+
+  total = 0;
+  for (i = 0; i < 4; i++)
+    total = total + fib(30 + i);
+  printf("fib %d\n", total);
+  return (0);
+}
@@ -0,0 +1,34 @@
+#include <stdio.h>
+
+// Folding corpus: expressions whose operands are all constants
+
+int main() {
+  int x;
+  long y;
+  char c;
+
+  printf("%d %d %d %d\n", 6 * 7, 100 / 7, 100 % 7, -100 / 7);
+  printf("%d %d %d %d\n", 1 << 10, 0xf0 >> 4, 12 & 10, 12 | 3);
+  printf("%d %d %d\n", 5 ^ 3, ~5, -(3 + 4));
+  printf("%d %d %d %d %d %d\n", 3 < 4, 3 > 4, 3 <= 3, 4 >= 5, 2 == 2,
+	 2 != 2);
+  printf("%d %d %d %d\n", 1 && 0, 1 || 0, !5, !0);
+  printf("%d %d\n", 2 > 1 ? 10 : 20, 0 ? 10 : 20);
+  x = 3 + 4 * 5 - 10 / 3 + 17 % 5;
+  printf("%d\n", x);
+  x = 7 >> 1 << 2;
+  printf("%d\n", x);
+  x = -7 / 2;
+  printf("%d %d\n", x, -7 % 2);
+
+  // Int results wrap to 32 bits, and a cast to char keeps the low byte
+  x = 1000000 * 3000;
+  printf("%d %d\n", x, 65536 * 65536);
+  printf("%d\n", -2147483647 - 1 < 0);
+  c = (char) 300;
+  printf("%d %d\n", c, (char) 300);
+  y = 100000;
+  y = y * 100000;
+  printf("%ld\n", y);
+  return (0);
+}
@@ -0,0 +1,35 @@
+#include <stdio.h>
+
+// Folding corpus: conditions which fold to a
+// constant, so only the part which runs is kept
+
+int calls;
+
+int f(int x) {
+  calls = calls + 1;
+  return (x);
+}
+
+int main() {
+  int i, a;
+
+  i = 0;
+  if (0)
+    i = 100;
+  if (1)
+    i = i + 1;
+  else
+    i = i + 1000;
+  if (2 > 3)
+    printf("never\n");
+  while (0)
+    i = i + 10000;
+  for (a = 0; 0; a++)
+    i = i + 5;
+  printf("%d %d\n", i, a);
+
+  // The right of && and || isn't evaluated, so f() isn't called
+  printf("%d %d %d\n", 0 && f(1), 1 || f(1), calls);
+  printf("%d %d\n", 1 ? f(4) : f(5), calls);
+  return (0);
+}
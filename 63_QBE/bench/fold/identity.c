@@ -0,0 +1,38 @@
+#include <stdio.h>
+
+// Folding corpus: one constant operand, where an
+// algebraic identity or a shift replaces the operation
+
+int calls;
+
+int f(int x) {
+  calls = calls + 1;
+  return (x);
+}
+
+int main() {
+  int a, i, w;
+  long l;
+  char c;
+
+  a = 77;
+  c = 100;
+  l = 3;
+  printf("%d %d %d %d\n", a * 1, a + 0, 0 + a, a - 0);
+  printf("%d %d %d\n", a | 0, a ^ 0, a & -1);
+  printf("%d %d %d\n", a << 0, a >> 0, a / 1);
+  printf("%d %d %d\n", a * 8, 16 * a, a * 0);
+  printf("%ld %ld\n", l * 4, l << 0);
+
+  // A char can't be negative, so these are shifts and masks
+  printf("%d %d %d\n", c / 4, c % 16, c / 1);
+
+  // A negative int can't be shifted
+  w = -a;
+  printf("%d %d %d\n", w / 4, w % 4, w * 4);
+
+  // The call has to be made, even though its value isn't used
+  i = f(3) * 0;
+  printf("%d %d\n", i, calls);
+  return (0);
+}
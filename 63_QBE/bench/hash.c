@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string.h>
+
+// Benchmark: an open addressing hash table of strings
+
+enum { TABSIZE = 65536, NKEYS = 40000, ROUNDS = 10 };
+
+char *Keys[TABSIZE];
+int Values[TABSIZE];
+char Names[NKEYS * 8];
+
+// Hash a string
+int strhash(char *s) {
+  int h;
+
+  h = 5381;
+  while (*s) {
+    h = ((h * 33) + *s) & 16777215;
+    s++;
+  }
+  return (h);
+}
+
+// Find the slot for key, which is empty if key isn't in the table
+int findslot(char *key) {
+  int slot;
+
+  slot = strhash(key) & (TABSIZE - 1);
+  while (Keys[slot] != NULL && strcmp(Keys[slot], key))
+    slot = (slot + 1) & (TABSIZE - 1);
+  return (slot);
+}
+
+// Make the name of key number n in Names[]
+char *makename(int n) {
+  char *s;
+  int i;
+
+  s = Names + n * 8;
+  s[0] = 'k';
+  for (i = 1; i < 7; i++) {
+    s[i] = (char) ('a' + n % 26);
+    n = n / 26;
+  }
+  s[7] = 0;
+  return (s);
+}
+
+int main() {
+  int i, r, slot, found;
+  long sum;
+  char *name;
+
+  for (i = 0; i < NKEYS; i++) {
+    name = makename(i);
+    slot = findslot(name);
+    Keys[slot] = name;
+    Values[slot] = i;
+  }
+
+  sum = 0;
+  found = 0;
+  for (r = 0; r < ROUNDS; r++) {
+    for (i = 0; i < NKEYS; i++) {
+      slot = findslot(Names + i * 8);
+      if (Keys[slot] != NULL) {
+	found++;
+	sum = sum + Values[slot];
+      }
+    }
+  }
+  printf("hash %d %ld\n", found, sum);
+  return (0);
+}
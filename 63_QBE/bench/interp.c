@@ -0,0 +1,124 @@
+#include <stdio.h>
+
+// Benchmark: a bytecode interpreter which dispatches
+// on each instruction with a switch statement
+
+// The instructions of a small stack machine
+enum {
+  OP_PUSH, OP_LOAD, OP_STORE, OP_ADD, OP_SUB, OP_MUL, OP_MOD,
+  OP_LT, OP_JZ, OP_JMP, OP_DUP, OP_POP, OP_HALT
+};
+
+int Code[100];
+int Ncode;
+int Stack[100];
+int Vars[10];
+
+// Add an instruction and its operand to the program
+void emit(int op, int arg) {
+  Code[Ncode] = op;
+  Code[Ncode + 1] = arg;
+  Ncode = Ncode + 2;
+}
+
+// Run the program from the start until OP_HALT
+void run(void) {
+  int pc, sp, op, arg, a, b;
+
+  pc = 0;
+  sp = 0;
+  while (1) {
+    op = Code[pc];
+    arg = Code[pc + 1];
+    pc = pc + 2;
+    switch (op) {
+      case OP_PUSH:
+	Stack[sp] = arg;
+	sp++;
+	break;
+      case OP_LOAD:
+	Stack[sp] = Vars[arg];
+	sp++;
+	break;
+      case OP_STORE:
+	sp--;
+	Vars[arg] = Stack[sp];
+	break;
+      case OP_ADD:
+	sp--;
+	Stack[sp - 1] = Stack[sp - 1] + Stack[sp];
+	break;
+      case OP_SUB:
+	sp--;
+	Stack[sp - 1] = Stack[sp - 1] - Stack[sp];
+	break;
+      case OP_MUL:
+	sp--;
+	Stack[sp - 1] = Stack[sp - 1] * Stack[sp];
+	break;
+      case OP_MOD:
+	sp--;
+	Stack[sp - 1] = Stack[sp - 1] % Stack[sp];
+	break;
+      case OP_LT:
+	sp--;
+	a = Stack[sp - 1];
+	b = Stack[sp];
+	Stack[sp - 1] = a < b;
+	break;
+      case OP_JZ:
+	sp--;
+	if (Stack[sp] == 0)
+	  pc = arg;
+	break;
+      case OP_JMP:
+	pc = arg;
+	break;
+      case OP_DUP:
+	Stack[sp] = Stack[sp - 1];
+	sp++;
+	break;
+      case OP_POP:
+	sp--;
+	break;
+      case OP_HALT:
+	return;
+    }
+  }
+}
+
+int main() {
+  int top, end;
+
+  // i = 0; sum = 0;
+  // while (i < 3000000) { sum = (sum + i * 7) % 1000003; i = i + 1; }
+  emit(OP_PUSH, 0);
+  emit(OP_STORE, 0);
+  emit(OP_PUSH, 0);
+  emit(OP_STORE, 1);
+  top = Ncode;
+  emit(OP_LOAD, 0);
+  emit(OP_PUSH, 3000000);
+  emit(OP_LT, 0);
+  end = Ncode;
+  emit(OP_JZ, 0);
+  emit(OP_LOAD, 1);
+  emit(OP_LOAD, 0);
+  emit(OP_PUSH, 7);
+  emit(OP_MUL, 0);
+  emit(OP_ADD, 0);
+  emit(OP_PUSH, 1000003);
+  emit(OP_MOD, 0);
+  emit(OP_STORE, 1);
+  emit(OP_LOAD, 0);
+  emit(OP_PUSH, 1);
+  emit(OP_ADD, 0);
+  emit(OP_STORE, 0);
+  emit(OP_JMP, top);
+  Code[end + 1] = Ncode;
+  emit(OP_HALT, 0);
+
+  run();
+  printf("interp %d %d\n", Vars[0], Vars[1]);
+  return (0);
+}
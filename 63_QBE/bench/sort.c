@@ -0,0 +1,80 @@
+#include <stdio.h>
+
+// Benchmark: quicksort and insertion sort of pseudo-random ints
+
+enum { NELEMS = 200000, PASSES = 5 };
+
+int Data[NELEMS];
+long Seed;
+
+// Return the next pseudo-random number
+int nextrand(void) {
+  Seed = (Seed * 1103515245 + 12345) & 2147483647;
+  return ((int) (Seed >> 8));
+}
+
+// Sort Data[lo] to Data[hi] with an insertion sort
+void inssort(int lo, int hi) {
+  int i, j, v;
+
+  for (i = lo + 1; i <= hi; i++) {
+    v = Data[i];
+    j = i - 1;
+    while (j >= lo && Data[j] > v) {
+      Data[j + 1] = Data[j];
+      j--;
+    }
+    Data[j + 1] = v;
+  }
+}
+
+// Sort Data[lo] to Data[hi] with a quicksort,
+// leaving short runs to the insertion sort
+void quicksort(int lo, int hi) {
+  int i, j, pivot, t;
+
+  if (hi - lo < 16) {
+    inssort(lo, hi);
+    return;
+  }
+  pivot = Data[(lo + hi) / 2];
+  i = lo;
+  j = hi;
+  while (i <= j) {
+    while (Data[i] < pivot)
+      i++;
+    while (Data[j] > pivot)
+      j--;
+    if (i <= j) {
+      t = Data[i];
+      Data[i] = Data[j];
+      Data[j] = t;
+      i++;
+      j--;
+    }
+  }
+  if (lo < j)
+    quicksort(lo, j);
+  if (i < hi)
+    quicksort(i, hi);
+}
+
+int main() {
+  int i, pass, bad;
+  long sum;
+
+  Seed = 1;
+  sum = 0;
+  bad = 0;
+  for (pass = 0; pass < PASSES; pass++) {
+    for (i = 0; i < NELEMS; i++)
+      Data[i] = nextrand();
+    quicksort(0, NELEMS - 1);
+    for (i = 1; i < NELEMS; i++)
+      if (Data[i - 1] > Data[i])
+	bad++;
+    sum = sum + Data[NELEMS / 2];
+  }
+  printf("sort %ld %d\n", sum, bad);
+  return (0);
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+
+// Benchmark: scanning a text buffer a character at a time
+
+enum { TEXTSIZE = 1000000, PASSES = 10 };
+
+char Text[1000001];
+long Seed;
+
+// Return the next pseudo-random number
+int nextrand(void) {
+  Seed = (Seed * 1103515245 + 12345) & 2147483647;
+  return ((int) (Seed >> 8));
+}
+
+// Fill the buffer with words of lower case letters,
+// separated by spaces and the odd newline
+void filltext(void) {
+  int i, r;
+
+  for (i = 0; i < TEXTSIZE; i++) {
+    r = nextrand() % 32;
+    if (r < 26)
+      Text[i] = (char) ('a' + r);
+    else if (r < 31)
+      Text[i] = ' ';
+    else
+      Text[i] = '\n';
+  }
+  Text[i] = 0;
+}
+
+// Return the length of a string
+int length(char *s) {
+  int n;
+
+  n = 0;
+  while (*s) {
+    n++;
+    s++;
+  }
+  return (n);
+}
+
+// Count the words and lines in s
+int countwords(char *s) {
+  int words, inword;
+
+  words = 0;
+  inword = 0;
+  while (*s) {
+    if (*s == ' ' || *s == '\n')
+      inword = 0;
+    else if (inword == 0) {
+      inword = 1;
+      words++;
+    }
+    s++;
+  }
+  return (words);
+}
+
+// Count the times that pat appears in s
+int countmatches(char *s, char *pat) {
+  int count, i;
+
+  count = 0;
+  while (*s) {
+    i = 0;
+    while (pat[i] != 0 && s[i] == pat[i])
+      i++;
+    if (pat[i] == 0)
+      count++;
+    s++;
+  }
+  return (count);
+}
+
+int main() {
+  int pass;
+  long len, words, matches;
+
+  Seed = 7;
+  filltext();
+  len = 0;
+  words = 0;
+  matches = 0;
+  for (pass = 0; pass < PASSES; pass++) {
+    len = len + length(Text);
+    words = words + countwords(Text);
+    matches = matches + countmatches(Text, "ab");
+  }
+  printf("strscan %ld %ld %ld\n", len, words, matches);
+  return (0);
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Benchmark: structs copied in and out of an array with
+// memcpy() and cleared with memset(), all of constant sizes
+
+enum { NPARTS = 1000, ROUNDS = 20000 };
+
+struct particle {
+  long x;
+  long y;
+  long vx;
+  long vy;
+  int mass;
+  int hits;
+  char tag;
+};
+
+struct particle *Parts[NPARTS];
+
+// Move each particle a step, bouncing it off the walls
+// of a box. Each one is worked on in a local copy
+void step(void) {
+  struct particle p;
+  struct particle *q;
+  int i;
+
+  for (i = 0; i < NPARTS; i++) {
+    q = Parts[i];
+    memcpy(&p, q, sizeof(struct particle));
+    p.x = p.x + p.vx;
+    p.y = p.y + p.vy;
+    if (p.x < 0 || p.x > 100000) {
+      p.vx = 0 - p.vx;
+      p.hits = p.hits + 1;
+    }
+    if (p.y < 0 || p.y > 100000) {
+      p.vy = 0 - p.vy;
+      p.hits = p.hits + 1;
+    }
+    memcpy(q, &p, sizeof(struct particle));
+  }
+}
+
+// Reset the particles which have hit the walls too often
+int reset(void) {
+  struct particle *q;
+  int i, n;
+
+  n = 0;
+  for (i = 0; i < NPARTS; i++) {
+    q = Parts[i];
+    if (q->hits > 3) {
+      memset(q, 0, sizeof(struct particle));
+      q->x = 50000;
+      q->y = 50000;
+      q->vx = (i % 37) - 18;
+      q->vy = (i % 41) - 20;
+      q->mass = 1;
+      n++;
+    }
+  }
+  return (n);
+}
+
+int main() {
+  struct particle *q;
+  int i, resets;
+  long sum;
+
+  for (i = 0; i < NPARTS; i++) {
+    q = (struct particle *) malloc(sizeof(struct particle));
+    memset(q, 0, sizeof(struct particle));
+    q->x = (i * 7919) % 100000;
+    q->y = (i * 104729) % 100000;
+    q->vx = (i % 53) - 26;
+    q->vy = (i % 59) - 29;
+    q->mass = i % 10 + 1;
+    Parts[i] = q;
+  }
+  resets = 0;
+  for (i = 0; i < ROUNDS; i++) {
+    step();
+    if (i % 100 == 0)
+      resets = resets + reset();
+  }
+  sum = 0;
+  for (i = 0; i < NPARTS; i++) {
+    q = Parts[i];
+    sum = sum + q->x + q->y * q->mass + q->hits;
+  }
+  printf("structcpy %d %ld\n", resets, sum);
+  return (0);
+}
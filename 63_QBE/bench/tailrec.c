@@ -0,0 +1,63 @@
+#include <stdio.h>
+
+// Benchmark: self tail calls which recurse ten million
+// levels deep. Each one has to become a loop, or the
+// program runs out of stack
+
+enum { DEPTH = 10000000 };
+
+struct node {
+  int val;
+  struct node *next;
+};
+
+struct node A, B, C;
+long Total;
+
+// Return the greatest common divisor of a and b
+int gcd(int a, int b) {
+  if (b == 0)
+    return (a);
+  return (gcd(b, a % b));
+}
+
+// Return acc plus the sum of 1 to n
+long sumto(long n, long acc) {
+  if (n == 0)
+    return (acc);
+  return (sumto(n - 1, acc + n));
+}
+
+// Add the values in the circular list to Total, n times
+void walk(struct node *p, int n) {
+  if (n == 0)
+    return;
+  Total = Total + p->val;
+  walk(p->next, n - 1);
+}
+
+// Count x down to zero through a pointer to
+// it, adding two to y each time
+int countdown(int x, int y) {
+  int *p;
+
+  if (x == 0)
+    return (y);
+  p = &x;
+  *p = *p - 1;
+  return (countdown(x, y + 2));
+}
+
+int main() {
+  A.val = 1;
+  A.next = &B;
+  B.val = 2;
+  B.next = &C;
+  C.val = 3;
+  C.next = &A;
+  Total = 0;
+  walk(&A, DEPTH);
+  printf("tailrec %d %ld %ld %d\n", gcd(1071, 462), sumto(DEPTH, 0),
+	 Total, countdown(DEPTH, 0));
+  return (0);
+}
@@ -0,0 +1,449 @@
+#include "defs.h"
+#include "data.h"
+#include "decl.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+// Compile cache
+// Copyright (c) 2019 Warren Toomey, GPL3
+
+// With -C dir, the files made from each input file are kept in
+// dir under a key which is a hash of the compiler itself, the
+// options which change its output and the pre-processed input.
+// When the same key comes up again, the files are copied back
+// and cpp is the only thing which runs. The index file in the
+// cache directory has a line of statistics:
+//	hits misses evictions
+// and then a line for each entry, least recently used first:
+//	key bytes suffixes
+// where the suffixes are the letters of the files kept, e.g. "o"
+// or "qs". Entries are evicted from the front when the cache
+// grows over O_cachesize bytes. The cache directory is only
+// changed while holding an flock() on its lock file, so that
+// several cwj processes can share it
+/*用 -C dir 时，每个输入文件生成的文件保存在 dir 中，键是编译器本身、影响输出的选项以及预处理后
+输入的哈希值。再次遇到相同的键时，直接把文件复制回来，只需要运行 cpp。缓存目录中的 index 文件
+第一行是统计数据：命中数、未命中数、淘汰数；之后每个条目一行，最久未使用的在前：键、字节数、后缀，
+后缀是保存的文件的字母，例如 "o" 或 "qs"。缓存超过 O_cachesize 字节时从前面淘汰条目。
+只有持有锁文件的 flock() 时才修改缓存目录，这样多个 cwj 进程可以共用它。*/
+
+// The two hashes which make up a key. Each stays below
+// its modulus, so that the arithmetic never overflows
+/*组成键的两个哈希值。每个都小于各自的模数，运算不会溢出。*/
+enum {
+  HASHMOD1 = 2147483647,
+  HASHMOD2 = 2147483629,
+  HASHMUL1 = 1000003,
+  HASHMUL2 = 16777619,
+  KEYLEN = 24			// Hex digits in a key
+};
+static long Hash1;
+static long Hash2;
+static long Seed1;		// The hashes of the compiler binary
+static long Seed2;
+static char Cachekey[KEYLEN + 1];	// Key of the file being compiled
+
+// The entries read in from the index
+static int Ncache;
+static char **Ckeys;
+static int *Csizes;
+static char **Csuffixes;
+static int Hits, Misses, Evictions;
+static FILE *Lockfile;
+
+// Add len bytes at s to the running hashes. They are
+// taken four at a time, to save on the divisions. The
+// top byte is shifted as a long, so a word is never negative
+static void hashbytes(char *s, int len) {
+  int i, j;
+  long w;
+
+  for (i = 0; i < len; i = i + 4) {
+    if (i + 4 <= len) {
+      w = s[i] & 0xff;
+      w = (w << 24) | ((s[i + 1] & 0xff) << 16) |
+	((s[i + 2] & 0xff) << 8) | (s[i + 3] & 0xff);
+    } else {
+      w = 0;
+      for (j = i; j < len; j++)
+	w = (w << 8) | (s[j] & 0xff);
+    }
+    Hash1 = (Hash1 * HASHMUL1 + w) % HASHMOD1;
+    Hash2 = (Hash2 * HASHMUL2 + w) % HASHMOD2;
+  }
+}
+
+// Return the name of a file in the cache directory
+static char *cachepath(char *name, char *suffix) {
+  char path[TEXTLEN];
+
+  snprintf(path, TEXTLEN, "%s/%s%s", O_cachedir, name, suffix);
+  return (strdup(path));
+}
+
+// Copy a file. Return the number of bytes
+// copied, or -1 if either file can't be opened
+static int copyfile(char *from, char *to) {
+  char buf[TEXTLEN];
+  FILE *in, *out;
+  int n, total = 0;
+
+  if ((in = fopen(from, "r")) == NULL)
+    return (-1);
+  if ((out = fopen(to, "w")) == NULL) {
+    fclose(in);
+    return (-1);
+  }
+  while ((n = (int) fread(buf, 1, TEXTLEN, in)) > 0) {
+    fwrite(buf, 1, n, out);
+    total = total + n;
+  }
+  fclose(in);
+  fclose(out);
+  return (total);
+}
+
+// Hash the compiler binary, once, into the seeds for the
+// other hashes. A new compiler never uses an old one's files
+/*对编译器可执行文件求一次哈希，作为其它哈希的种子。新的编译器不会用到旧编译器生成的文件。*/
+static void hashcompiler(void) {
+  char buf[TEXTLEN];
+  FILE *fp;
+  int n;
+
+  if (Seed1 != 0 || Seed2 != 0)
+    return;
+  Hash1 = 0;
+  Hash2 = 0;
+  if ((fp = fopen("/proc/self/exe", "r")) == NULL) {
+    fprintf(stderr, "Unable to read the compiler binary: %s\n",
+	    strerror(errno));
+    exit(1);
+  }
+  while ((n = (int) fread(buf, 1, TEXTLEN, fp)) > 0)
+    hashbytes(buf, n);
+  fclose(fp);
+  Seed1 = Hash1;
+  Seed2 = Hash2;
+}
+
+// Set up the cache directory
+void cacheinit(void) {
+  mkdir(O_cachedir, 0755);
+  hashcompiler();
+}
+
+// Put the key of a precompiled header in key[0] and key[1]:
+// a hash of the compiler, the options which change what it
+// makes of a header, and the len bytes of header text in buf
+void pchkey(char *buf, int len, long *key) {
+  char opts[TEXTLEN];
+
+  hashcompiler();
+  Hash1 = Seed1;
+  Hash2 = Seed2;
+  snprintf(opts, TEXTLEN, "%d", O_inlinelimit);
+  hashbytes(opts, (int) strlen(opts));
+  hashbytes(buf, len);
+  key[0] = Hash1;
+  key[1] = Hash2;
+}
+
+// Return the suffixes of the files which we keep for an
+// input file: the QBE and assembly files with -S, or else
+// the object file. With -O0 there is no QBE file
+static char *cachesuffixes(void) {
+  if (!O_keepasm)
+    return ("o");
+  if (O_pipeline || O_x64)
+    return ("s");
+  return ("qs");
+}
+
+// Lock the cache directory and read in the index
+static void readindex(void) {
+  char *path, *buf, *p, *q;
+  FILE *fp;
+  int len, size, n, i;
+
+  path = cachepath("lock", "");
+  if ((Lockfile = fopen(path, "a")) == NULL) {
+    fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+    exit(1);
+  }
+  flock(fileno(Lockfile), LOCK_EX);
+  free(path);
+
+  Ncache = 0;
+  Ckeys = NULL;
+  Csizes = NULL;
+  Csuffixes = NULL;
+  Hits = 0;
+  Misses = 0;
+  Evictions = 0;
+  path = cachepath("index", "");
+  fp = fopen(path, "r");
+  free(path);
+  if (fp == NULL)
+    return;
+
+  // Read the whole index into buf
+  size = TEXTLEN;
+  len = 0;
+  buf = (char *) malloc(size);
+  while ((n = (int) fread(buf + len, 1, size - 1 - len, fp)) > 0) {
+    len = len + n;
+    if (len == size - 1) {
+      size = size * 2;
+      buf = (char *) realloc(buf, size);
+    }
+  }
+  fclose(fp);
+  buf[len] = 0;
+
+  // Count the lines, less the statistics line,
+  // to size the arrays of entries
+  n = 0;
+  for (p = buf; *p; p++)
+    if (*p == '\n')
+      n++;
+  Ckeys = (char **) malloc((n + 1) * sizeof(char *));
+  Csizes = (int *) malloc((n + 1) * sizeof(int));
+  Csuffixes = (char **) malloc((n + 1) * sizeof(char *));
+
+  // Split the buffer into lines and fields
+  for (p = buf; *p; p++)
+    if (*p == '\n' || *p == ' ')
+      *p = 0;
+  p = buf;
+  Hits = atoi(p);
+  p = p + strlen(p) + 1;
+  Misses = atoi(p);
+  p = p + strlen(p) + 1;
+  Evictions = atoi(p);
+  p = p + strlen(p) + 1;
+  for (i = 0; i < n - 1; i++) {
+    q = p + strlen(p) + 1;
+    if (strlen(p) != KEYLEN || *q == 0)
+      break;
+    Ckeys[Ncache] = strdup(p);
+    Csizes[Ncache] = atoi(q);
+    q = q + strlen(q) + 1;
+    Csuffixes[Ncache] = strdup(q);
+    Ncache++;
+    p = q + strlen(q) + 1;
+  }
+  free(buf);
+}
+
+// Write out the index, free the entries
+// and unlock the cache directory
+static void writeindex(void) {
+  char *path, *tmppath;
+  FILE *fp;
+  int i;
+
+  path = cachepath("index", "");
+  tmppath = cachepath("index", ".tmp");
+  if ((fp = fopen(tmppath, "w")) == NULL) {
+    fprintf(stderr, "Unable to create %s: %s\n", tmppath,
+	    strerror(errno));
+    exit(1);
+  }
+  fprintf(fp, "%d %d %d\n", Hits, Misses, Evictions);
+  for (i = 0; i < Ncache; i++)
+    fprintf(fp, "%s %d %s\n", Ckeys[i], Csizes[i], Csuffixes[i]);
+  fclose(fp);
+  rename(tmppath, path);
+  free(path);
+  free(tmppath);
+
+  for (i = 0; i < Ncache; i++) {
+    free(Ckeys[i]);
+    free(Csuffixes[i]);
+  }
+  if (Ckeys != NULL) {
+    free(Ckeys);
+    free(Csizes);
+    free(Csuffixes);
+  }
+  Ncache = 0;
+  fclose(Lockfile);
+}
+
+// Return the index of the entry with the given key, or -1
+static int findentry(char *key) {
+  int i;
+
+  for (i = 0; i < Ncache; i++)
+    if (!strcmp(Ckeys[i], key))
+      return (i);
+  return (-1);
+}
+
+// Move entry i to the end of the index,
+// as it is the most recently used
+static void touchentry(int i) {
+  char *key, *suffixes;
+  int size;
+
+  key = Ckeys[i];
+  size = Csizes[i];
+  suffixes = Csuffixes[i];
+  while (i < Ncache - 1) {
+    Ckeys[i] = Ckeys[i + 1];
+    Csizes[i] = Csizes[i + 1];
+    Csuffixes[i] = Csuffixes[i + 1];
+    i++;
+  }
+  Ckeys[i] = key;
+  Csizes[i] = size;
+  Csuffixes[i] = suffixes;
+}
+
+// Remove the files of entry i from the cache,
+// and the entry from the index
+static void dropentry(int i) {
+  char *path, *s;
+  char suffix[3];
+
+  suffix[0] = '.';
+  suffix[2] = 0;
+  for (s = Csuffixes[i]; *s; s++) {
+    suffix[1] = *s;
+    path = cachepath(Ckeys[i], suffix);
+    unlink(path);
+    free(path);
+  }
+  free(Ckeys[i]);
+  free(Csuffixes[i]);
+  while (i < Ncache - 1) {
+    Ckeys[i] = Ckeys[i + 1];
+    Csizes[i] = Csizes[i + 1];
+    Csuffixes[i] = Csuffixes[i + 1];
+    i++;
+  }
+  Ncache--;
+}
+
+// Copy the files of entry i to or from the cache, for the
+// given input filename. Return the number of bytes copied,
+// or -1 if any of the files couldn't be copied
+static int copyentry(int i, char *filename, int tocache) {
+  char *path, *outfile, *s;
+  char suffix[3];
+  int n, total = 0;
+
+  suffix[0] = '.';
+  suffix[2] = 0;
+  for (s = Csuffixes[i]; *s; s++) {
+    suffix[1] = *s;
+    path = cachepath(Ckeys[i], suffix);
+    outfile = alter_suffix(filename, *s);
+    if (tocache)
+      n = copyfile(outfile, path);
+    else
+      n = copyfile(path, outfile);
+    free(path);
+    free(outfile);
+    if (n < 0)
+      return (-1);
+    total = total + n;
+  }
+  return (total);
+}
+
+// Work out the key for the input file from the pre-processed
+// text of len bytes in buf. If the cache has the files for
+// this key, copy them back and return 1. Otherwise return 0
+/*根据 buf 中 len 字节的预处理文本算出输入文件的键。如果缓存中有这个键的文件，
+把它们复制回来并返回 1，否则返回 0。*/
+int cachefind(char *filename, char *buf, int len) {
+  char opts[TEXTLEN];
+  int i, found = 0;
+
+  // Hash the options which change what we produce
+  Hash1 = Seed1;
+  Hash2 = Seed2;
+  snprintf(opts, TEXTLEN, "%s %d %d %d %s %s", cachesuffixes(),
+	   O_inlinelimit, O_peephole, O_x64, QBECMD, ASCMD);
+  hashbytes(opts, (int) strlen(opts));
+  hashbytes(buf, len);
+  snprintf(Cachekey, KEYLEN + 1, "%08lx%08lx%08x", Hash1, Hash2, len);
+
+  readindex();
+  i = findentry(Cachekey);
+  if (i >= 0) {
+    if (copyentry(i, filename, 0) >= 0) {
+      touchentry(i);
+      found = 1;
+    } else
+      dropentry(i);
+  }
+  if (found)
+    Hits++;
+  else
+    Misses++;
+  writeindex();
+
+  if (O_verbose) {
+    if (found)
+      printf("cache hit for %s\n", filename);
+    else
+      printf("cache miss for %s\n", filename);
+  }
+  return (found);
+}
+
+// Copy the files made from the input file into the cache
+// under the key from cachefind(), then evict the least
+// recently used entries until the cache fits in its size
+/*把输入文件生成的文件复制到缓存中，键由 cachefind() 算出，然后淘汰最久未使用的条目，
+直到缓存不超过它的大小。*/
+void cachestore(char *filename) {
+  long total = 0;
+  int i;
+
+  readindex();
+  i = findentry(Cachekey);
+  if (i >= 0)
+    dropentry(i);
+
+  // Add the new entry at the end
+  Ckeys = (char **) realloc(Ckeys, (Ncache + 1) * sizeof(char *));
+  Csizes = (int *) realloc(Csizes, (Ncache + 1) * sizeof(int));
+  Csuffixes = (char **) realloc(Csuffixes, (Ncache + 1) * sizeof(char *));
+  Ckeys[Ncache] = strdup(Cachekey);
+  Csuffixes[Ncache] = strdup(cachesuffixes());
+  Ncache++;
+  Csizes[Ncache - 1] = copyentry(Ncache - 1, filename, 1);
+  if (Csizes[Ncache - 1] < 0)
+    dropentry(Ncache - 1);
+
+  // Evict from the front, but never the new entry
+  for (i = 0; i < Ncache; i++)
+    total = total + Csizes[i];
+  while (Ncache > 1 && total > O_cachesize) {
+    total = total - Csizes[0];
+    dropentry(0);
+    Evictions++;
+  }
+  writeindex();
+}
+
+// Print out the cache statistics
+void cachestats(void) {
+  long total = 0;
+  int i;
+
+  readindex();
+  for (i = 0; i < Ncache; i++)
+    total = total + Csizes[i];
+  printf("cache: %d hits, %d misses, %d evictions, ",
+	 Hits, Misses, Evictions);
+  printf("%d entries using %ld of %ld bytes\n", Ncache, total,
+	 O_cachesize);
+  writeindex();
+}
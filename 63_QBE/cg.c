@@ -3,8 +3,299 @@
 #include "decl.h"
 
 // Code generator for x86-64 using the QBE intermediate language.
+// The qbexxx() functions are called through the cgxxx() ones
+// in backend.c, which use cgx64.c instead with -O0.
 // Copyright (c) 2019 Warren Toomey, GPL3
 
+// The QBE code is collected in a big buffer which is
+// written out when it fills up and at the end of each file.
+// Numbers and temporaries are formatted by hand, so there
+// is no call to fprintf() for each instruction
+/*QBE 代码先放进一个大缓冲区，满了或者文件结束时才写出去。
+数字和临时变量由我们自己格式化，不用为每条指令调用 fprintf()。*/
+enum { OUTBUFSIZE = 65536 };
+static char Outbuf[OUTBUFSIZE];
+static int Outlen;
+static long Outbytes;		// Bytes written out so far
+
+// The code for static functions and data can be kept
+// in memory and written out later. While Deferring is
+// set, emitflush() adds the buffer to Defbuf instead
+/*静态函数和数据的代码可以先留在内存里，稍后再写出。Deferring 置位时，
+emitflush() 把缓冲区追加到 Defbuf，而不是写到输出文件。*/
+static int Deferring;
+static char *Defbuf;
+static int Deflen;
+static int Defmax;
+
+// While functions are being generated by worker processes, the
+// rest of the code is held in memory. It is written out after
+// the code for the functions which come before it
+/*当函数由工作进程生成代码时，其余的代码先留在内存里，
+等它前面的函数的代码写出之后再写出。*/
+static int Holding;
+static char *Holdbuf;
+static int Holdlen;
+static int Holdmax;
+
+// The QBE code for the function being generated is kept in
+// Funcbuf while Infunc is set, and peephole() tidies it up
+// when the function is done
+/*Infunc 置位时，正在生成的函数的 QBE 代码留在 Funcbuf 中，
+函数结束时由 peephole() 整理后再写出。*/
+static int Infunc;
+static char *Funcbuf;
+static int Funclen;
+static int Funcmax;
+
+// Add len bytes of text to the buffer *buf, which
+// has *buflen bytes in it and room for *bufmax
+static void addtext(char **buf, int *buflen, int *bufmax, char *text,
+		    int len) {
+  if (*buflen + len > *bufmax) {
+    *bufmax = *bufmax * 2 + len + OUTBUFSIZE;
+    *buf = (char *) realloc(*buf, *bufmax);
+    if (*buf == NULL)
+      fatal("Unable to malloc in addtext()");
+  }
+  memcpy(*buf + *buflen, text, len);
+  *buflen = *buflen + len;
+}
+
+// Write out the buffered QBE code
+static void emitflush(void) {
+  if (Infunc) {
+    addtext(&Funcbuf, &Funclen, &Funcmax, Outbuf, Outlen);
+    Outlen = 0;
+    return;
+  }
+  if (Outlen > 0) {
+    if (Deferring)
+      addtext(&Defbuf, &Deflen, &Defmax, Outbuf, Outlen);
+    else if (Holding)
+      addtext(&Holdbuf, &Holdlen, &Holdmax, Outbuf, Outlen);
+    else
+      fwrite(Outbuf, 1, Outlen, Outfile);
+  }
+  Outbytes = Outbytes + Outlen;
+  Outlen = 0;
+}
+
+// Return the number of bytes of QBE code generated so far
+long cgoutbytes(void) {
+  return (Outbytes + Outlen);
+}
+
+// Write out all the buffered QBE code, so that
+// a new process doesn't write it out again
+void cgflush(void) {
+  emitflush();
+  fflush(Outfile);
+}
+
+// Start keeping the QBE code in memory
+void cgstartdefer(void) {
+  emitflush();
+  Deferring = 1;
+}
+
+// Stop keeping the QBE code in memory. Return the
+// code kept since cgstartdefer() and set its length
+char *cgenddefer(int *len) {
+  char *text;
+
+  emitflush();
+  Deferring = 0;
+  text = Defbuf;
+  *len = Deflen;
+  Defbuf = NULL;
+  Deflen = 0;
+  Defmax = 0;
+  return (text);
+}
+
+// Start holding the QBE code in memory
+void cgstarthold(void) {
+  emitflush();
+  Holding = 1;
+}
+
+// Stop holding the QBE code. Return the code
+// held since cgstarthold() and set its length
+char *cgendhold(int *len) {
+  char *text;
+
+  emitflush();
+  Holding = 0;
+  text = Holdbuf;
+  *len = Holdlen;
+  Holdbuf = NULL;
+  Holdlen = 0;
+  Holdmax = 0;
+  return (text);
+}
+
+// Write out some QBE code which was kept earlier.
+// It goes ahead of any code being held
+void cgemitdeferred(char *text, int len) {
+  emitflush();
+  if (len > 0)
+    fwrite(text, 1, len, Outfile);
+}
+
+// Output a character
+void emitc(int c) {
+  if (Outlen == OUTBUFSIZE)
+    emitflush();
+  Outbuf[Outlen] = (char) c;
+  Outlen++;
+}
+
+// Output a string
+void emits(char *s) {
+  while (*s) {
+    emitc(*s);
+    s++;
+  }
+}
+
+// Output a long number in decimal
+static void emitld(long n) {
+  long digits[24];
+  int i = 0, d;
+
+  if (n < 0) {
+    emitc('-');
+    n = -n;
+  }
+
+  // Collect the digits from the lowest one up,
+  // then output them from the highest one down
+  digits[i++] = n % 10;
+  n = n / 10;
+  while (n != 0) {
+    digits[i++] = n % 10;
+    n = n / 10;
+  }
+  while (i > 0) {
+    i--;
+    d = (int) digits[i];
+    emitc('0' + d);
+  }
+}
+
+// Output a number in decimal. It is widened to a long
+// here, as cwj doesn't widen the arguments to a call,
+// and so that the negative of the most negative int fits
+void emitd(int val) {
+  long n;
+
+  n = val;
+  emitld(n);
+}
+
+// Output a temporary, %.tn
+static void emittemp(int t) {
+  emits("%.t");
+  emitd(t);
+}
+
+// Output a label reference, @Ln
+static void emitlabel(int l) {
+  emits("@L");
+  emitd(l);
+}
+
+// Output the start of an instruction which
+// sets temporary t: "  %.tn =q op "
+static void emitassign(int t, int q, char *op) {
+  emits("  ");
+  emittemp(t);
+  emits(" =");
+  emitc(q);
+  emitc(' ');
+  emits(op);
+  emitc(' ');
+}
+
+// Output the start of an instruction which sets temporary t,
+// where the op has a QBE type suffix, e.g. ceqw or extsw:
+// "  %.tn =q opsuffix "
+static void emitassignq(int t, int q, char *op, int suffix) {
+  emits("  ");
+  emittemp(t);
+  emits(" =");
+  emitc(q);
+  emitc(' ');
+  emits(op);
+  emitc(suffix);
+  emitc(' ');
+}
+
+// Output an instruction "t = r1 op r2" of QBE type q
+static void emitbinop(int t, int q, char *op, int r1, int r2) {
+  emitassign(t, q, op);
+  emittemp(r1);
+  emits(", ");
+  emittemp(r2);
+  emitc('\n');
+}
+
+// Output a conditional jump on temporary t
+static void emitjnz(int t, int truelabel, int falselabel) {
+  emits("  jnz ");
+  emittemp(t);
+  emits(", ");
+  emitlabel(truelabel);
+  emits(", ");
+  emitlabel(falselabel);
+  emitc('\n');
+}
+
+// Output an instruction to load temporary t from the
+// variable with the given size, QBE prefix and name
+static void emitloadsym(int t, int size, int prefix, char *name) {
+  switch (size) {
+    case 1:
+      emitassign(t, 'w', "loadub");
+      break;
+    case 4:
+      emitassign(t, 'w', "loadsw");
+      break;
+    case 8:
+      emitassign(t, 'l', "loadl");
+      break;
+    default:
+      return;
+  }
+  emitc(prefix);
+  emits(name);
+  emitc('\n');
+}
+
+// Output an instruction to store temporary t into the
+// variable with the given size, QBE prefix and name
+static void emitstoresym(int t, int size, int prefix, char *name) {
+  switch (size) {
+    case 1:
+      emits("  storeb ");
+      break;
+    case 4:
+      emits("  storew ");
+      break;
+    case 8:
+      emits("  storel ");
+      break;
+    default:
+      return;
+  }
+  emittemp(t);
+  emits(", ");
+  emitc(prefix);
+  emits(name);
+  emitc('\n');
+}
+
 // Switch to the text segment
 /*将代码生成切换到文本段。*/
 void cgtextseg() {
@@ -92,15 +383,40 @@ int cgalloctemp(void) {
   return (++nexttemp);
 }
 
+// Which temporaries of the function were loaded with a cached
+// constant. Expressions may still share one of them after it
+// has left the cache, so they stay marked until the next function
+/*标记函数中哪些临时变量装入过缓存的常量。即使离开了缓存，
+表达式也可能仍在共用它，所以这些标记一直保留到下一个函数。*/
+static char *Constmark;
+static int Constmarkmax;
+
+// Start the temporaries again for a new function. Each
+// function numbers its temporaries from 1, so its code
+// doesn't depend on the functions before it
+/*为新函数重新开始临时变量编号。每个函数的临时变量从 1 开始编号，
+这样它的代码不依赖于前面的函数。*/
+void cgresettemps(void) {
+  nexttemp = 0;
+  if (Constmarkmax > 0)
+    memset(Constmark, 0, Constmarkmax);
+}
+
+// Return the number of temporaries in this function
+int cgnumtemps(void) {
+  return (nexttemp);
+}
+
 // Print out the assembly preamble
-// for one output file
-/*用于输出汇编文件的前导部分。*/
-void cgpreamble(char *filename) {
+// for one output file. QBE doesn't need one
+/*用于输出汇编文件的前导部分，QBE 不需要。*/
+void qbepreamble(char *filename) {
 }
 
-// Nothing to do for the end of a file
-/*用于输出汇编文件的后导部分。*/
+// Write out the rest of the QBE code at the end of a file
+/*用于输出汇编文件的后导部分：把缓冲区中剩下的 QBE 代码写出去。*/
 void cgpostamble() {
+  emitflush();
 }
 
 // Boolean flag: has there been a switch statement
@@ -110,31 +426,44 @@ static int used_switch;
 // Print out a function preamble
 /*这个函数用于生成QBE汇编代码，打印函数的前导部分（preamble）。
 函数的前导通常包括导出声明、函数名称、参数声明、函数起始标签以及一些初始化工作。*/
-void cgfuncpreamble(struct symtable *sym) {
+void qbefuncpreamble(struct symtable *sym) {
   char *name = sym->name;// 获取函数名
   struct symtable *parm, *locvar;// 声明参数和局部变量的符号表项
   int size, bigsize;// 用于处理参数和局部变量的大小
   int label;// 函数标签
 
+  cgresettemps();
+
+  // Keep the function's code for the peephole pass
+  emitflush();
+  Infunc = O_peephole;
+
   // Output the function's name and return type
   if (sym->class == C_GLOBAL)
-    fprintf(Outfile, "export ");// 如果函数是全局的，输出导出声明
+    emits("export ");// 如果函数是全局的，输出导出声明
   /*// 输出函数声明，包括返回类型、函数名等
   // 使用 cgqbetype 函数获取 QBE 类型表示（字符）并输出返回类型// 输出函数名*/
-  fprintf(Outfile, "function %c $%s(", cgqbetype(sym->type), name);
+  emits("function ");
+  emitc(cgqbetype(sym->type));
+  emits(" $");
+  emits(name);
+  emitc('(');
 
   // Output the parameter names and types. For any parameters which
   // need addresses, change their name as we copy their value below
   /*使用循环遍历函数的参数列表（sym->member），其中 parm 是指向参数符号表项的指针。*/
   for (parm = sym->member; parm != NULL; parm = parm->next) {
     /*对于需要地址的参数（parm->st_hasaddr == 1），输出参数类型和名称，并在名称前添加 %.p。*/
+    emitc(cgqbetype(parm->type));
     if (parm->st_hasaddr == 1)
-      fprintf(Outfile, "%c %%.p%s, ", cgqbetype(parm->type), parm->name);
+      emits(" %.p");
     else
-      fprintf(Outfile, "%c %%%s, ", cgqbetype(parm->type), parm->name);
+      emits(" %");
+    emits(parm->name);
+    emits(", ");
   }
-  /*在循环结束后，输出右括号和函数体的开始大括号 {。fprintf(Outfile, ") {\n");*/
-  fprintf(Outfile, ") {\n");
+  /*在循环结束后，输出右括号和函数体的开始大括号 {。*/
+  emits(") {\n");
 
   // Get a label for the function start
   /*使用 genlabel 生成一个函数起始的标签。*/
@@ -151,7 +480,11 @@ void cgfuncpreamble(struct symtable *sym) {
     if (parm->st_hasaddr == 1) {
       size = cgprimsize(parm->type);
       bigsize = (size == 1) ? 4 : size;
-      fprintf(Outfile, "  %%%s =l alloc%d 1\n", parm->name, bigsize);
+      emits("  %");
+      emits(parm->name);
+      emits(" =l alloc");
+      emitd(bigsize);
+      emits(" 1\n");
 
       // Copy to the allocated memory
       /*
@@ -162,24 +495,27 @@ void cgfuncpreamble(struct symtable *sym) {
       */
       switch (size) {
 	case 1:
-	  fprintf(Outfile, "  storeb %%.p%s, %%%s\n", parm->name, parm->name);
+	  emits("  storeb %.p");
 	  break;
 	case 4:
-	  fprintf(Outfile, "  storew %%.p%s, %%%s\n", parm->name, parm->name);
+	  emits("  storew %.p");
 	  break;
 	case 8:
-	  fprintf(Outfile, "  storel %%.p%s, %%%s\n", parm->name, parm->name);
+	  emits("  storel %.p");
       }
+      emits(parm->name);
+      emits(", %");
+      emits(parm->name);
+      emitc('\n');
     }
   }
 
   // Allocate memory for any local variables that need to be on the
-  // stack. There are two reasons for this. The first is for locals
-  // where their address is used. The second is for char variables
-  // We need to do this as QBE can only truncate down to 8 bits
-  // for locations in memory
-  /*// 为需要在栈上分配内存的局部变量分配内存。有两个原因需要这样做。第一个是用于地址引用的本地变量。
-// 第二个是用于字符变量。我们需要这样做是因为 QBE 只能将位置内存截断到 8 位，以确保它们在 8 字节边界上对齐。*/
+  // stack, i.e. the locals where their address is used. Other locals,
+  // including chars, live in temporaries. A char temporary is
+  // zero-extended each time it is assigned, to keep it to 8 bits
+  /*// 为需要在栈上分配内存的局部变量（也就是使用了地址的局部变量）分配内存。
+// 其他局部变量（包括 char）都放在临时变量中，char 每次赋值时做零扩展，保证只有 8 位。*/
   for (locvar = Loclhead; locvar != NULL; locvar = locvar->next) {
     if (locvar->st_hasaddr == 1) {
       // Get the total size for all elements (if an array).
@@ -191,14 +527,11 @@ void cgfuncpreamble(struct symtable *sym) {
       */
       size = locvar->size * locvar->nelems;
       size = (size + 7) >> 3;
-      fprintf(Outfile, "  %%%s =l alloc8 %d\n", locvar->name, size);
-    } else if (locvar->type == P_CHAR) {
-      /*
-      // 对于字符变量，在栈上分配 4 字节的内存，
-      // 并将 st_hasaddr 设置为 1，表示已分配地址。
-      */
-      locvar->st_hasaddr = 1;
-      fprintf(Outfile, "  %%%s =l alloc4 1\n", locvar->name);
+      emits("  %");
+      emits(locvar->name);
+      emits(" =l alloc8 ");
+      emitd(size);
+      emitc('\n');
     }
   }
 
@@ -207,30 +540,139 @@ void cgfuncpreamble(struct symtable *sym) {
 
 // Print out a function postamble
 /*这个函数的作用是输出函数的结束标签以及根据函数类型是否为 void 输出相应的返回指令。*/
-void cgfuncpostamble(struct symtable *sym) {
+void qbefuncpostamble(struct symtable *sym) {
    // 输出函数结束的标签
   cglabel(sym->st_endlabel);
 
   // Return a value if the function's type isn't void
    // 如果函数的类型不是 void，则返回一个值
   if (sym->type != P_VOID)
-    fprintf(Outfile, "  ret %%.ret\n}\n");
+    emits("  ret %.ret\n}\n");
   else
-    fprintf(Outfile, "  ret\n}\n");
+    emits("  ret\n}\n");
+
+  // Write out the function's code after the peephole
+  // pass, unless -fno-peephole has turned it off
+  emitflush();
+  if (Infunc) {
+    Infunc = 0;
+    peephole(Funcbuf, Funclen, nexttemp);
+    Funclen = 0;
+  }
+}
+
+// The temporaries which hold integer constants in the
+// current basic block, so that each constant is only
+// loaded once per block. The cache is emptied at each label
+/*当前基本块中保存整数常量的临时变量，每个常量在一个基本块中只加载一次。
+每输出一个标签就清空这个缓存。*/
+enum { NCONSTS = 16 };
+static int Constval[NCONSTS];
+static int Consttype[NCONSTS];
+static int Consttemp[NCONSTS];
+static int Nconsts;
+
+// Return true if temporary r holds a cached constant
+static int cgisconst(int r) {
+  return (r < Constmarkmax && Constmark[r]);
+}
+
+// Mark temporary r as holding a cached constant
+static void cgmarkconst(int r) {
+  int oldmax = Constmarkmax;
+
+  if (r >= Constmarkmax) {
+    Constmarkmax = r * 2 + NCONSTS;
+    Constmark = (char *) realloc(Constmark, Constmarkmax);
+    if (Constmark == NULL)
+      fatal("Unable to malloc in cgmarkconst()");
+    memset(Constmark + oldmax, 0, Constmarkmax - oldmax);
+  }
+  Constmark[r] = 1;
+}
+
+// Return the temporary which will receive the result of an
+// operation on temporary r. This is r itself, unless r holds
+// a cached constant which other expressions may still use
+/*返回对 r 运算的结果所用的临时变量。一般就是 r 本身；
+如果 r 保存的是缓存的常量（其他表达式可能还要用），就换一个新的临时变量。*/
+static int cgdest(int r) {
+  if (cgisconst(r))
+    return (cgalloctemp());
+  return (r);
 }
 
 // Load an integer literal value into a temporary.
-// Return the number of the temporary.
+// Return the number of the temporary. A value
+// already loaded in this basic block is reused
 //这段代码用于将整数字面值加载到一个临时变量中，并返回该临时变量的编号。
-int cgloadint(int value, int type) {
+//同一个基本块中已经加载过的常量直接复用。
+int qbeloadint(int value, int type) {
+  int i, t;
+  int q;
+
+  q = cgqbetype(type);
+
+  for (i = 0; i < Nconsts; i++)
+    if (Constval[i] == value && Consttype[i] == q)
+      return (Consttemp[i]);
+
   // Get a new temporary
   // 获取一个新的临时变量
-  int t = cgalloctemp();//将字面值放入一个寄存器中，然后堆这个寄存器进行操作。
+  t = cgalloctemp();		//将字面值放入一个寄存器中，然后堆这个寄存器进行操作。
+  emitassign(t, q, "copy");
+  emitd(value);
+  emitc('\n');
+
+  // Remember it, starting again if the cache is full
+  if (Nconsts == NCONSTS)
+    Nconsts = 0;
+  Constval[Nconsts] = value;
+  Consttype[Nconsts] = q;
+  Consttemp[Nconsts] = t;
+  Nconsts++;
+  cgmarkconst(t);
+  return (t);
+}
 
-  fprintf(Outfile, "  %%.t%d =%c copy %d\n", t, cgqbetype(type), value);
+// Load a long literal value into a temporary and return
+// the number of the temporary. A value which fits in an
+// int is loaded, and reused, as an int literal would be
+/*把 long 字面值加载到一个临时变量中并返回它的编号。放得进 int 的值按整数字面值加载和复用。*/
+int cgloadlong(long value) {
+  int t;
+
+  if (value >= -2147483647 && value <= 2147483647)
+    return (cgloadint((int) value, P_LONG));
+  t = cgalloctemp();
+  emitassign(t, 'l', "copy");
+  emitld(value);
+  emitc('\n');
   return (t);
 }
 
+// Add offset to a local variable which lives in a temporary.
+// A char variable is zero-extended back to 8 bits
+/*把保存在临时变量中的局部变量加上 offset。char 变量再做一次零扩展，截断回 8 位。*/
+static void cgincvar(struct symtable *sym, int offset) {
+  emits("  %");
+  emits(sym->name);
+  emits(" =");
+  emitc(cgqbetype(sym->type));
+  emits(" add %");
+  emits(sym->name);
+  emits(", ");
+  emitd(offset);
+  emitc('\n');
+  if (sym->type == P_CHAR) {
+    emits("  %");
+    emits(sym->name);
+    emits(" =w extub %");
+    emits(sym->name);
+    emitc('\n');
+  }
+}
+
 // Load a value from a variable into a temporary.
 // Return the number of the temporary. If the
 // operation is pre- or post-increment/decrement,
@@ -238,9 +680,9 @@ int cgloadint(int value, int type) {
 /*这段代码是为了生成汇编代码，从变量（或数组元素）中加载值到一个新的临时寄存器中，
 并且如果有前缀或后缀的增减操作，也会进行相应的计算。*/
 
-int cgloadvar(struct symtable *sym, int op) {
-  int r, posttemp, offset = 1;
-  char qbeprefix;
+int qbeloadvar(struct symtable *sym, int op) {
+  int r, t, offset = 1;
+  char qbeprefix, q;
 
   // Get a new temporary
   //获取新的临时寄存器
@@ -262,257 +704,231 @@ int cgloadvar(struct symtable *sym, int op) {
   qbeprefix = ((sym->class == C_GLOBAL) || (sym->class == C_STATIC) ||
 	       (sym->class == C_EXTERN)) ? '$' : '%';
 
-  // If we have a pre-operation
-  /*如果是前缀增减操作，生成相应的汇编代码，包括加载变量值、执行增减操作、存储回变量。*/
-  //这段操作是为什么利用++或者--来改变地址或者改变值的大小
-  if (op == A_PREINC || op == A_PREDEC) {
-    /*如果符号具有地址或者是全局/静态/外部变量（使用$作为前缀），则执行前缀增减的代码。否则，执行普通的赋值语句。*/
-    if (sym->st_hasaddr || qbeprefix == '$') {
-      // Get a new temporary
-      posttemp = cgalloctemp();
-      /*
-      在前缀增减操作中，首先为存储结果的临时寄存器分配一个新的编号（posttemp）。
-      根据变量的大小生成不同的加载指令（loadub、loadsw、loadl），加载变量的值到新的临时寄存器。
-      执行加法操作，将偏移量加到加载的值上。
-      将结果存储回变量。
-      */
-      switch (sym->size) {
-	case 1:
-	  fprintf(Outfile, "  %%.t%d =w loadub %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  fprintf(Outfile, "  %%.t%d =w add %%.t%d, %d\n", posttemp, posttemp,
-		  offset);
-	  fprintf(Outfile, "  storeb %%.t%d, %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  break;
-	case 4:
-	  fprintf(Outfile, "  %%.t%d =w loadsw %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  fprintf(Outfile, "  %%.t%d =w add %%.t%d, %d\n", posttemp, posttemp,
-		  offset);
-	  fprintf(Outfile, "  storew %%.t%d, %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  break;
-	case 8:
-	  fprintf(Outfile, "  %%.t%d =l loadl %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  fprintf(Outfile, "  %%.t%d =l add %%.t%d, %d\n", posttemp, posttemp,
-		  offset);
-	  fprintf(Outfile, "  storel %%.t%d, %c%s\n", posttemp, qbeprefix,
-		  sym->name);
+  // A variable in memory is loaded once. For an increment or
+  // decrement, the new value is worked out in a second temporary
+  // and stored back, so the variable is never loaded twice
+  /*内存中的变量只加载一次。对于 ++ 或 --，在第二个临时变量中算出新值再存回去，
+  这样变量不会被加载两次。*/
+  if (sym->st_hasaddr || qbeprefix == '$') {
+    emitloadsym(r, sym->size, qbeprefix, sym->name);
+    if (op == A_PREINC || op == A_PREDEC ||
+	op == A_POSTINC || op == A_POSTDEC) {
+      t = cgalloctemp();
+      q = 'w';
+      if (sym->size == 8)
+	q = 'l';
+      emitassign(t, q, "add");
+      emittemp(r);
+      emits(", ");
+      emitd(offset);
+      emitc('\n');
+      emitstoresym(t, sym->size, qbeprefix, sym->name);
+
+      // A pre-operation gives the new value,
+      // which for a char is only 8 bits
+      if (op == A_PREINC || op == A_PREDEC) {
+	if (sym->size == 1) {
+	  emitassign(t, 'w', "extub");
+	  emittemp(t);
+	  emitc('\n');
+	}
+	return (t);
       }
-    } else
-      /*将变量的当前值加上或减去偏移量，并将结果存回相同的变量。这就实现了前缀自增和自减的语义。*/
-      fprintf(Outfile, "  %c%s =%c add %c%s, %d\n",
-	      qbeprefix, sym->name, cgqbetype(sym->type), qbeprefix,
-	      sym->name, offset);//使用变量名作为地址名的参数
+    }
+    return (r);
   }
+
+  // If we have a pre-operation
+  //这段操作是为什么利用++或者--来改变地址或者改变值的大小
+  if (op == A_PREINC || op == A_PREDEC)
+    cgincvar(sym, offset);
+
   // Now load the output temporary with the value
-  /*加载变量值到输出的临时寄存器：*/
-  if (sym->st_hasaddr || qbeprefix == '$') {
-    switch (sym->size) {
-      case 1:
-	fprintf(Outfile, "  %%.t%d =w loadub %c%s\n", r, qbeprefix,
-		sym->name);
-	break;
-      case 4:
-	fprintf(Outfile, "  %%.t%d =w loadsw %c%s\n", r, qbeprefix,
-		sym->name);
-	break;
-      case 8:
-	fprintf(Outfile, "  %%.t%d =l loadl %c%s\n", r, qbeprefix, sym->name);
-    }
-  } else
-    fprintf(Outfile, "  %%.t%d =%c copy %c%s\n",
-	    r, cgqbetype(sym->type), qbeprefix, sym->name);
+  emitassign(r, cgqbetype(sym->type), "copy");
+  emitc('%');
+  emits(sym->name);
+  emitc('\n');
 
   // If we have a post-operation
-  if (op == A_POSTINC || op == A_POSTDEC) {
-    if (sym->st_hasaddr || qbeprefix == '$') {
-      // Get a new temporary
-      posttemp = cgalloctemp();
-      switch (sym->size) {
-	case 1:
-	  fprintf(Outfile, "  %%.t%d =w loadub %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  fprintf(Outfile, "  %%.t%d =w add %%.t%d, %d\n", posttemp, posttemp,
-		  offset);
-	  fprintf(Outfile, "  storeb %%.t%d, %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  break;
-	case 4:
-	  fprintf(Outfile, "  %%.t%d =w loadsw %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  fprintf(Outfile, "  %%.t%d =w add %%.t%d, %d\n", posttemp, posttemp,
-		  offset);
-	  fprintf(Outfile, "  storew %%.t%d, %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  break;
-	case 8:
-	  fprintf(Outfile, "  %%.t%d =l loadl %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-	  fprintf(Outfile, "  %%.t%d =l add %%.t%d, %d\n", posttemp, posttemp,
-		  offset);
-	  fprintf(Outfile, "  storel %%.t%d, %c%s\n", posttemp, qbeprefix,
-		  sym->name);
-      }
-    } else
-      fprintf(Outfile, "  %c%s =%c add %c%s, %d\n",
-	      qbeprefix, sym->name, cgqbetype(sym->type), qbeprefix,
-	      sym->name, offset);
-  }
+  if (op == A_POSTINC || op == A_POSTDEC)
+    cgincvar(sym, offset);
+
   // Return the temporary with the value
   return (r);
 }
 
 // Given the label number of a global string,
 // load its address into a new temporary
-int cgloadglobstr(int label) {
+int qbeloadglobstr(int label) {
+  int r;
+
   // Get a new temporary
-  int r = cgalloctemp();
-  fprintf(Outfile, "  %%.t%d =l copy $L%d\n", r, label);
+  r = cgalloctemp();
+  emitassign(r, 'l', "copy");
+  emits("$L");
+  emitd(label);
+  emitc('\n');
   return (r);
 }
 
 // Add two temporaries together and return
 // the number of the temporary with the result
 /*两个数在寄存器相加，返回其中一个寄存器*/
-int cgadd(int r1, int r2, int type) {
-  fprintf(Outfile, "  %%.t%d =%c add %%.t%d, %%.t%d\n",
-	  r1, cgqbetype(type), r1, r2);
-  return (r1);
+int qbeadd(int r1, int r2, int type) {
+  int t;
+
+  t = cgdest(r1);
+  emitbinop(t, cgqbetype(type), "add", r1, r2);
+  return (t);
 }
 
 // Subtract the second temporary from the first and
 // return the number of the temporary with the result
 /*两个寄存器相减*/
-int cgsub(int r1, int r2, int type) {
-  fprintf(Outfile, "  %%.t%d =%c sub %%.t%d, %%.t%d\n",
-	  r1, cgqbetype(type), r1, r2);
-  return (r1);
+int qbesub(int r1, int r2, int type) {
+  int t;
+
+  t = cgdest(r1);
+  emitbinop(t, cgqbetype(type), "sub", r1, r2);
+  return (t);
 }
 
 // Multiply two temporaries together and return
 // the number of the temporary with the result
 /*两个寄存器相乘*/
-int cgmul(int r1, int r2, int type) {
-  fprintf(Outfile, "  %%.t%d =%c mul %%.t%d, %%.t%d\n",
-	  r1, cgqbetype(type), r1, r2);
-  return (r1);
+int qbemul(int r1, int r2, int type) {
+  int t;
+
+  t = cgdest(r1);
+  emitbinop(t, cgqbetype(type), "mul", r1, r2);
+  return (t);
 }
 
 // Divide or modulo the first temporary by the second and
 // return the number of the temporary with the result
 /*这段代码是用于生成汇编代码，实现整数的除法或取模操作。*/
-int cgdivmod(int r1, int r2, int op, int type) {
+int qbedivmod(int r1, int r2, int op, int type) {
+  int t;
+
+  t = cgdest(r1);
   if (op == A_DIVIDE)
-    fprintf(Outfile, "  %%.t%d =%c div %%.t%d, %%.t%d\n",
-	    r1, cgqbetype(type), r1, r2);
+    emitbinop(t, cgqbetype(type), "div", r1, r2);
   else
-    fprintf(Outfile, "  %%.t%d =%c rem %%.t%d, %%.t%d\n",
-	    r1, cgqbetype(type), r1, r2);
-  return (r1);
+    emitbinop(t, cgqbetype(type), "rem", r1, r2);
+  return (t);
 }
 
 // Bitwise AND two temporaries
-int cgand(int r1, int r2, int type) {
-  fprintf(Outfile, "  %%.t%d =%c and %%.t%d, %%.t%d\n",
-	  r1, cgqbetype(type), r1, r2);
-  return (r1);
+int qbeand(int r1, int r2, int type) {
+  int t;
+
+  t = cgdest(r1);
+  emitbinop(t, cgqbetype(type), "and", r1, r2);
+  return (t);
 }
 
 // Bitwise OR two temporaries
-int cgor(int r1, int r2, int type) {
-  fprintf(Outfile, "  %%.t%d =%c or %%.t%d, %%.t%d\n",
-	  r1, cgqbetype(type), r1, r2);
-  return (r1);
+int qbeor(int r1, int r2, int type) {
+  int t;
+
+  t = cgdest(r1);
+  emitbinop(t, cgqbetype(type), "or", r1, r2);
+  return (t);
 }
 
 // Bitwise XOR two temporaries
-int cgxor(int r1, int r2, int type) {
-  fprintf(Outfile, "  %%.t%d =%c xor %%.t%d, %%.t%d\n",
-	  r1, cgqbetype(type), r1, r2);
-  return (r1);
+int qbexor(int r1, int r2, int type) {
+  int t;
+
+  t = cgdest(r1);
+  emitbinop(t, cgqbetype(type), "xor", r1, r2);
+  return (t);
 }
 
 // Shift left r1 by r2 bits
 /*这函数用于生成汇编代码，实现左移操作。*/
-int cgshl(int r1, int r2, int type) {
-  fprintf(Outfile, "  %%.t%d =%c shl %%.t%d, %%.t%d\n",
-	  r1, cgqbetype(type), r1, r2);
-  return (r1);
+int qbeshl(int r1, int r2, int type) {
+  int t;
+
+  t = cgdest(r1);
+  emitbinop(t, cgqbetype(type), "shl", r1, r2);
+  return (t);
 }
 
 // Shift right r1 by r2 bits
-int cgshr(int r1, int r2, int type) {
-  fprintf(Outfile, "  %%.t%d =%c shr %%.t%d, %%.t%d\n",
-	  r1, cgqbetype(type), r1, r2);
-  return (r1);
+int qbeshr(int r1, int r2, int type) {
+  int t;
+
+  t = cgdest(r1);
+  emitbinop(t, cgqbetype(type), "shr", r1, r2);
+  return (t);
 }
 
 // Negate a temporary's value
-int cgnegate(int r, int type) {
-  fprintf(Outfile, "  %%.t%d =%c sub 0, %%.t%d\n", r, cgqbetype(type), r);
-  return (r);
+int qbenegate(int r, int type) {
+  int t;
+
+  t = cgdest(r);
+  emitassign(t, cgqbetype(type), "sub");
+  emits("0, ");
+  emittemp(r);
+  emitc('\n');
+  return (t);
 }
 
 // Invert a temporary's value
-int cginvert(int r, int type) {
-  fprintf(Outfile, "  %%.t%d =%c xor %%.t%d, -1\n", r, cgqbetype(type), r);
-  return (r);
+int qbeinvert(int r, int type) {
+  int t;
+
+  t = cgdest(r);
+  emitassign(t, cgqbetype(type), "xor");
+  emittemp(r);
+  emits(", -1\n");
+  return (t);
 }
 
 // Logically negate a temporary's value
-int cglognot(int r, int type) {
-  char q = cgqbetype(type);
-  fprintf(Outfile, "  %%.t%d =%c ceq%c %%.t%d, 0\n", r, q, q, r);
-  return (r);
+int qbelognot(int r, int type) {
+  int t;
+  char q;
+
+  t = cgdest(r);
+  q = cgqbetype(type);
+  emitassignq(t, q, "ceq", q);
+  emittemp(r);
+  emits(", 0\n");
+  return (t);
 }
 
 // Load a boolean value (only 0 or 1)
 // into the given temporary
 //将一个布尔值加载到一个临时寄存器中
-void cgloadboolean(int r, int val, int type) {
-  fprintf(Outfile, "  %%.t%d =%c copy %d\n", r, cgqbetype(type), val);
+void qbeloadboolean(int r, int val, int type) {
+  emitassign(r, cgqbetype(type), "copy");
+  emitd(val);
+  emitc('\n');
 }
 
-// Convert an integer value to a boolean value. Jump if
-// it's an IF, WHILE, LOGAND or LOGOR operation
+// Convert an integer value to a boolean value
 /*r 是存储整数值的临时寄存器。
-op 是操作类型，可能是 A_IF、A_WHILE、A_LOGAND 或 A_LOGOR。
-label 是目标标签，用于跳转。
 type 是整数值的类型。*/
-int cgboolean(int r, int op, int label, int type) {
-  // Get a label for the next instruction
-   // 为下一条指令获取一个标签
-  int label2 = genlabel();
-   // 为比较操作分配一个新的临时寄存器
+int qbeboolean(int r, int type) {
+  int r2;
+
   // Get a new temporary for the comparison
-  int r2 = cgalloctemp();
+  // 为比较操作分配一个新的临时寄存器
+  r2 = cgalloctemp();
   // 将临时寄存器的值与零比较，得到布尔值
   // Convert temporary to boolean value
-  fprintf(Outfile, "  %%.t%d =l cne%c %%.t%d, 0\n", r2, cgqbetype(type), r);
-// 根据操作类型生成相应的条件跳转指令
-  switch (op) {
-    case A_IF:
-    case A_WHILE:
-    case A_LOGAND:
-      fprintf(Outfile, "  jnz %%.t%d, @L%d, @L%d\n", r2, label2, label);
-      break;
-    case A_LOGOR:
-      fprintf(Outfile, "  jnz %%.t%d, @L%d, @L%d\n", r2, label, label2);
-      break;
-  }
-
-  // Output the label for the next instruction
-  // 输出下一条指令的标签
-  cglabel(label2);
+  emitassignq(r2, 'l', "cne", cgqbetype(type));
+  emittemp(r);
+  emits(", 0\n");
   return (r2);
 }
 
 // Call a function with the given symbol id.
 // Return the temprary with the result
-int cgcall(struct symtable *sym, int numargs, int *arglist, int *typelist) {
+int qbecall(struct symtable *sym, int numargs, int *arglist, int *typelist) {
   int outr;
   int i;
 
@@ -523,16 +939,22 @@ int cgcall(struct symtable *sym, int numargs, int *arglist, int *typelist) {
   // Call the function
   //生成函数调用汇编代码
   if (sym->type == P_VOID)
-    fprintf(Outfile, "  call $%s(", sym->name);
-  else
-    fprintf(Outfile, "  %%.t%d =%c call $%s(", outr, cgqbetype(sym->type),
-	    sym->name);
+    emits("  call $");
+  else {
+    emitassign(outr, cgqbetype(sym->type), "call");
+    emitc('$');
+  }
+  emits(sym->name);
+  emitc('(');
 
   // Output the list of arguments
   for (i = numargs - 1; i >= 0; i--) {
-    fprintf(Outfile, "%c %%.t%d, ", cgqbetype(typelist[i]), arglist[i]);
+    emitc(cgqbetype(typelist[i]));
+    emitc(' ');
+    emittemp(arglist[i]);
+    emits(", ");
   }
-  fprintf(Outfile, ")\n");
+  emits(")\n");
 
   return (outr);
 }
@@ -540,59 +962,95 @@ int cgcall(struct symtable *sym, int numargs, int *arglist, int *typelist) {
 // Shift a temporary left by a constant. As we only
 // use this for address calculations, extend the
 // type to be a QBE 'l' if required
-int cgshlconst(int r, int val, int type) {
-  int r2 = cgalloctemp();
-  int r3 = cgalloctemp();
+int qbeshlconst(int r, int val, int type) {
+  int r2, r3;
+
+  r2 = cgalloctemp();
+  r3 = cgalloctemp();
   //
   if (cgprimsize(type) < 8) {
-    fprintf(Outfile, "  %%.t%d =l extsw %%.t%d\n", r2, r);
-    fprintf(Outfile, "  %%.t%d =l shl %%.t%d, %d\n", r3, r2, val);
-  } else
-    fprintf(Outfile, "  %%.t%d =l shl %%.t%d, %d\n", r3, r, val);
+    emitassign(r2, 'l', "extsw");
+    emittemp(r);
+    emitc('\n');
+    r = r2;
+  }
+  emitassign(r3, 'l', "shl");
+  emittemp(r);
+  emits(", ");
+  emitd(val);
+  emitc('\n');
   return (r3);
 }
 
 // Store a temporary's value into a global variable
 /*这段代码负责将一个临时变量的值存储到一个全局变量中。*/
-int cgstorglob(int r, struct symtable *sym) {
+int qbestorglob(int r, struct symtable *sym) {
+  char q;
 
   // We can store to bytes in memory
-  char q = cgqbetype(sym->type);
+  q = cgqbetype(sym->type);
   if (sym->type == P_CHAR)
     q = 'b';
 
-  fprintf(Outfile, "  store%c %%.t%d, $%s\n", q, r, sym->name);
+  emits("  store");
+  emitc(q);
+  emitc(' ');
+  emittemp(r);
+  emits(", $");
+  emits(sym->name);
+  emitc('\n');
   //返回临时寄存器编号： 返回临时寄存器编号 r，这是存储操作的结果。
   return (r);
 }
 
 // Store a temporary's value into a local variable
 //这段代码实现了将临时变量的值存储到局部变量中的逻辑。
-int cgstorlocal(int r, struct symtable *sym) {
-
+int qbestorlocal(int r, struct symtable *sym) {
   // If the variable is on the stack, use store instructions
   if (sym->st_hasaddr) {
-    fprintf(Outfile, "  store%c %%.t%d, %%%s\n",
-	    cgqbetype(sym->type), r, sym->name);
+    emits("  store");
+    emitc(cgqbetype(sym->type));
+    emitc(' ');
+    emittemp(r);
+    emits(", %");
+    emits(sym->name);
+  } else if (sym->type == P_CHAR) {
+    // A char in a temporary is zero-extended to 8 bits
+    emits("  %");
+    emits(sym->name);
+    emits(" =w extub ");
+    emittemp(r);
   } else {
-    fprintf(Outfile, "  %%%s =%c copy %%.t%d\n",
-	    sym->name, cgqbetype(sym->type), r);
+    emits("  %");
+    emits(sym->name);
+    emits(" =");
+    emitc(cgqbetype(sym->type));
+    emits(" copy ");
+    emittemp(r);
   }
+  emitc('\n');
   return (r);
 }
 
+// Output a run of zero bytes as a single z item
+static void emitzeroes(int count, int started) {
+  if (started)
+    emits(", ");
+  emits("z ");
+  emitd(count);
+}
+
 // Generate a global symbol but not functions
 /*这段代码是一个用于生成全局符号（global symbol）的函数，但不包括函数（functions）。这个函数主要用于处理程序中的全局变量和全局数组。*/
-void cgglobsym(struct symtable *node) {
+void qbeglobsym(struct symtable *node) {
   int size, type;
   int initvalue;
-  int i;
+  int i, zeroes, last, letter, started;
 
   if (node == NULL)
     return;
   if (node->stype == S_FUNCTION)
     return;
-
   // Get the size of the variable (or its elements if an array)
   // and the type of the variable
   /*如果节点的类型是数组（S_ARRAY），则获取数组元素的类型和大小。*/
@@ -611,66 +1069,132 @@ void cgglobsym(struct symtable *node) {
 如果变量的类型是结构体或联合体，则生成相应的数据标签和对齐信息。*/
   cgdataseg();
   if (node->class == C_GLOBAL)
-    fprintf(Outfile, "export ");
+    emits("export ");
+  emits("data $");
+  emits(node->name);
+  emits(" = align ");
   if ((node->type == P_STRUCT) || (node->type == P_UNION))
-    fprintf(Outfile, "data $%s = align 8 { ", node->name);
+    emitd(8);
   else
-    fprintf(Outfile, "data $%s = align %d { ", node->name, cgprimsize(type));
+    emitd(cgprimsize(type));
+  emits(" { ");
+
+  // A variable with no initial values is all zeroes. This
+  // goes out as one z item, which qbe puts in the bss section
+  /*没有初始值的变量全部为零，输出为一个 z 项，qbe 会把它放到 bss 段。*/
+  if (node->initlist == NULL) {
+    if (node->nelems > 0)
+      emitzeroes(size * node->nelems, 0);
+    emits(" }\n");
+    return;
+  }
 
-  // Output space for one or more elements
-  /*使用循环遍历数组的每个元素，为每个元素生成相应的空间和初始值。
-  根据元素的大小和类型，生成相应的汇编代码。支持1字节（b）、4字节（w）和8字节（l）大小的元素，以及其他大小的元素（z）。*/
+  // Output the initial values. A run of zero elements
+  // becomes one z item, and a run of non-zero values
+  // shares one type letter, e.g. { w 1 2 2 2, z 400, w 7 }
+  /*输出初始值。连续的零元素合并成一个 z 项，连续的非零值共用一个类型字母，
+  例如 { w 1 2 2 2, z 400, w 7 }。last 记录当前项的类型字母，0 表示当前不在一个值项中。*/
+  zeroes = 0;
+  last = 0;
+  started = 0;
   for (i = 0; i < node->nelems; i++) {
+    initvalue = node->initlist[i];
+
+    // Get the type letter for this element. Elements
+    // of other sizes are structs which are zeroed
+    letter = 0;
+    if (initvalue != 0) {
+      if (size == 1)
+	letter = 'b';
+      if (size == 4)
+	letter = 'w';
+      if (size == 8)
+	letter = 'l';
+    }
+
+    if (letter == 0) {
+      zeroes = zeroes + size;
+    } else {
+      // Flush any run of zeroes before this value
+      if (zeroes > 0) {
+	emitzeroes(zeroes, started);
+	zeroes = 0;
+	last = 0;
+	started = 1;
+      }
 
-    // Get any initial value
-    initvalue = 0;
-    if (node->initlist != NULL)
-      initvalue = node->initlist[i];
-
-    // Generate the space for this type
-    switch (size) {
-      case 1:
-	fprintf(Outfile, "b %d, ", initvalue);
-	break;
-      case 4:
-	fprintf(Outfile, "w %d, ", initvalue);
-	break;
-      case 8:
-	// Generate the pointer to a string literal. Treat a zero value
-	// as actually zero, not the label L0
-  /*这段代码是处理大小为8字节的情况，通常用于处理指针类型或者长整型等数据。*/
-	if (node->initlist != NULL && type == pointer_to(P_CHAR)
-	    && initvalue != 0)/*这个条件是判断是否是指针的条件*/
-	  fprintf(Outfile, "l $L%d, ", initvalue);
-	else
-	  fprintf(Outfile, "l %d, ", initvalue);
-	break;
-      default:
-	fprintf(Outfile, "z %d, ", size);
+      // Start a new item if the type letter changes
+      if (letter != last) {
+	if (started)
+	  emits(", ");
+	emitc(letter);
+	last = letter;
+	started = 1;
+      }
+      emitc(' ');
+
+      // Generate the pointer to a string literal. Treat a
+      // zero value as actually zero, not the label L0
+      if (size == 8 && type == pointer_to(P_CHAR))
+	emits("$L");
+      emitd(initvalue);
     }
   }
-  fprintf(Outfile, "}\n");
+  if (zeroes > 0)
+    emitzeroes(zeroes, started);
+  emits(" }\n");
+}
+
+// Output s as a quoted QBE string. Printable characters
+// go out as they are. Anything else, and the quote and
+// backslash characters, go out as three-digit octal escapes
+/*把 s 输出为带引号的 QBE 字符串。可打印字符原样输出，
+其他字符以及引号和反斜杠输出为三位八进制转义。*/
+void emitstring(char *s) {
+  int c, d;
+
+  emitc('"');
+  while (*s) {
+    c = *s & 0xff;
+    if (c < ' ' || c > '~' || c == '"' || c == '\\') {
+      emitc('\\');
+      d = c >> 6;
+      emitc('0' + d);
+      d = (c >> 3) & 7;
+      emitc('0' + d);
+      d = c & 7;
+      emitc('0' + d);
+    } else
+      emitc(c);
+    s++;
+  }
+  emitc('"');
 }
 
 // Generate a global string and its label.
 // Don't output the label if append is true.
+// The characters go out as a single QBE string
 /*，用于生成全局字符串以及与之相关联的标签。
-data $L1 = { b 72, b 101, b 108, b 108, b 111, b 44, b 32, b 87, b 111, b 114, b 108, b 100 }
+data $L1 = { b "Hello, World", b 0 }
 */
-void cgglobstr(int l, char *strvalue, int append) {
-  char *cptr;
-  if (!append)
-    fprintf(Outfile, "data $L%d = { ", l);
+void qbeglobstr(int l, char *strvalue, int append) {
+  if (!append) {
+    emits("data $L");
+    emitd(l);
+    emits(" = { ");
+  }
 
-  for (cptr = strvalue; *cptr; cptr++) {
-    fprintf(Outfile, "b %d, ", *cptr);
+  if (*strvalue) {
+    emits("b ");
+    emitstring(strvalue);
+    emits(", ");
   }
 }
 
 // NUL terminate a global string
 /*在之后追加字符*/
-void cgglobstrend(void) {
-  fprintf(Outfile, " b 0 }\n");
+void qbeglobstrend(void) {
+  emits("b 0 }\n");
 }
 
 // List of comparison instructions,
@@ -678,7 +1202,7 @@ void cgglobstrend(void) {
 static char *cmplist[] = { "ceq", "cne", "cslt", "csgt", "csle", "csge" };
 
 // Compare two temporaries and set if true.
-int cgcompare_and_set(int ASTop, int r1, int r2, int type) {
+int qbecompare_and_set(int ASTop, int r1, int r2, int type) {
   int r3;
   char q = cgqbetype(type);
 
@@ -686,25 +1210,32 @@ int cgcompare_and_set(int ASTop, int r1, int r2, int type) {
   /*确保 ASTop 的范围在 A_EQ 到 A_GE 之间，以防止出现无效的 AST 操作符。*/
   if (ASTop < A_EQ || ASTop > A_GE)
     fatal("Bad ASTop in cgcompare_and_set()");
-
   // Get a new temporary for the comparison
   /*获取一个新的临时寄存器 r3 用于存储比较的结果。*/
   r3 = cgalloctemp();
-  /*使用 fprintf 生成比较操作的汇编代码，将结果存储在 r3 中。
+  /*生成比较操作的汇编代码，将结果存储在 r3 中。
   比较操作的具体内容由 cmplist[ASTop - A_EQ] 给出，而 q 是由 cgqbetype(type) 计算得到的比较操作的类型。*/
-  fprintf(Outfile, "  %%.t%d =%c %s%c %%.t%d, %%.t%d\n",
-	  r3, q, cmplist[ASTop - A_EQ], q, r1, r2);
+  emitassignq(r3, q, cmplist[ASTop - A_EQ], q);
+  emittemp(r1);
+  emits(", ");
+  emittemp(r2);
+  emitc('\n');
   return (r3);
 }
 
 // Generate a label
-void cglabel(int l) {
-  fprintf(Outfile, "@L%d\n", l);
+void qbelabel(int l) {
+  // A label starts a new basic block
+  Nconsts = 0;
+  emitlabel(l);
+  emitc('\n');
 }
 
 // Generate a jump to a label
-void cgjump(int l) {
-  fprintf(Outfile, "  jmp @L%d\n", l);
+void qbejump(int l) {
+  emits("  jmp ");
+  emitlabel(l);
+  emitc('\n');
 }
 
 // List of inverted jump instructions,
@@ -718,7 +1249,7 @@ r1, r2: 在比较中使用的临时寄存器索引。
 label: 如果比较条件为真，则跳转到的标签。
 type: 被比较值的数据类型，这会影响比较操作的方式。
 */
-int cgcompare_and_jump(int ASTop, int r1, int r2, int label, int type) {
+int qbecompare_and_jump(int ASTop, int r1, int r2, int label, int type) {
   int label2;
   int r3;
   //这可能将 type 参数转换为表示比较操作中使用的类型限定符的字符。
@@ -727,7 +1258,6 @@ int cgcompare_and_jump(int ASTop, int r1, int r2, int label, int type) {
   // Check the range of the AST operation
   if (ASTop < A_EQ || ASTop > A_GE)
     fatal("Bad ASTop in cgcompare_and_set()");
-
   // Get a label for the next instruction
   //生成用于条件为假时分支的新标签。
   label2 = genlabel();
@@ -756,27 +1286,107 @@ int cgcompare_and_jump(int ASTop, int r1, int r2, int label, int type) {
   第一行执行使用经过 ASTop - A_EQ 调整的操作符的 r1 和 r2 之间的比较。结果存储在 r3 中。
   第二行输出条件跳转指令（jnz），如果 r3 非零（真）则跳转到 label，为零（假）则跳转到 label2。
   */
-  fprintf(Outfile, "  %%.t%d =%c %s%c %%.t%d, %%.t%d\n",
-	  r3, q, invcmplist[ASTop - A_EQ], q, r1, r2);
+  emitassignq(r3, q, invcmplist[ASTop - A_EQ], q);
+  emittemp(r1);
+  emits(", ");
+  emittemp(r2);
+  emitc('\n');
   //  %.t1 => cmp> %.t2, %.t3
-  fprintf(Outfile, "  jnz %%.t%d, @L%d, @L%d\n", r3, label, label2);
+  emitjnz(r3, label, label2);
   //    jnz %.t1, @L100, @L200
   cglabel(label2);
   return (NOREG);
 }
 
+// Compare two temporaries and jump to Ltrue if the
+// comparison is true, or to Lfalse if it is false
+void qbecompare_and_branch(int ASTop, int r1, int r2, int Ltrue,
+			  int Lfalse, int type) {
+  int r3;
+  char q = cgqbetype(type);
+
+  if (ASTop < A_EQ || ASTop > A_GE)
+    fatal("Bad ASTop in cgcompare_and_branch()");
+  r3 = cgalloctemp();
+  emitassignq(r3, 'w', cmplist[ASTop - A_EQ], q);
+  emittemp(r1);
+  emits(", ");
+  emittemp(r2);
+  emitc('\n');
+  emitjnz(r3, Ltrue, Lfalse);
+}
+
+// Jump to Ltrue if temporary r is not zero,
+// or to Lfalse if it is zero. jnz only
+// looks at a word, so compare a long to zero
+void qbebranch(int r, int Ltrue, int Lfalse, int type) {
+  int r2;
+  char q;
+
+  q = cgqbetype(type);
+  if (q == 'l') {
+    r2 = cgalloctemp();
+    emitassignq(r2, 'w', "cne", q);
+    emittemp(r);
+    emits(", 0\n");
+    r = r2;
+  }
+  emitjnz(r, Ltrue, Lfalse);
+}
+
+// Jump to the label if the value in temporary r is in the
+// range lo ... hi, otherwise fall through. A range of one
+// value is an equality test, a longer range is tested with
+// one unsigned comparison of r - lo against hi - lo
+/*如果临时变量 r 的值在 lo ... hi 之间就跳转到 label，否则继续执行下一条指令。*/
+int qberange_and_jump(int r, int lo, int hi, int label, int type) {
+  int label2;
+  int r2, r3;
+  char q;
+
+  q = cgqbetype(type);
+  label2 = genlabel();
+  r3 = cgalloctemp();
+  if (lo == hi) {
+    emitassignq(r3, q, "ceq", q);
+    emittemp(r);
+    emits(", ");
+    emitd(lo);
+  } else {
+    r2 = cgalloctemp();
+    emitassign(r2, q, "sub");
+    emittemp(r);
+    emits(", ");
+    emitd(lo);
+    emitc('\n');
+    emitassignq(r3, q, "cule", q);
+    emittemp(r2);
+    emits(", ");
+    emitd(hi - lo);
+  }
+  emitc('\n');
+  emitjnz(r3, label, label2);
+  cglabel(label2);
+  return (NOREG);
+}
+
 // Widen the value in the temporary from the old
 // to the new type, and return a temporary with
 // this new value
 /*
 这段代码是用于执行类型宽化（Type Widening）操作的函数。
 类型宽化是将变量的类型从较小的类型扩展到较大的类型，以适应目标类型的过程。*/
-int cgwiden(int r, int oldtype, int newtype) {
+int qbewiden(int r, int oldtype, int newtype) {
   char oldq = cgqbetype(oldtype);
   char newq = cgqbetype(newtype);
+  int t;
 
+  // A long is already as wide as it gets, e.g.
+  // when a long is added to a char pointer
+  if (oldq == 'l')
+    return (r);
   // Get a new temporary
-  int t = cgalloctemp();
+  t = cgalloctemp();
 
   switch (oldtype) {
     /*
@@ -786,11 +1396,13 @@ int cgwiden(int r, int oldtype, int newtype) {
     生成的 QBE 指令为 " %%.t%d =%c exts%c %%.t%d\n"。
     */
     case P_CHAR:
-      fprintf(Outfile, "  %%.t%d =%c extub %%.t%d\n", t, newq, r);
+      emitassign(t, newq, "extub");
       break;
     default:
-      fprintf(Outfile, "  %%.t%d =%c exts%c %%.t%d\n", t, newq, oldq, r);
+      emitassignq(t, newq, "exts", oldq);
   }
+  emittemp(r);
+  emitc('\n');
   return (t);
 }
 
@@ -799,11 +1411,15 @@ int cgwiden(int r, int oldtype, int newtype) {
 reg: 表示包含返回值的寄存器的编号。NOREG 表示没有返回值。
 sym: 函数符号表条目，包含函数的信息
 */
-void cgreturn(int reg, struct symtable *sym) {
-
+void qbereturn(int reg, struct symtable *sym) {
   // Only return a value if we have a value to return
-  if (reg != NOREG)
-    fprintf(Outfile, "  %%.ret =%c copy %%.t%d\n", cgqbetype(sym->type), reg);
+  if (reg != NOREG) {
+    emits("  %.ret =");
+    emitc(cgqbetype(sym->type));
+    emits(" copy ");
+    emittemp(reg);
+    emitc('\n');
+  }
 
   cgjump(sym->st_endlabel);
 }
@@ -811,38 +1427,47 @@ void cgreturn(int reg, struct symtable *sym) {
 // Generate code to load the address of an
 // identifier. Return a new temporary
 /*取地址的操作*/
-int cgaddress(struct symtable *sym) {
-  int r = cgalloctemp();
-  char qbeprefix = ((sym->class == C_GLOBAL) || (sym->class == C_STATIC) ||
-		    (sym->class == C_EXTERN)) ? '$' : '%';
+int qbeaddress(struct symtable *sym) {
+  int r;
+  char qbeprefix;
 
-  fprintf(Outfile, "  %%.t%d =l copy %c%s\n", r, qbeprefix, sym->name);
+  r = cgalloctemp();
+  qbeprefix = ((sym->class == C_GLOBAL) || (sym->class == C_STATIC) ||
+	       (sym->class == C_EXTERN)) ? '$' : '%';
+  emitassign(r, 'l', "copy");
+  emitc(qbeprefix);
+  emits(sym->name);
+  emitc('\n');
   return (r);
 }
 
 // Dereference a pointer to get the value
 // it points at into a new temporary
-int cgderef(int r, int type) {
+int qbederef(int r, int type) {
+  int newtype, size, ret;
+
   // Get the type that we are pointing to
-  int newtype = value_at(type);
+  newtype = value_at(type);
   // Now get the size of this type
-  int size = cgprimsize(newtype);
+  size = cgprimsize(newtype);
   // Get temporary for the return result
-  int ret = cgalloctemp();
+  ret = cgalloctemp();
 
   switch (size) {
     case 1:
-      fprintf(Outfile, "  %%.t%d =w loadub %%.t%d\n", ret, r);
+      emitassign(ret, 'w', "loadub");
       break;
     case 4:
-      fprintf(Outfile, "  %%.t%d =w loadsw %%.t%d\n", ret, r);
+      emitassign(ret, 'w', "loadsw");
       break;
     case 8:
-      fprintf(Outfile, "  %%.t%d =l loadl %%.t%d\n", ret, r);
+      emitassign(ret, 'l', "loadl");
       break;
     default:
       fatald("Can't cgderef on type:", type);
   }
+  emittemp(r);
+  emitc('\n');
   return (ret);
 }
 
@@ -862,29 +1487,37 @@ int value = *ptr;
 // 修改指针所指向的内存中的值
 *ptr = 20;
 */
-int cgstorderef(int r1, int r2, int type) {
+int qbestorderef(int r1, int r2, int type) {
+  int size;
+
   // Get the size of the type
-  int size = cgprimsize(type);
+  size = cgprimsize(type);
 
   switch (size) {
     case 1:
-      fprintf(Outfile, "  storeb %%.t%d, %%.t%d\n", r1, r2);
+      emits("  storeb ");
       break;
     case 4:
-      fprintf(Outfile, "  storew %%.t%d, %%.t%d\n", r1, r2);
+      emits("  storew ");
       break;
     case 8:
-      fprintf(Outfile, "  storel %%.t%d, %%.t%d\n", r1, r2);
+      emits("  storel ");
       break;
     default:
       fatald("Can't cgstoderef on type:", type);
   }
+  emittemp(r1);
+  emits(", ");
+  emittemp(r2);
+  emitc('\n');
   return (r1);
 }
 
 // Move value between temporaries
-void cgmove(int r1, int r2, int type) {
-  fprintf(Outfile, "  %%.t%d =%c copy %%.t%d\n", r2, cgqbetype(type), r1);
+void qbemove(int r1, int r2, int type) {
+  emitassign(r2, cgqbetype(type), "copy");
+  emittemp(r1);
+  emitc('\n');
 }
 
 // Output a gdb directive to say on which
@@ -896,7 +1529,7 @@ void cglinenum(int line) {
 
 // Change a temporary value from its old
 // type to a new type.
-int cgcast(int t, int oldtype, int newtype) {
+int qbecast(int t, int oldtype, int newtype) {
   // Get temporary for the return result
   int ret = cgalloctemp();
   int oldsize, newsize;
@@ -925,8 +1558,10 @@ int cgcast(int t, int oldtype, int newtype) {
   // If the new size is smaller, we can copy and QBE will truncate it,
   // otherwise use the QBE cast operation
   if (newsize < oldsize)
-    fprintf(Outfile, " %%.t%d =%c copy %%.t%d\n", ret, qnew, t);
+    emitassign(ret, qnew, "copy");
   else
-    fprintf(Outfile, " %%.t%d =%c cast %%.t%d\n", ret, qnew, t);
+    emitassign(ret, qnew, "cast");
+  emittemp(t);
+  emitc('\n');
   return (ret);
 }
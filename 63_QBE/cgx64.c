@@ -0,0 +1,826 @@
+#include "defs.h"
+#include "data.h"
+#include "decl.h"
+
+// Code generator for x86-64 which writes assembly code
+// directly, without going through QBE. It is used with -O0.
+// Copyright (c) 2019 Warren Toomey, GPL3
+
+// With -O0 the cgxxx() functions in backend.c call these
+// x64xxx() ones instead of the qbexxx() ones in cg.c, so the
+// rest of the compiler doesn't know which one is being used. Each temporary gets its own
+// 8-byte slot on the stack below the local variables, and
+// every instruction loads its operands from their slots
+// into registers and stores the result back. All local
+// variables and parameters live on the stack too.
+/*使用 -O0 时，backend.c 中的 cgxxx() 函数调用这里的 x64xxx() 函数，而不是 cg.c 中的 qbexxx() 函数，编译器的其余部分不知道用的是哪一个。
+每个临时变量在局部变量下面的栈上有自己的 8 字节槽，每条指令把操作数从槽中
+装入寄存器，再把结果存回去。所有局部变量和参数也都放在栈上。*/
+//
+// A 'w' temporary only has a valid value in its lower 32
+// bits, as with QBE. The operations on it use the 32-bit
+// registers, and it is sign-extended when it is widened
+
+static char *Funcname;		// Name of the function being generated
+static int Localsz;		// Bytes of locals and parameters
+
+// The registers for the first six arguments to a function
+static char *argreg[] = { "%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9" };
+
+// The condition codes for each comparison, and the inverted
+// ones, in AST order: A_EQ, A_NE, A_LT, A_GT, A_LE, A_GE
+static char *cclist[] = { "e", "ne", "l", "g", "le", "ge" };
+static char *invcclist[] = { "ne", "e", "ge", "le", "g", "l" };
+
+// Return true if the type is a QBE 'l', i.e. 8 bytes wide
+static int islong(int type) {
+  return (cgqbetype(type) == 'l');
+}
+
+// Output the stack slot of temporary t
+static void emitslot(int t) {
+  emitd(-(Localsz + 8 * t));
+  emits("(%rbp)");
+}
+
+// Output a label, .Lfunction.n. Labels are
+// only numbered uniquely inside each function
+static void emitlabel(int l) {
+  emits(".L");
+  emits(Funcname);
+  emitc('.');
+  emitd(l);
+}
+
+// Output the symbol for the size of the function's frame
+static void emitframe(void) {
+  emits(".L");
+  emits(Funcname);
+  emits(".frame");
+}
+
+// Output the memory operand for a variable
+static void emitvar(struct symtable *sym) {
+  if ((sym->class == C_GLOBAL) || (sym->class == C_STATIC) ||
+      (sym->class == C_EXTERN)) {
+    emits(sym->name);
+    emits("(%rip)");
+  } else {
+    emitd(sym->st_offset);
+    emits("(%rbp)");
+  }
+}
+
+// Load temporary t into %rax
+static void loadrax(int t) {
+  emits("  movq ");
+  emitslot(t);
+  emits(", %rax\n");
+}
+
+// Store %rax into temporary t
+static void storerax(int t) {
+  emits("  movq %rax, ");
+  emitslot(t);
+  emitc('\n');
+}
+
+// Output the suffix and the accumulator register
+// for an operation on a value of the given type
+static void emitsuffix(int type) {
+  if (islong(type))
+    emitc('q');
+  else
+    emitc('l');
+}
+
+static void emitrax(int type) {
+  if (islong(type))
+    emits("%rax");
+  else
+    emits("%eax");
+}
+
+// Load a value of the given size from memory
+// into %rax. The memory operand follows
+static void emitloadsize(int size) {
+  switch (size) {
+    case 1:
+      emits("  movzbl ");
+      break;
+    case 4:
+      emits("  movl ");
+      break;
+    default:
+      emits("  movq ");
+  }
+}
+
+// Output the register to store %rax into
+// memory for a value of the given size
+static void emitstoresize(int size) {
+  switch (size) {
+    case 1:
+      emits("  movb %al, ");
+      break;
+    case 4:
+      emits("  movl %eax, ");
+      break;
+    default:
+      emits("  movq %rax, ");
+  }
+}
+
+// Output the register which a load of the given size sets
+static void emitloadreg(int size) {
+  if (size == 8)
+    emits(", %rax\n");
+  else
+    emits(", %eax\n");
+}
+
+// Print out the assembly preamble for one output file.
+// The stack doesn't need to be executable
+void x64preamble(char *filename) {
+  emits("  .section .note.GNU-stack,\"\",@progbits\n");
+}
+
+// Print out a function preamble. Give each parameter and
+// local variable its place on the stack, and copy the
+// parameters there from their registers or the caller's frame
+void x64funcpreamble(struct symtable *sym) {
+  struct symtable *parm, *locvar;
+  int size, i;
+
+  cgresettemps();
+  Funcname = sym->name;
+  Localsz = 0;
+  for (parm = sym->member; parm != NULL; parm = parm->next) {
+    Localsz = Localsz + 8;
+    parm->st_offset = -Localsz;
+  }
+
+  // Round each local up to a multiple of 8 bytes, to
+  // ensure that pointers are aligned on 8-byte boundaries
+  for (locvar = Loclhead; locvar != NULL; locvar = locvar->next) {
+    size = locvar->size * locvar->nelems;
+    size = (size + 7) & ~7;
+    Localsz = Localsz + size;
+    locvar->st_offset = -Localsz;
+  }
+
+  // The size of the frame is only known once the
+  // temporaries have been counted in x64funcpostamble()
+  emits("  .text\n");
+  if (sym->class == C_GLOBAL) {
+    emits("  .globl ");
+    emits(Funcname);
+    emitc('\n');
+  }
+  emits(Funcname);
+  emits(":\n  pushq %rbp\n  movq %rsp, %rbp\n  subq $");
+  emitframe();
+  emits(", %rsp\n");
+
+  // The first six parameters come in registers, the rest
+  // are above the return address. A whole 8 bytes is
+  // stored, as the variables are only loaded at their size
+  i = 0;
+  for (parm = sym->member; parm != NULL; parm = parm->next) {
+    if (i < 6) {
+      emits("  movq ");
+      emits(argreg[i]);
+    } else {
+      emits("  movq ");
+      emitd(16 + 8 * (i - 6));
+      emits("(%rbp), %rax\n  movq %rax");
+    }
+    emits(", ");
+    emitd(parm->st_offset);
+    emits("(%rbp)\n");
+    i++;
+  }
+}
+
+// Print out a function postamble. Now that we know how many
+// temporaries there are, set the frame size, which is kept
+// to a multiple of 16 bytes so that calls are aligned
+void x64funcpostamble(struct symtable *sym) {
+  int frame = (Localsz + 8 * cgnumtemps() + 15) & ~15;
+
+  x64label(sym->st_endlabel);
+  emits("  leave\n  ret\n  .set ");
+  emitframe();
+  emits(", ");
+  emitd(frame);
+  emitc('\n');
+}
+
+// Load an integer literal value into a temporary
+int x64loadint(int value, int type) {
+  int t = cgalloctemp();
+
+  emits("  movq $");
+  emitd(value);
+  emits(", ");
+  emitslot(t);
+  emitc('\n');
+  return (t);
+}
+
+// Load a value from a variable into a temporary. If the
+// operation is pre- or post-increment/decrement, also
+// perform this action. A post-operation gives the old value
+int x64loadvar(struct symtable *sym, int op) {
+  int r, offset = 1;
+  int size = sym->size;
+
+  r = cgalloctemp();
+  if (size != 1 && size != 4 && size != 8)
+    return (r);
+
+  // If the symbol is a pointer, use the size
+  // of the type that it points to as any
+  // increment or decrement. If not, it's one.
+  if (ptrtype(sym->type))
+    offset = typesize(value_at(sym->type), sym->ctype);
+  if (op == A_PREDEC || op == A_POSTDEC)
+    offset = -offset;
+
+  emitloadsize(size);
+  emitvar(sym);
+  emitloadreg(size);
+  if (op == A_PREINC || op == A_PREDEC ||
+      op == A_POSTINC || op == A_POSTDEC) {
+    if (op == A_POSTINC || op == A_POSTDEC)
+      storerax(r);
+    if (size == 8)
+      emits("  addq $");
+    else
+      emits("  addl $");
+    emitd(offset);
+    if (size == 8)
+      emits(", %rax\n");
+    else
+      emits(", %eax\n");
+    emitstoresize(size);
+    emitvar(sym);
+    emitc('\n');
+
+    // A pre-operation gives the new value,
+    // which for a char is only 8 bits
+    if (op == A_POSTINC || op == A_POSTDEC)
+      return (r);
+    if (size == 1)
+      emits("  movzbl %al, %eax\n");
+  }
+  storerax(r);
+  return (r);
+}
+
+// Given the label number of a global string,
+// load its address into a new temporary
+int x64loadglobstr(int label) {
+  int r = cgalloctemp();
+
+  emits("  leaq L");
+  emitd(label);
+  emits("(%rip), %rax\n");
+  storerax(r);
+  return (r);
+}
+
+// Do a two-operand instruction, "r1 = r1 op r2",
+// and return the temporary with the result
+static int x64binop(char *op, int r1, int r2, int type) {
+  loadrax(r1);
+  emits("  ");
+  emits(op);
+  emitsuffix(type);
+  emitc(' ');
+  emitslot(r2);
+  emits(", ");
+  emitrax(type);
+  emitc('\n');
+  storerax(r1);
+  return (r1);
+}
+
+int x64add(int r1, int r2, int type) {
+  return (x64binop("add", r1, r2, type));
+}
+
+int x64sub(int r1, int r2, int type) {
+  return (x64binop("sub", r1, r2, type));
+}
+
+int x64mul(int r1, int r2, int type) {
+  return (x64binop("imul", r1, r2, type));
+}
+
+int x64and(int r1, int r2, int type) {
+  return (x64binop("and", r1, r2, type));
+}
+
+int x64or(int r1, int r2, int type) {
+  return (x64binop("or", r1, r2, type));
+}
+
+int x64xor(int r1, int r2, int type) {
+  return (x64binop("xor", r1, r2, type));
+}
+
+// Divide or modulo the first temporary by the second
+int x64divmod(int r1, int r2, int op, int type) {
+  loadrax(r1);
+  if (islong(type))
+    emits("  cqto\n  idivq ");
+  else
+    emits("  cltd\n  idivl ");
+  emitslot(r2);
+  emitc('\n');
+  if (op == A_DIVIDE)
+    storerax(r1);
+  else {
+    emits("  movq %rdx, ");
+    emitslot(r1);
+    emitc('\n');
+  }
+  return (r1);
+}
+
+// Shift r1 left or right by r2 bits. As with
+// QBE, a right shift is a logical one
+static int x64shift(char *op, int r1, int r2, int type) {
+  loadrax(r1);
+  emits("  movq ");
+  emitslot(r2);
+  emits(", %rcx\n  ");
+  emits(op);
+  emitsuffix(type);
+  emits(" %cl, ");
+  emitrax(type);
+  emitc('\n');
+  storerax(r1);
+  return (r1);
+}
+
+int x64shl(int r1, int r2, int type) {
+  return (x64shift("shl", r1, r2, type));
+}
+
+int x64shr(int r1, int r2, int type) {
+  return (x64shift("shr", r1, r2, type));
+}
+
+// Do a one-operand instruction on a temporary
+static int x64unop(char *op, int r, int type) {
+  loadrax(r);
+  emits("  ");
+  emits(op);
+  emitsuffix(type);
+  emitc(' ');
+  emitrax(type);
+  emitc('\n');
+  storerax(r);
+  return (r);
+}
+
+int x64negate(int r, int type) {
+  return (x64unop("neg", r, type));
+}
+
+int x64invert(int r, int type) {
+  return (x64unop("not", r, type));
+}
+
+// Output a comparison of temporary r with zero
+static void cmpzero(int r, int type) {
+  emits("  cmp");
+  emitsuffix(type);
+  emits(" $0, ");
+  emitslot(r);
+  emitc('\n');
+}
+
+// Output a comparison of two temporaries
+static void cmptemps(int r1, int r2, int type) {
+  loadrax(r1);
+  emits("  cmp");
+  emitsuffix(type);
+  emitc(' ');
+  emitslot(r2);
+  emits(", ");
+  emitrax(type);
+  emitc('\n');
+}
+
+// Set temporary r to 1 if the last comparison
+// had the condition code cc, otherwise to 0
+static void setcc(char *cc, int r) {
+  emits("  set");
+  emits(cc);
+  emits(" %al\n  movzbl %al, %eax\n");
+  storerax(r);
+}
+
+// Output a jump to label l on the condition code cc
+static void jumpcc(char *cc, int l) {
+  emits("  j");
+  emits(cc);
+  emitc(' ');
+  emitlabel(l);
+  emitc('\n');
+}
+
+// Logically negate a temporary's value
+int x64lognot(int r, int type) {
+  cmpzero(r, type);
+  setcc("e", r);
+  return (r);
+}
+
+// Load a boolean value (only 0 or 1)
+// into the given temporary
+void x64loadboolean(int r, int val, int type) {
+  emits("  movq $");
+  emitd(val);
+  emits(", ");
+  emitslot(r);
+  emitc('\n');
+}
+
+// Convert an integer value to a boolean value
+int x64boolean(int r, int type) {
+  int r2 = cgalloctemp();
+
+  cmpzero(r, type);
+  setcc("ne", r2);
+  return (r2);
+}
+
+// Load argument r of the given type into %rax. An int argument
+// is sign-extended, as the parameter may be a long one
+static void loadarg(int r, int type) {
+  if (islong(type))
+    loadrax(r);
+  else {
+    emits("  movslq ");
+    emitslot(r);
+    emits(", %rax\n");
+  }
+}
+
+// Call a function with the given symbol id. The arguments
+// are in reverse order in arglist. Those after the sixth
+// are pushed, last one first, keeping the stack aligned
+int x64call(struct symtable *sym, int numargs, int *arglist, int *typelist) {
+  int outr = cgalloctemp();
+  int i, pushed = 0;
+
+  if (numargs > 6) {
+    pushed = numargs - 6;
+    if (pushed & 1) {
+      emits("  subq $8, %rsp\n");
+      pushed++;
+    }
+    for (i = 0; i < numargs - 6; i++) {
+      loadarg(arglist[i], typelist[i]);
+      emits("  pushq %rax\n");
+    }
+  }
+  for (i = 0; i < numargs && i < 6; i++) {
+    loadarg(arglist[numargs - 1 - i], typelist[numargs - 1 - i]);
+    emits("  movq %rax, ");
+    emits(argreg[i]);
+    emitc('\n');
+  }
+
+  // %al holds the number of vector registers
+  // used by a call to a variadic function
+  emits("  xorl %eax, %eax\n  call ");
+  emits(sym->name);
+  emitc('\n');
+  if (pushed > 0) {
+    emits("  addq $");
+    emitd(8 * pushed);
+    emits(", %rsp\n");
+  }
+  if (sym->type != P_VOID)
+    storerax(outr);
+  return (outr);
+}
+
+// Shift a temporary left by a constant. As we only use
+// this for address calculations, sign-extend it to 8 bytes
+int x64shlconst(int r, int val, int type) {
+  int r2 = cgalloctemp();
+
+  if (islong(type))
+    loadrax(r);
+  else {
+    emits("  movslq ");
+    emitslot(r);
+    emits(", %rax\n");
+  }
+  emits("  shlq $");
+  emitd(val);
+  emits(", %rax\n");
+  storerax(r2);
+  return (r2);
+}
+
+// Store a temporary's value into a global
+// or local variable of the given type
+static int x64storvar(int r, struct symtable *sym) {
+  loadrax(r);
+  emitstoresize(cgprimsize(sym->type));
+  emitvar(sym);
+  emitc('\n');
+  return (r);
+}
+
+int x64storglob(int r, struct symtable *sym) {
+  return (x64storvar(r, sym));
+}
+
+int x64storlocal(int r, struct symtable *sym) {
+  return (x64storvar(r, sym));
+}
+
+// Output a run of zero bytes
+static void emitzeroes(int count) {
+  emits("  .zero ");
+  emitd(count);
+  emitc('\n');
+}
+
+// Generate a global symbol but not functions
+void x64globsym(struct symtable *node) {
+  int size, type;
+  int initvalue;
+  int i, zeroes;
+
+  if (node == NULL)
+    return;
+  if (node->stype == S_FUNCTION)
+    return;
+
+  // Get the size of the variable (or its elements if an array)
+  // and the type of the variable
+  if (node->stype == S_ARRAY) {
+    size = typesize(value_at(node->type), node->ctype);
+    type = value_at(node->type);
+  } else {
+    size = node->size;
+    type = node->type;
+  }
+
+  // A variable with no initial values goes in the bss section
+  if (node->initlist == NULL)
+    emits("  .bss\n");
+  else
+    emits("  .data\n");
+  if (node->class == C_GLOBAL) {
+    emits("  .globl ");
+    emits(node->name);
+    emitc('\n');
+  }
+  emits("  .balign ");
+  if ((node->type == P_STRUCT) || (node->type == P_UNION))
+    emitd(8);
+  else
+    emitd(cgprimsize(type));
+  emitc('\n');
+  emits(node->name);
+  emits(":\n");
+
+  if (node->initlist == NULL) {
+    if (node->nelems > 0)
+      emitzeroes(size * node->nelems);
+    return;
+  }
+
+  // Output the initial values. A run of zero elements,
+  // or elements of other sizes which are structs, is
+  // output as one run of zero bytes
+  zeroes = 0;
+  for (i = 0; i < node->nelems; i++) {
+    initvalue = node->initlist[i];
+    if (initvalue == 0 || (size != 1 && size != 4 && size != 8)) {
+      zeroes = zeroes + size;
+    } else {
+      if (zeroes > 0) {
+	emitzeroes(zeroes);
+	zeroes = 0;
+      }
+      switch (size) {
+	case 1:
+	  emits("  .byte ");
+	  break;
+	case 4:
+	  emits("  .long ");
+	  break;
+	case 8:
+	  emits("  .quad ");
+      }
+
+      // Generate the pointer to a string literal
+      if (size == 8 && type == pointer_to(P_CHAR))
+	emitc('L');
+      emitd(initvalue);
+      emitc('\n');
+    }
+  }
+  if (zeroes > 0)
+    emitzeroes(zeroes);
+}
+
+// Generate a global string and its label.
+// Don't output the label if append is true
+void x64globstr(int l, char *strvalue, int append) {
+  if (!append) {
+    emits("  .data\nL");
+    emitd(l);
+    emits(":\n");
+  }
+  if (*strvalue) {
+    emits("  .ascii ");
+    emitstring(strvalue);
+    emitc('\n');
+  }
+}
+
+// NUL terminate a global string
+void x64globstrend(void) {
+  emits("  .byte 0\n");
+}
+
+// Compare two temporaries and set if true
+int x64compare_and_set(int ASTop, int r1, int r2, int type) {
+  int r3;
+
+  if (ASTop < A_EQ || ASTop > A_GE)
+    fatal("Bad ASTop in cgcompare_and_set()");
+  r3 = cgalloctemp();
+  cmptemps(r1, r2, type);
+  setcc(cclist[ASTop - A_EQ], r3);
+  return (r3);
+}
+
+// Generate a label
+void x64label(int l) {
+  emitlabel(l);
+  emits(":\n");
+}
+
+// Generate a jump to a label
+void x64jump(int l) {
+  emits("  jmp ");
+  emitlabel(l);
+  emitc('\n');
+}
+
+// Compare two temporaries and jump if false
+int x64compare_and_jump(int ASTop, int r1, int r2, int label, int type) {
+  if (ASTop < A_EQ || ASTop > A_GE)
+    fatal("Bad ASTop in cgcompare_and_jump()");
+  cmptemps(r1, r2, type);
+  jumpcc(invcclist[ASTop - A_EQ], label);
+  return (NOREG);
+}
+
+// Compare two temporaries and jump to Ltrue if the
+// comparison is true, or to Lfalse if it is false
+void x64compare_and_branch(int ASTop, int r1, int r2, int Ltrue,
+			   int Lfalse, int type) {
+  if (ASTop < A_EQ || ASTop > A_GE)
+    fatal("Bad ASTop in cgcompare_and_branch()");
+  cmptemps(r1, r2, type);
+  jumpcc(cclist[ASTop - A_EQ], Ltrue);
+  x64jump(Lfalse);
+}
+
+// Jump to Ltrue if temporary r is not zero,
+// or to Lfalse if it is zero
+void x64branch(int r, int Ltrue, int Lfalse, int type) {
+  cmpzero(r, type);
+  jumpcc("ne", Ltrue);
+  x64jump(Lfalse);
+}
+
+// Jump to the label if the value in temporary r is in the
+// range lo ... hi, otherwise fall through. A longer range
+// is tested with one unsigned comparison of r - lo to hi - lo
+int x64range_and_jump(int r, int lo, int hi, int label, int type) {
+  if (lo == hi) {
+    emits("  cmp");
+    emitsuffix(type);
+    emits(" $");
+    emitd(lo);
+    emits(", ");
+    emitslot(r);
+    emitc('\n');
+    jumpcc("e", label);
+    return (NOREG);
+  }
+  loadrax(r);
+  emits("  sub");
+  emitsuffix(type);
+  emits(" $");
+  emitd(lo);
+  emits(", ");
+  emitrax(type);
+  emits("\n  cmp");
+  emitsuffix(type);
+  emits(" $");
+  emitd(hi - lo);
+  emits(", ");
+  emitrax(type);
+  emitc('\n');
+  jumpcc("be", label);
+  return (NOREG);
+}
+
+// Widen the value in the temporary from the old type to a
+// new type: a char is zero-extended, an int sign-extended.
+// A long or a pointer is already as wide as it gets
+int x64widen(int r, int oldtype, int newtype) {
+  int t;
+
+  if (cgprimsize(oldtype) == 8)
+    return (r);
+  t = cgalloctemp();
+  if (oldtype == P_CHAR)
+    emits("  movzbl ");
+  else
+    emits("  movslq ");
+  emitslot(r);
+  if (oldtype == P_CHAR)
+    emits(", %eax\n");
+  else
+    emits(", %rax\n");
+  storerax(t);
+  return (t);
+}
+
+// Generate code to return a value from a function
+void x64return(int reg, struct symtable *sym) {
+  if (reg != NOREG)
+    loadrax(reg);
+  x64jump(sym->st_endlabel);
+}
+
+// Generate code to load the address of an
+// identifier. Return a new temporary
+int x64address(struct symtable *sym) {
+  int r = cgalloctemp();
+
+  emits("  leaq ");
+  emitvar(sym);
+  emits(", %rax\n");
+  storerax(r);
+  return (r);
+}
+
+// Dereference a pointer to get the value
+// it points at into a new temporary
+int x64deref(int r, int type) {
+  int size = cgprimsize(value_at(type));
+  int ret = cgalloctemp();
+
+  loadrax(r);
+  emitloadsize(size);
+  emits("(%rax)");
+  emitloadreg(size);
+  storerax(ret);
+  return (ret);
+}
+
+// Store temporary r1 through the pointer in r2
+int x64storderef(int r1, int r2, int type) {
+  loadrax(r1);
+  emits("  movq ");
+  emitslot(r2);
+  emits(", %rcx\n");
+  emitstoresize(cgprimsize(type));
+  emits("(%rcx)\n");
+  return (r1);
+}
+
+// Move value between temporaries
+void x64move(int r1, int r2, int type) {
+  loadrax(r1);
+  storerax(r2);
+}
+
+// Change a temporary value from its old type to a new
+// type. A narrower value is just the low bits of the
+// old one, and a wider one is a widening
+int x64cast(int t, int oldtype, int newtype) {
+  if (ptrtype(newtype) && ptrtype(oldtype))
+    return (t);
+  if (!ptrtype(newtype) && cgprimsize(newtype) <= cgprimsize(oldtype))
+    return (t);
+  return (x64widen(t, oldtype, newtype));
+}
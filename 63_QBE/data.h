@@ -38,3 +38,23 @@ extern_ int O_keepasm;		// If true, keep any assembly files如果为真，编译
 extern_ int O_assemble;		// If true, assemble the assembly files如果为真，编译器将在生成汇编文件后进行汇编，将其转换为目标文件。这个标志通常用于控制是否执行汇编过程。
 extern_ int O_dolink;		// If true, link the object files如果为真，编译器将链接生成的目标文件，创建可执行文件。这个标志通常用于控制是否执行链接过程。
 extern_ int O_verbose;		// If true, print info on compilation stages如果为真，编译器将输出详细的编译信息，例如正在编译的文件名等。这个标志通常用于控制是否输出更多的编译信息。
+extern_ int O_timelex;		// If true, report the scanner's throughput如果为真，报告词法分析的速度（MB/s）。
+extern_ int O_lexonly;		// If true, only scan the input and report the speed如果为真，只做词法分析并报告速度。
+extern_ int O_pipeline;		// If true, pipe the QBE code into qbe and as如果为真，用管道把 QBE 代码交给 qbe 和 as，不产生中间文件。
+extern_ int O_x64;			// If true, write x86-64 assembly directly, without qbe如果为真（-O0），直接生成 x86-64 汇编代码，不经过 qbe。
+extern_ int O_jobs;			// Number of files to compile at once同时编译的文件数。
+extern_ int O_genjobs;			// Number of code generator workers at once同时生成代码的工作进程数。
+extern_ char *O_cachedir;		// With -C, the compile cache directory用 -C 时编译缓存所在的目录。
+extern_ long O_cachesize;		// Largest size of the compile cache in bytes编译缓存的最大字节数。
+extern_ int O_peephole;		// If false (-fno-peephole), skip the peephole pass为假（-fno-peephole）时不做窥孔优化。
+extern_ int O_inlinelimit;		// Largest function, in AST nodes, to inline内联的函数最多有多少个 AST 节点。
+extern_ int O_timereport;		// -ftime-report: 1 for a table, 2 for JSON用 -ftime-report 时为 1 输出表格，为 2 输出 JSON。
+extern_ int O_emitpch;		// If true, write the headers' symbols to a PCH file如果为真，把头文件的符号写到 PCH 文件中。
+extern_ char *O_includepch;		// With -include-pch, the PCH file to use用 -include-pch 时使用的 PCH 文件。
+extern_ int Serving;			// True in a compile server's worker为真表示在编译服务器的工作进程中。
+extern_ long Nastnodes;			// AST nodes made in this file这个文件中生成的 AST 节点数。
+extern_ long Nsymbols;			// Symbols made in this file这个文件中生成的符号数。
+extern_ long Arenaused;			// Bytes in use in the arenas内存池中正在使用的字节数。
+extern_ long Arenapeak;			// Most bytes in use in the arenas内存池中正在使用的最大字节数。
+extern_ long Gentime;			// With -t, usecs spent in genAST()用 -t 时 genAST() 所用的微秒数。
+extern_ long Genbytes;			// With -t, bytes of QBE code genAST() made用 -t 时 genAST() 生成的 QBE 代码字节数。
@@ -1,6 +1,7 @@
 #include "defs.h"
 #include "data.h"
 #include "decl.h"
+#include <time.h>
 
 // Parsing of declarations
 // Copyright (c) 2019 Warren Toomey, GPL3
@@ -495,8 +496,12 @@ static struct symtable *function_declaration(char *funcname, int type,
 					     int class) {
   struct ASTnode *tree, *finalstmt;
   struct symtable *oldfuncsym, *newfuncsym = NULL;
-  int endlabel = 0, paramcnt;
+  int endlabel = 0, paramcnt, freeable;
   int linenum = Line;
+  long start = 0, bytes = 0;
+
+  if (O_timereport)
+    funcstart();
 
   // Text has the identifier's name. If this exists and is a
   // function, get the id. Otherwise, set oldfuncsym to NULL.
@@ -579,7 +584,11 @@ static struct symtable *function_declaration(char *funcname, int type,
 
   // Do optimisations on the AST tree
   /*对整个函数定义的AST进行优化。这一步可能包括删除不必要的节点、简化表达式等，以提高生成的代码的效率。*/
+  if (O_timereport)
+    phasestart(PH_OPT);
   tree = optimise(tree);
+  if (O_timereport)
+    phaseend(PH_OPT);
 
   // Dump the AST tree if requested
   /*检查编译器选项 O_dumpAST 是否开启，即是否要求在生成代码之前将AST（抽象语法树）转储到标准输出。
@@ -588,13 +597,38 @@ static struct symtable *function_declaration(char *funcname, int type,
     dumpAST(tree, NOLABEL, 0);
     fprintf(stdout, "\n\n");
   }
-  // Generate the assembly code for it
+  // Generate the assembly code for it. With -t,
+  // time it and count the bytes of QBE code
   /*调用 genAST 函数，生成函数体的汇编代码。*/
-  genAST(tree, NOLABEL, NOLABEL, NOLABEL, 0);
+  if (O_timelex) {
+    start = clock();
+    bytes = cgoutbytes();
+  }
+  // The code for a static function is kept
+  // until we know that something uses it. With
+  // -fgen-jobs=n, a worker process generates it
+  /*静态函数的代码先保留起来，直到知道有别的代码用到它。
+  使用 -fgen-jobs=n 时，由工作进程生成代码。*/
+  if (O_timereport)
+    phasestart(PH_GEN);
+  genuses(tree, oldfuncsym);
+  freeable = genfunction(tree, oldfuncsym);
+  if (O_timereport) {
+    phaseend(PH_GEN);
+    funcend(oldfuncsym->name);
+  }
+  if (O_timelex) {
+    Gentime = Gentime + clock() - start;
+    Genbytes = Genbytes + cgoutbytes() - bytes;
+  }
 
-  // Now free the symbols associated with this function
-  /*释放与当前函数关联的局部符号表条目。这是一个清理步骤，确保在处理一个函数后释放相应的资源。*/
+  // Now free the symbols and the AST nodes associated
+  // with this function. The AST nodes are kept while the
+  // function waits to be given to a worker process
+  /*释放与当前函数关联的局部符号表条目和 AST 节点。这是一个清理步骤，确保在处理一个函数后释放相应的资源。*/
   freeloclsyms();
+  if (freeable)
+    freeastnodes();
   return (oldfuncsym);
 }
 
@@ -663,7 +697,7 @@ static struct symtable *composite_declaration(int type) {
   if (Membhead == NULL)
     fatals("No members in struct", ctype->name);
   ctype->member = Membhead;/*将结构体或联合体的成员列表指向 Membhead，该列表包含了所有成员的信息。*/
-  Membhead = Membtail = NULL;/*将 Membhead 和 Membtail 设置为 NULL，以便为下一个结构体或联合体的成员重新开始链表。*/
+  freemembsyms();/*将 Membhead 和 Membtail 设置为 NULL，以便为下一个结构体或联合体的成员重新开始链表。*/
 
   // Set the offset of the initial member
   // and find the first free byte after it
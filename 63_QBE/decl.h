@@ -2,8 +2,14 @@
 // Copyright (c) 2019 Warren Toomey, GPL3
 
 // scan.c
+int readinput(void);
+char *inputbuf(void);
+void setinput(char *text, int len);
+void inputrange(int start, int end);
+void rewindinput(void);
 void reject_token(struct token *t);
 int scan(struct token *t);
+void checkkeywords(void);
 
 // tree.c
 struct ASTnode *mkastnode(int op, int type,
@@ -19,74 +25,73 @@ struct ASTnode *mkastunary(int op, int type,
 			   struct symtable *ctype,
 			   struct ASTnode *left,
 			   struct symtable *sym, int intvalue);
+void freeastnodes(void);
 void dumpAST(struct ASTnode *n, int label, int level);
 
 // gen.c
 int genlabel(void);
+void resetlabels(void);
+int nextlabel(void);
+void skiplabels(int id);
 int genAST(struct ASTnode *n, int iflabel, int looptoplabel,
 	   int loopendlabel, int parentASTop);
 void genpreamble(char *filename);
 void genpostamble();
 void genfreeregs(int keepreg);
 void genglobsym(struct symtable *node);
+void genuses(struct ASTnode *n, struct symtable *func);
+void genstartstatic(struct symtable *sym);
+void genendstatic(struct symtable *sym);
+int genfunction(struct ASTnode *tree, struct symtable *sym);
+int genstatics(void);
 int genglobstr(char *strvalue, int append);
+int genstrlen(int label);
 void genglobstrend(void);
 int genprimsize(int type);
 int genalign(int type, int offset, int direction);
 void genreturn(int reg, int id);
 
 // cg.c
+void emitc(int c);
+void emits(char *s);
+void emitd(int val);
+void emitstring(char *s);
+char cgqbetype(int type);
 int cgprimsize(int type);
 int cgalign(int type, int offset, int direction);
 void cgtextseg();
 void cgdataseg();
 int cgalloctemp(void);
+void cgresettemps(void);
+int cgnumtemps(void);
+long cgoutbytes(void);
+void cgflush(void);
+void cgstartdefer(void);
+char *cgenddefer(int *len);
+void cgstarthold(void);
+char *cgendhold(int *len);
+void cgemitdeferred(char *text, int len);
 void cgfreeallregs(int keepreg);
 void cgfreereg(int reg);
 void cgspillregs(void);
-void cgpreamble(char *filename);
 void cgpostamble();
-void cgfuncpreamble(struct symtable *sym);
-void cgfuncpostamble(struct symtable *sym);
-int cgloadint(int value, int type);
-int cgloadvar(struct symtable *sym, int op);
-int cgloadglobstr(int label);
-int cgadd(int r1, int r2, int type);
-int cgsub(int r1, int r2, int type);
-int cgmul(int r1, int r2, int type);
-int cgdivmod(int r1, int r2, int op, int type);
-int cgshlconst(int r, int val, int type);
-int cgcall(struct symtable *sym, int numargs, int *arglist, int *typelist);
+int cgloadlong(long value);
 void cgcopyarg(int r, int argposn);
-int cgstorglob(int r, struct symtable *sym);
-int cgstorlocal(int r, struct symtable *sym);
-void cgglobsym(struct symtable *node);
-void cgglobstr(int l, char *strvalue, int append);
-void cgglobstrend(void);
-int cgcompare_and_set(int ASTop, int r1, int r2, int type);
-int cgcompare_and_jump(int ASTop, int r1, int r2, int label, int type);
-void cglabel(int l);
-void cgjump(int l);
-int cgwiden(int r, int oldtype, int newtype);
-void cgreturn(int reg, struct symtable *sym);
-int cgaddress(struct symtable *sym);
-int cgderef(int r, int type);
-int cgstorderef(int r1, int r2, int type);
-int cgnegate(int r, int type);
-int cginvert(int r, int type);
-int cglognot(int r, int type);
-void cgloadboolean(int r, int val, int type);
-int cgboolean(int r, int op, int label, int type);
-int cgand(int r1, int r2, int type);
-int cgor(int r1, int r2, int type);
-int cgxor(int r1, int r2, int type);
-int cgshl(int r1, int r2, int type);
-int cgshr(int r1, int r2, int type);
 void cgswitch(int reg, int casecount, int toplabel,
 	      int *caselabel, int *caseval, int defaultlabel);
-void cgmove(int r1, int r2, int type);
 void cglinenum(int line);
-int cgcast(int t, int oldtype, int newtype);
+
+// peep.c
+void peephole(char *text, int len, int ntemps);
+
+// backend.c, cg.c and cgx64.c
+#define CGOP(type, name, params, args) \
+  type cg##name params; type qbe##name params; type x64##name params;
+#define CGVOP(name, params, args) \
+  void cg##name params; void qbe##name params; void x64##name params;
+#include "backend.h"
+#undef CGOP
+#undef CGVOP
 
 // expr.c
 struct ASTnode *expression_list(int endtoken);
@@ -108,10 +113,14 @@ void fatal(char *s);
 void fatals(char *s1, char *s2);
 void fatald(char *s, int d);
 void fatalc(char *s, int c);
+void *arenaalloc(struct arena *a, int size);
+char *arenastrdup(struct arena *a, char *s);
+void arenareset(struct arena *a);
 
 // sym.c
 void appendsym(struct symtable **head, struct symtable **tail,
 	       struct symtable *node);
+char *internname(char *s);
 struct symtable *newsym(char *name, int type, struct symtable *ctype,
 			int stype, int class, int nelems, int posn);
 struct symtable *addglob(char *name, int type, struct symtable *ctype,
@@ -136,7 +145,9 @@ struct symtable *findenumtype(char *s);
 struct symtable *findenumval(char *s);
 struct symtable *findtypedef(char *s);
 void clear_symtable(void);
+void relinksymtable(void);
 void freeloclsyms(void);
+void freemembsyms(void);
 void freestaticsyms(void);
 void dumptable(struct symtable *head, char *name, int indent);
 void dumpsymtables(void);
@@ -160,3 +171,36 @@ struct ASTnode *modify_type(struct ASTnode *tree, int rtype,
 
 // opt.c
 struct ASTnode *optimise(struct ASTnode *n);
+void freeinline(void);
+
+// cache.c
+void cacheinit(void);
+void pchkey(char *buf, int len, long *key);
+int cachefind(char *filename, char *buf, int len);
+void cachestore(char *filename);
+void cachestats(void);
+
+// report.c
+void phasestart(int phase);
+void phaseend(int phase);
+void resetreport(void);
+void funcstart(void);
+void funcend(char *name);
+void filereport(char *filename);
+void linkreport(void);
+
+// main.c
+char *alter_suffix(char *str, char suffix);
+int runcwj(int argc, char **argv);
+
+// pch.c
+void pchemit(char *filename, int len);
+int pchload(char *path, char *filename);
+
+// server.c
+int headerprefix(char *filename, char *buf, int len);
+char *headertext(int *len);
+int serverwarm(void);
+void serverparse(int prefix);
+int serve(char *path);
+int client(char *path, int argc, char **argv);
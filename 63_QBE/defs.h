@@ -84,7 +84,8 @@ enum {
   A_FUNCCALL, A_DEREF, A_ADDR, A_SCALE,				// 35 函数调用  解引用操作 (T_STAR)  取地址操作 (T_AMPER)  数组索引操作 (T_LBRACKET)
   A_PREINC, A_PREDEC, A_POSTINC, A_POSTDEC,			// 39 前置递增操作 (T_INC) 前置递减操作 (T_DEC) 后置递增操作 (T_INC)  后置递减操作 (T_DEC)
   A_NEGATE, A_INVERT, A_LOGNOT, A_TOBOOL, A_BREAK,		// 43取负操作 (T_MINUS) 按位取反操作 (T_INVERT) 逻辑非操作 (T_LOGNOT) 转为布尔值操作 中断语句 (T_BREAK)
-  A_CONTINUE, A_SWITCH, A_CASE, A_DEFAULT, A_CAST		// 48继续语句 (T_CONTINUE) 开关语句 (T_SWITCH)  开关语句的分支 (T_CASE) 开关语句的默认分支 (T_DEFAULT) 类型转换操作
+  A_CONTINUE, A_SWITCH, A_CASE, A_DEFAULT, A_CAST,		// 48继续语句 (T_CONTINUE) 开关语句 (T_SWITCH)  开关语句的分支 (T_CASE) 开关语句的默认分支 (T_DEFAULT) 类型转换操作
+  A_TAILCALL							// 53 A call by a function to itself in tail position 函数在尾部对自身的调用
 };
 
 // Primitive types. The bottom 4 bits is an integer
@@ -149,7 +150,54 @@ struct symtable {
   int *initlist;		// List of initial values 对于初始化的符号，存储初始值的列表。
   struct symtable *next;	// Next symbol in one list符号表中下一个符号的指针，用于形成符号表的链表。
   struct symtable *member;	// First member of a function, struct,对于函数、结构体、联合体或枚举，指向第一个成员的指针。
-};				// union or enum
+  				// union or enum
+  struct symtable *hnext;	// Next symbol in the same hash bucket 哈希桶中的下一个符号
+  int st_defer;			// For statics, 1 + posn in the deferred list
+  				// or zero if not deferred 延迟输出的静态符号在列表中的位置加一，没有延迟则为零
+  int st_offset;		// For locals and parameters with -O0, the
+  				// offset from the frame pointer 用 -O0 时局部变量和参数相对于帧指针的偏移
+};
+
+// Interned name: the single stored copy of an identifier,
+// so that symbol names can be compared by pointer
+/* 驻留字符串：每个不同的标识符只保存一份，符号名可以直接比较指针。*/
+struct intern {
+  char *str;			// The name itself
+  struct intern *next;		// Next name in the same hash bucket
+};
+
+// Hash index over one of the symbol lists, keyed on the
+// symbol's interned name. Symbols in the same bucket are
+// chained through their hnext field, newest first
+/* 符号链表的哈希索引，以驻留后的名字为键，同一个桶中的符号通过 hnext 串起来。*/
+struct symhash {
+  struct symtable **bucket;	// Bucket array, size is a power of two
+  int size;			// Number of buckets
+  int count;			// Number of symbols in the index
+};
+
+// Phases of the compilation timed by -ftime-report
+/* -ftime-report 计时的编译阶段。*/
+enum {
+  PH_CPP, PH_SCAN, PH_PARSE, PH_OPT, PH_GEN, PH_QBE, PH_AS, PH_LINK,
+  NPHASES
+};
+
+// Memory arena: small objects are carved out of a list of
+// big blocks, and the whole arena is released in one go
+/* 内存池：小对象从一串大块内存中依次切出，整个内存池一次性释放。*/
+struct arenablock {
+  char *mem;			// The block's memory
+  int size;			// Size of the block in bytes
+  int used;			// Number of bytes handed out so far
+  struct arenablock *next;	// Next block in the arena
+};
+
+struct arena {
+  struct arenablock *head;	// First block in the arena
+  struct arenablock *cur;	// Block we are allocating from
+  struct arenablock *tail;	// Last block in the arena
+};
 
 // Abstract Syntax Tree structure
 //操作子树
@@ -1,6 +1,8 @@
 #include "defs.h"
 #include "data.h"
 #include "decl.h"
+#include <unistd.h>
+#include <sys/wait.h>
 
 // Generic code generator
 // Copyright (c) 2019 Warren Toomey, GPL3
@@ -13,6 +15,25 @@ int genlabel(void) {
   return (labelid++);
 }
 
+// Start the label numbers again from 1, so that the
+// compile server numbers them as a fresh compile does
+/*标签编号重新从 1 开始，这样编译服务器的编号和一次全新的编译相同。*/
+void resetlabels(void) {
+  labelid = 1;
+}
+
+// Return the number of the next label
+int nextlabel(void) {
+  return (labelid);
+}
+
+// Make sure that no label below id is handed out, as a
+// precompiled header's functions already have them
+void skiplabels(int id) {
+  if (labelid < id)
+    labelid = id;
+}
+
 /*段代码定义了一个函数 update_line，其作用是在生成汇编代码时，
 检查 AST 节点的行号是否发生变化，如果发生变化，则输出新的行号信息到汇编代码中。*/
 static void update_line(struct ASTnode *n) {
@@ -25,11 +46,64 @@ static void update_line(struct ASTnode *n) {
   }
 }
 
+// Generate the code for a condition: jump to Ltrue if it is
+// true, and to Lfalse if it is false. &&, || and ! become
+// jumps, and a comparison jumps on its result, so no 0 or 1
+// value is made unless the condition has some other value
+/*为条件生成代码：条件为真时跳到 Ltrue，为假时跳到 Lfalse。&&、|| 和 ! 变成跳转，
+比较直接根据结果跳转，所以除非条件是别的值，否则不会生成 0 或 1 的值。*/
+static void gencond(struct ASTnode *n, int Ltrue, int Lfalse) {
+  int Lnext, leftreg, rightreg;
+
+  switch (n->op) {
+    case A_LOGAND:
+      // If the left is false, so is the whole
+      Lnext = genlabel();
+      gencond(n->left, Lnext, Lfalse);
+      cglabel(Lnext);
+      gencond(n->right, Ltrue, Lfalse);
+      return;
+    case A_LOGOR:
+      // If the left is true, so is the whole
+      Lnext = genlabel();
+      gencond(n->left, Ltrue, Lnext);
+      cglabel(Lnext);
+      gencond(n->right, Ltrue, Lfalse);
+      return;
+    case A_LOGNOT:
+      gencond(n->left, Lfalse, Ltrue);
+      return;
+    case A_TOBOOL:
+      gencond(n->left, Ltrue, Lfalse);
+      return;
+    case A_INTLIT:
+      if (n->a_intvalue)
+	cgjump(Ltrue);
+      else
+	cgjump(Lfalse);
+      return;
+    case A_EQ:
+    case A_NE:
+    case A_LT:
+    case A_GT:
+    case A_LE:
+    case A_GE:
+      leftreg = genAST(n->left, NOLABEL, NOLABEL, NOLABEL, n->op);
+      rightreg = genAST(n->right, NOLABEL, NOLABEL, NOLABEL, n->op);
+      cgcompare_and_branch(n->op, leftreg, rightreg, Ltrue, Lfalse,
+			   n->left->type);
+      return;
+  }
+
+  // Anything else is true if it isn't zero
+  leftreg = genAST(n, NOLABEL, NOLABEL, NOLABEL, 0);
+  cgbranch(leftreg, Ltrue, Lfalse, n->type);
+}
+
 // Generate the code for an IF statement
 // and an optional ELSE clause.
 static int genIF(struct ASTnode *n, int looptoplabel, int loopendlabel) {
-  int Lfalse, Lend = 0;
-  int r, r2;
+  int Ltrue, Lfalse, Lend = 0;
 
   // Generate two labels: one for the
   // false compound statement, and one
@@ -37,17 +111,16 @@ static int genIF(struct ASTnode *n, int looptoplabel, int loopendlabel) {
   // When there is no ELSE clause, Lfalse _is_
   // the ending label!
   /*生成两个标签，一个用于表示假条件的复合语句（Lfalse），另一个用于整个IF语句的结束（Lend）。*/
+  Ltrue = genlabel();
   Lfalse = genlabel();
   if (n->right)
     Lend = genlabel();
 
-  // Generate the condition code
-  /*生成条件表达式的代码，并将结果存储在寄存器r中。如果条件为假，将跳转到Lfalse标签。*/
-  r = genAST(n->left, Lfalse, NOLABEL, NOLABEL, n->op);
-  // Test to see if the condition is true. If not, jump to the false label
-  /*使用cgcompare_and_jump比较r和常数1，如果相等（条件为假），则跳转到Lfalse标签。*/
-  r2 = cgloadint(1, P_INT);
-  cgcompare_and_jump(A_EQ, r, r2, Lfalse, P_INT);
+  // Generate the condition code, which jumps to the
+  // true label or the false label
+  /*生成条件的代码：条件为真时跳到 Ltrue，为假时跳到 Lfalse。*/
+  gencond(n->left, Ltrue, Lfalse);
+  cglabel(Ltrue);
 
   // Generate the true compound statement
   /*生成真条件的复合语句的代码。*/
@@ -81,8 +154,7 @@ static int genIF(struct ASTnode *n, int looptoplabel, int loopendlabel) {
 // Generate the code for a WHILE statement
 //对于判断而言，先进行判断后生成结果1，0，装入寄存器中，之后再用结果进行跳转的判断。
 static int genWHILE(struct ASTnode *n) {
-  int Lstart, Lend;
-  int r, r2;
+  int Lstart, Lbody, Lend;
 
   // Generate the start and end labels
   // and output the start label
@@ -92,13 +164,12 @@ static int genWHILE(struct ASTnode *n) {
   Lend = genlabel();
   cglabel(Lstart);
 
-  // Generate the condition code
-  //genAST() 函数生成 n->left（循环条件）的代码。这个函数递归地处理 AST 节点，并能处理不同的代码路径和操作。
-  r = genAST(n->left, Lend, Lstart, Lend, n->op);
-  // Test to see if the condition is true. If not, jump to the end label
-  r2 = cgloadint(1, P_INT);
-  // 比较 r（条件表达式的结果）和 r2。如果条件为假（即不等于 1），跳转到 Lend（结束循环）。
-  cgcompare_and_jump(A_EQ, r, r2, Lend, P_INT);
+  // Generate the condition code. If it is
+  // false, jump to the end label
+  //生成循环条件的代码：条件为真时进入循环体，为假时跳到 Lend（结束循环）。
+  Lbody = genlabel();
+  gencond(n->left, Lbody, Lend);
+  cglabel(Lbody);
 
   // Generate the compound statement for the body
   genAST(n->right, NOLABEL, Lstart, Lend, n->op);
@@ -112,94 +183,157 @@ static int genWHILE(struct ASTnode *n) {
   return (NOREG);
 }
 
-// Generate the code for a SWITCH statement
-/*这段代码用于生成SWITCH语句的汇编代码。由于QBE尚不支持跳转表（jump tables），因此代码采用逐一比较的方式实现SWITCH语句的效果。*/
-static int genSWITCH(struct ASTnode *n) {
-  int *caselabel;
-  int Lend;
-  int Lcode = 0;
-  int i, reg, r2, type;
+// At most this many case ranges are tested one
+// after the other. Above this, genswitchtree()
+// splits them in half
+enum { SWITCHLINEAR = 3 };
+
+// Generate the dispatch code for a switch statement: a
+// balanced tree of comparisons over the case ranges
+// first ... last, which are sorted by value. Range k covers
+// the values caselo[k] to casehi[k] and jumps to the label
+// caselabel[k]. Values in no range jump to Ldefault
+/*为 switch 语句生成分发代码：对按值排序的 case 区间建立一棵平衡的比较树，
+区间较少时逐个比较，否则按中间区间的起始值一分为二。*/
+static void genswitchtree(int reg, int type, int *caselo, int *casehi,
+			  int *caselabel, int first, int last, int Ldefault) {
+  int i, mid, r, Lright;
+
+  // A few ranges: test them one after the other
+  if (last - first < SWITCHLINEAR) {
+    for (i = first; i <= last; i++)
+      cgrange_and_jump(reg, caselo[i], casehi[i], caselabel[i], type);
+    cgjump(Ldefault);
+    return;
+  }
+
+  // Otherwise split the ranges in half on the first
+  // value of the middle range, and do each half
+  mid = (first + last + 1) / 2;
+  Lright = genlabel();
+  r = cgloadint(caselo[mid], type);
+  cgcompare_and_jump(A_LT, reg, r, Lright, type);
+  genswitchtree(reg, type, caselo, casehi, caselabel, first, mid - 1,
+		Ldefault);
+  cglabel(Lright);
+  genswitchtree(reg, type, caselo, casehi, caselabel, mid, last, Ldefault);
+}
+
+// Generate the code for a SWITCH statement.
+// The case values are sorted, and runs of consecutive values
+// which go to the same code are merged into one range. The
+// ranges are searched with a balanced tree of comparisons,
+// as QBE has no indirect jump to build a jump table with.
+// The case bodies follow in source order, so that a body
+// without a break falls into the next one
+/*生成 switch 语句的代码。
+先把 case 值排序，把跳到同一段代码的连续值合并成一个区间，再用平衡的比较树查找区间
+（QBE 没有间接跳转，无法生成跳转表）。case 的代码按源码顺序排列，没有 break 时落入下一个 case。*/
+static int genSWITCH(struct ASTnode *n, int looptoplabel) {
+  int *codelabel, *caselo, *casehi, *caselabel;
+  int Lend, Ldefault;
+  int i, j, ncases, nranges, reg, type, value, label;
   struct ASTnode *c;
 
-  // Create an array for the case labels
-  /*创建case标签数组*/
-  caselabel = (int *) malloc((n->a_intvalue + 1) * sizeof(int));
-  if (caselabel == NULL)
+  // Create arrays for the code labels and the case ranges
+  /*创建代码标签数组和 case 区间数组*/
+  ncases = n->a_intvalue;
+  codelabel = (int *) malloc(ncases * sizeof(int));
+  caselo = (int *) malloc(ncases * sizeof(int));
+  casehi = (int *) malloc(ncases * sizeof(int));
+  caselabel = (int *) malloc(ncases * sizeof(int));
+  if (codelabel == NULL || caselo == NULL || casehi == NULL
+      || caselabel == NULL)
     fatal("malloc failed in genSWITCH");
 
-  // Because QBE doesn't yet support jump tables,
-  // we simply evaluate the switch condition and
-  // then do successive comparisons and jumps,
-  // just like we were doing successive if/elses
-
   // Generate a label for the end of the switch statement.
   Lend = genlabel();
 
-  // Generate labels for each case. Put the end label in
-  // as the entry after all the cases
-  /*生成case标签和条件判断代码：*/
-  for (i = 0, c = n->right; c != NULL; i++, c = c->right)
-    caselabel[i] = genlabel();
-  caselabel[i] = Lend;
+  // Generate a label for the code of each case with a body.
+  // A case with no body runs the code of the next case,
+  // and the last one runs off the end of the switch
+  /*为每个有代码的 case 生成标签。没有代码的 case 使用下一个 case 的标签。*/
+  for (i = 0, c = n->right; c != NULL; i++, c = c->right) {
+    if (c->left)
+      codelabel[i] = genlabel();
+    else
+      codelabel[i] = 0;
+  }
+  for (i = ncases - 1; i >= 0; i--) {
+    if (codelabel[i] == 0) {
+      if (i == ncases - 1)
+	codelabel[i] = Lend;
+      else
+	codelabel[i] = codelabel[i + 1];
+    }
+  }
+
+  // Collect the case values and their labels, and
+  // find where the default case goes. It's always last
+  Ldefault = Lend;
+  nranges = 0;
+  for (i = 0, c = n->right; c != NULL; i++, c = c->right) {
+    if (c->op == A_DEFAULT)
+      Ldefault = codelabel[i];
+    else {
+      caselo[nranges] = c->a_intvalue;
+      caselabel[nranges] = codelabel[i];
+      nranges++;
+    }
+  }
+
+  // Sort the case values, keeping their labels with them
+  /*按 case 值进行插入排序*/
+  for (i = 1; i < nranges; i++) {
+    value = caselo[i];
+    label = caselabel[i];
+    for (j = i; j > 0 && caselo[j - 1] > value; j--) {
+      caselo[j] = caselo[j - 1];
+      caselabel[j] = caselabel[j - 1];
+    }
+    caselo[j] = value;
+    caselabel[j] = label;
+  }
+
+  // Merge runs of consecutive values with the same label
+  /*合并跳到同一标签的连续值*/
+  j = 0;
+  for (i = 0; i < nranges; i++) {
+    if (j > 0 && caselabel[j - 1] == caselabel[i]
+	&& casehi[j - 1] + 1 == caselo[i]) {
+      casehi[j - 1] = caselo[i];
+    } else {
+      caselo[j] = caselo[i];
+      casehi[j] = caselo[i];
+      caselabel[j] = caselabel[i];
+      j++;
+    }
+  }
+  nranges = j;
 
   // Output the code to calculate the switch condition
-  /*生成case比较和跳转代码：*/
+  // and the code to find the case that it matches
   reg = genAST(n->left, NOLABEL, NOLABEL, NOLABEL, 0);
   type = n->left->type;
+  genswitchtree(reg, type, caselo, casehi, caselabel, 0, nranges - 1,
+		Ldefault);
 
-  // Walk the right-child linked list to
-  // generate the code for each case
-  /*
-  对于每个case，生成一个标签用于实际代码。如果Lcode为0，表示尚未生成用于实际代码的标签，此时生成一个新标签。
-  输出当前case的测试标签。
-  对于非default的case，生成比较和跳转代码。如果值匹配，跳转到下一个case，否则跳转到下一个case的测试标签。
-  对于有代码的case，生成实际代码。
-  */
- //i 是一个计数器，用来追踪当前是第几个 case。
+  // Generate the code for each case with a body.
+  // Pass in the end label for the breaks
+  /*按源码顺序生成每个 case 的代码，break 跳到 Lend。*/
   for (i = 0, c = n->right; c != NULL; i++, c = c->right) {
-
-    // Generate a label for the actual code that the cases will fall down to
-    //Lcode 是用来标识执行 case 语句代码块的位置的标签。如果 Lcode 尚未初始化，则生成一个新的标签。
-    if (Lcode == 0)
-      Lcode = genlabel();
-
-    // Output the label for this case's test
-    //为当前的 case 测试输出一个标签，这些标签是提前生成的，每个 case 对应一个。
-    cglabel(caselabel[i]);
-
-    // Do the comparison and jump, but not if it's the default case
-    /*
-    如果当前的 case 不是默认 case（A_DEFAULT），则进行一系列操作。
-    cgloadint(c->a_intvalue, type) 加载当前 case 的整型值到一个临时变量 r2。
-    cgcompare_and_jump(A_EQ, reg, r2, caselabel[i + 1], type) 比较寄存器 reg（这里假设之前已加载了 switch 表达式的值）与 r2。如果它们不相等，跳转到下一个 case 的标签。
-    cgjump(Lcode) 如果值匹配，跳转到执行当前 case 代码的标签 Lcode。
-    */
-    if (c->op != A_DEFAULT) {
-      // Jump to the next case if the value doesn't match the case value
-      r2 = cgloadint(c->a_intvalue, type);
-      cgcompare_and_jump(A_EQ, reg, r2, caselabel[i + 1], type);
-
-      // Otherwise, jump to the code to handle this case
-      cgjump(Lcode);
-    }
-    // Generate the case code. Pass in the end label for the breaks.
-    // If case has no body, we will fall into the following body.
-    // Reset Lcode so we will create a new code label on the next loop.
-    /*
-    如果当前 case 有代码块（c->left 不为空），则：
-    输出执行代码的标签 Lcode。
-    调用 genAST 生成 case 代码块的代码，传入结束标签 Lend 以处理可能的 break 语句。
-    重置 Lcode 以便在下一次循环中重新生成一个新的代码执行标签。
-    */
     if (c->left) {
-      cglabel(Lcode);
-      genAST(c->left, NOLABEL, NOLABEL, Lend, 0);
-      Lcode = 0;
+      cglabel(codelabel[i]);
+      genAST(c->left, NOLABEL, looptoplabel, Lend, 0);
     }
   }
 
   // Now output the end label.
   cglabel(Lend);
+  free(codelabel);
+  free(caselo);
+  free(casehi);
+  free(caselabel);
   return (NOREG);
 }
 
@@ -213,45 +347,148 @@ static int genSWITCH(struct ASTnode *n) {
 /*这段代码是为处理逻辑与（&&）和逻辑或（||）操作的抽象语法树（AST）节点生成目标代码的函数。
 函数 gen_logandor 对两个逻辑表达式进行计算，并根据它们的真值执行短路运算，这意味着在某些情况下不需要计算第二个表达式的值。*/
 static int gen_logandor(struct ASTnode *n) {
-  // Generate two labels
-  /*首先，生成两个标签 Lfalse 和 Lend，其中 Lfalse 用于标记逻辑表达式为假时的跳转位置，而 Lend 则是整个逻辑表达式结束的标签。*/
-  int Lfalse = genlabel();
-  int Lend = genlabel();
+  int Ltrue, Lfalse, Lend;
   int reg;
-  int type;
 
-  // Generate the code for the left expression
-  // followed by the jump to the false label
-  /*生成左侧表达式的代码*/
-  reg = genAST(n->left, NOLABEL, NOLABEL, NOLABEL, 0);
-  type = n->left->type;
-  cgboolean(reg, n->op, Lfalse, type);
-
-  // Generate the code for the right expression
-  // followed by the jump to the false label
-  /*生成右侧表达式的代码*/
-  reg = genAST(n->right, NOLABEL, NOLABEL, NOLABEL, 0);
-  type = n->right->type;
-  cgboolean(reg, n->op, Lfalse, type);
-
-  // We didn't jump so set the right boolean value
-  /*如果没有进行跳转，即左侧表达式的值确定整个逻辑表达式的值，
-  那么根据是逻辑与还是逻辑或，生成相应的代码：如果是逻辑与，将右侧表达式的值设为真，否则设为假。*/
-  if (n->op == A_LOGAND) {
-    cgloadboolean(reg, 1, type);
-    cgjump(Lend);
-    cglabel(Lfalse);
-    cgloadboolean(reg, 0, type);
-  } else {
-    cgloadboolean(reg, 0, type);
-    cgjump(Lend);
-    cglabel(Lfalse);
-    cgloadboolean(reg, 1, type);
-  }
+  // Jump on the condition, then set
+  // the value 1 or 0 at each label
+  Ltrue = genlabel();
+  Lfalse = genlabel();
+  Lend = genlabel();
+  gencond(n, Ltrue, Lfalse);
+
+  // The value may be a constant which is shared
+  // with other expressions, so use a new temporary
+  reg = cgalloctemp();
+  cglabel(Ltrue);
+  cgloadboolean(reg, 1, n->type);
+  cgjump(Lend);
+  cglabel(Lfalse);
+  cgloadboolean(reg, 0, n->type);
   cglabel(Lend);
   return (reg);
 }
 
+// Calls to memcpy() and memset() with a constant size of up
+// to BUILTINMAX bytes are done inline, with 8-byte loads and
+// stores and then 4-byte and 1-byte ones for the rest
+/*大小为不超过 BUILTINMAX 字节的常量的 memcpy() 和 memset() 调用直接在原地展开：
+先用 8 字节的加载和存储，剩下的用 4 字节和 1 字节的。*/
+enum {
+  BUILTINMAX = 128
+};
+
+// Return the type which is size bytes long
+static int chunktype(int size) {
+  if (size == 8)
+    return (P_LONG);
+  if (size == 4)
+    return (P_INT);
+  return (P_CHAR);
+}
+
+// Return the size of the next load or store
+// when there are left bytes still to do
+static int chunksize(int left) {
+  if (left >= 8)
+    return (8);
+  if (left >= 4)
+    return (4);
+  return (1);
+}
+
+// Return a temporary with the address offset bytes after
+// the address in temporary r. r itself is left unchanged
+static int offsetaddr(int r, int offset) {
+  if (offset == 0)
+    return (r);
+  return (cgadd(cgloadint(offset, P_LONG), r, P_LONG));
+}
+
+// Copy size bytes from the address in src to that in dst
+static void gen_copybytes(int dst, int src, int size) {
+  int offset, chunk, type, r;
+
+  for (offset = 0; offset < size; offset = offset + chunk) {
+    chunk = chunksize(size - offset);
+    type = chunktype(chunk);
+    r = cgderef(offsetaddr(src, offset), pointer_to(type));
+    cgstorderef(r, offsetaddr(dst, offset), type);
+  }
+}
+
+// Set size bytes at the address in dst to the low byte of
+// val, which is in temporary r unless val is an A_INTLIT.
+// The byte is repeated across a long to set 8 bytes at a
+// time: here for an A_INTLIT, otherwise with shifts and ors
+static void gen_setbytes(int dst, int r, struct ASTnode *val, int size) {
+  int offset, chunk, fill, shift;
+  long lfill;
+
+  // The 4-byte and 1-byte stores use the low bits in r
+  if (val->op == A_INTLIT) {
+    lfill = val->a_intvalue & 255;
+    lfill = lfill | (lfill << 8);
+    lfill = lfill | (lfill << 16);
+    lfill = lfill | (lfill << 32);
+    if (size >= 8)
+      fill = cgloadlong(lfill);
+    if (size % 8 != 0)
+      r = cgloadint((int) lfill, P_INT);
+  } else {
+    fill = cgand(cgloadint(255, P_LONG), cgwiden(r, val->type, P_LONG),
+		 P_LONG);
+    for (shift = 8; shift < 8 * chunksize(size); shift = shift * 2)
+      fill = cgor(cgshlconst(fill, shift, P_LONG), fill, P_LONG);
+    if (size % 8 != 0)
+      r = cgcast(fill, P_LONG, P_INT);
+  }
+
+  for (offset = 0; offset < size; offset = offset + chunk) {
+    chunk = chunksize(size - offset);
+    if (chunk == 8)
+      cgstorderef(fill, offsetaddr(dst, offset), P_LONG);
+    else
+      cgstorderef(r, offsetaddr(dst, offset), chunktype(chunk));
+  }
+}
+
+// If the function call is to memcpy() or memset() with a
+// constant size which isn't too big, do it inline and return
+// the temporary with the destination address. Otherwise
+// return NOREG. The arguments are worked out last to first
+// as for a real call. With -O0 each temporary lives on the
+// stack, and the library call is quicker
+static int gen_builtin(struct ASTnode *n) {
+  struct ASTnode *glue = n->left;
+  struct ASTnode *val;
+  int size, r, dst;
+
+  if (O_x64 || glue == NULL || glue->a_size != 3 || glue->right->op != A_INTLIT)
+    return (NOREG);
+  size = glue->right->a_intvalue;
+  if (size < 0 || size > BUILTINMAX)
+    return (NOREG);
+
+  if (strcmp(n->sym->name, "memcpy") == 0) {
+    r = genAST(glue->left->right, NOLABEL, NOLABEL, NOLABEL, A_GLUE);
+    dst = genAST(glue->left->left->right, NOLABEL, NOLABEL, NOLABEL, A_GLUE);
+    gen_copybytes(dst, r, size);
+    return (dst);
+  }
+  if (strcmp(n->sym->name, "memset") == 0) {
+    val = glue->left->right;
+    r = NOREG;
+    if (val->op != A_INTLIT)
+      r = genAST(val, NOLABEL, NOLABEL, NOLABEL, A_GLUE);
+    dst = genAST(glue->left->left->right, NOLABEL, NOLABEL, NOLABEL, A_GLUE);
+    if (size > 0)
+      gen_setbytes(dst, r, val, size);
+    return (dst);
+  }
+  return (NOREG);
+}
+
 // Generate the code to calculate the arguments of a
 // function call, then call the function with these
 // arguments. Return the temoprary that holds
@@ -263,6 +500,11 @@ static int gen_funccall(struct ASTnode *n) {
   int *arglist = NULL;
   int *typelist = NULL;
 
+  // Small constant-sized memcpy() and memset() calls
+  if ((i = gen_builtin(n)) != NOREG)
+    return (i);
+  i = 0;
+
   // Determine the actual number of arguments
   /*计算实际参数数量
   通过遍历参数列表，计算函数调用的实际参数数量。*/
@@ -299,23 +541,66 @@ static int gen_funccall(struct ASTnode *n) {
   return (cgcall(n->sym, numargs, arglist, typelist));
 }
 
+// The label after the preamble of the function being done,
+// which self tail calls jump back to
+static int Ltail;
+
+// Return true if the tree has a self tail call
+static int hastailcall(struct ASTnode *n) {
+  if (n == NULL)
+    return (0);
+  if (n->op == A_TAILCALL)
+    return (1);
+  if (hastailcall(n->left) || hastailcall(n->mid))
+    return (1);
+  return (hastailcall(n->right));
+}
+
+// Generate the code for a call by the function to itself in
+// tail position. Work out all the arguments before any parameter
+// changes, then copy them into the parameters and jump back
+// to the top of the function
+static int gen_tailcall(struct ASTnode *n) {
+  struct ASTnode *gluetree;
+  struct symtable *parm;
+  int i;
+  int *arglist = NULL;
+
+  if (n->left != NULL) {
+    arglist = (int *) malloc(n->left->a_size * sizeof(int));
+    if (arglist == NULL)
+      fatal("malloc failed in gen_tailcall");
+  }
+  // Each argument is glued with its position
+  for (gluetree = n->left; gluetree != NULL; gluetree = gluetree->left) {
+    i = gluetree->a_size - 1;
+    arglist[i] =
+      genAST(gluetree->right, NOLABEL, NOLABEL, NOLABEL, gluetree->op);
+  }
+
+  // The parameters on the stack are stored to, the others copied to
+  for (i = 0, parm = n->sym->member; parm != NULL; parm = parm->next)
+    cgstorlocal(arglist[i++], parm);
+  free(arglist);
+  cgjump(Ltail);
+  return (NOREG);
+}
+
 // Generate code for a ternary expression
 static int gen_ternary(struct ASTnode *n) {
-  int Lfalse, Lend;
+  int Ltrue, Lfalse, Lend;
   int reg, expreg;
-  int r, r2;
 
-  // Generate two labels: one for the
-  // false expression, and one for the
-  // end of the overall expression
+  // Generate three labels: one for each
+  // expression, and one for the end
+  // of the overall expression
+  Ltrue = genlabel();
   Lfalse = genlabel();
   Lend = genlabel();
 
   // Generate the condition code
-  r = genAST(n->left, Lfalse, NOLABEL, NOLABEL, n->op);
-  // Test to see if the condition is true. If not, jump to the false label
-  r2 = cgloadint(1, P_INT);
-  cgcompare_and_jump(A_EQ, r, r2, Lfalse, P_INT);
+  gencond(n->left, Ltrue, Lfalse);
+  cglabel(Ltrue);
 
   // Get a temporary to hold the result of the two expressions
   reg = cgalloctemp();
@@ -378,9 +663,11 @@ int genAST(struct ASTnode *n, int iflabel, int looptoplabel,
     case A_WHILE:
       return (genWHILE(n));
     case A_SWITCH:
-      return (genSWITCH(n));
+      return (genSWITCH(n, looptoplabel));
     case A_FUNCCALL:
       return (gen_funccall(n));//需要知道传的参数是什么，并使用call进行函数调用
+    case A_TAILCALL:
+      return (gen_tailcall(n));
     case A_TERNARY://用于处理三元运算符（ternary operator）
       return (gen_ternary(n));
     case A_LOGOR://表示逻辑或（||）和逻辑与（&&）运算符的常量或枚举值。
@@ -397,13 +684,26 @@ int genAST(struct ASTnode *n, int iflabel, int looptoplabel,
       if (n->left != NULL)
 	genAST(n->left, iflabel, looptoplabel, loopendlabel, n->op);
       if (n->right != NULL)
-	genAST(n->right, iflabel, looptoplabel, loopendlabel, n->op);
+	rightreg = genAST(n->right, iflabel, looptoplabel, loopendlabel, n->op);
+
+      // A glue with a type is an inlined function call:
+      // its value is the value of the right child
+      if (n->type != P_NONE)
+	return (rightreg);
       return (NOREG);
     case A_FUNCTION:
       // Generate the function's preamble before the code
       // in the child sub-tree
       /*该部分专门处理函数定义节点（A_FUNCTION），负责生成函数的前导代码（preamble）、函数体的代码以及函数的尾部代码（postamble）。*/
       cgfuncpreamble(n->sym);//在传参时，由于参数过小，可以通过一次性传多个参数进行传参的优化。
+
+      // Self tail calls jump back to here, after
+      // the parameters are put on the stack
+      Ltail = NOLABEL;
+      if (hastailcall(n->left)) {
+	Ltail = genlabel();
+	cglabel(Ltail);
+      }
       genAST(n->left, NOLABEL, NOLABEL, NOLABEL, n->op);
       cgfuncpostamble(n->sym);
       return (NOREG);
@@ -581,10 +881,9 @@ int genAST(struct ASTnode *n, int iflabel, int looptoplabel,
     case A_LOGNOT:
       return (cglognot(leftreg, type));
     case A_TOBOOL:
-      // If the parent AST node is an A_IF or A_WHILE, generate
-      // a compare followed by a jump. Otherwise, set the temporary
-      // to 0 or 1 based on it's zeroeness or non-zeroeness
-      return (cgboolean(leftreg, parentASTop, iflabel, type));
+      // Set the temporary to 0 or 1 based on its zeroeness or
+      // non-zeroeness. Conditions are done by gencond()
+      return (cgboolean(leftreg, type));
     case A_BREAK:
       cgjump(loopendlabel);
       return (NOREG);
@@ -610,9 +909,451 @@ void genpostamble() {
 
 //分配空间
 void genglobsym(struct symtable *node) {
+  genstartstatic(node);
   cgglobsym(node);
+  genendstatic(node);
+}
+
+// The code for static functions and data is kept in memory.
+// At the end of the file, only the statics which can be
+// reached from the exported functions are written out.
+// Usefrom[i] is a function which uses the static Useto[i]
+/*静态函数和数据的代码先留在内存里。文件结束时，只输出从导出的函数能够到达的静态符号。
+Usefrom[i] 是一个函数，它用到了静态符号 Useto[i]。*/
+static struct symtable **Defsym;	// The deferred statics
+static char **Deftext;			// Their QBE code
+static int *Deflen;
+static int *Defused;			// True if reachable
+static int Ndefer, Maxdefer;
+static struct symtable **Usefrom;
+static struct symtable **Useto;
+static int Nuses, Maxuses;
+
+// Record that func uses the static symbol sym
+static void adduse(struct symtable *func, struct symtable *sym) {
+  if (Nuses == Maxuses) {
+    Maxuses = Maxuses * 2 + 64;
+    Usefrom = (struct symtable **)
+      realloc(Usefrom, Maxuses * sizeof(struct symtable *));
+    Useto = (struct symtable **)
+      realloc(Useto, Maxuses * sizeof(struct symtable *));
+    if (Useto == NULL)
+      fatal("Unable to malloc in adduse()");
+  }
+  Usefrom[Nuses] = func;
+  Useto[Nuses] = sym;
+  Nuses++;
+}
+
+// Record the static symbols used in the tree
+// of the function func. Don't bother with the
+// same symbol twice in a row
+void genuses(struct ASTnode *n, struct symtable *func) {
+  if (n == NULL)
+    return;
+  if (n->sym != NULL && n->sym->class == C_STATIC && n->sym != func)
+    if (Nuses == 0 || Useto[Nuses - 1] != n->sym
+	|| Usefrom[Nuses - 1] != func)
+      adduse(func, n->sym);
+  genuses(n->left, func);
+  genuses(n->mid, func);
+  genuses(n->right, func);
+}
+
+// Start keeping the code for sym if it is static
+void genstartstatic(struct symtable *sym) {
+  if (sym->class == C_STATIC)
+    cgstartdefer();
+}
+
+// Keep the code for the static sym, or with no code,
+// keep a place for it. Return the place
+static int keepstatic(struct symtable *sym, char *text, int len) {
+  if (Ndefer == Maxdefer) {
+    Maxdefer = Maxdefer * 2 + 16;
+    Defsym = (struct symtable **)
+      realloc(Defsym, Maxdefer * sizeof(struct symtable *));
+    Deftext = (char **) realloc(Deftext, Maxdefer * sizeof(char *));
+    Deflen = (int *) realloc(Deflen, Maxdefer * sizeof(int));
+    Defused = (int *) realloc(Defused, Maxdefer * sizeof(int));
+    if (Defused == NULL)
+      fatal("Unable to malloc in keepstatic()");
+  }
+  Defsym[Ndefer] = sym;
+  Deftext[Ndefer] = text;
+  Deflen[Ndefer] = len;
+  Defused[Ndefer] = 0;
+  Ndefer++;
+  sym->st_defer = Ndefer;
+  return (Ndefer - 1);
+}
+
+// Keep the code generated for sym since genstartstatic()
+void genendstatic(struct symtable *sym) {
+  char *text;
+  int len;
+
+  if (sym->class != C_STATIC)
+    return;
+  text = cgenddefer(&len);
+  keepstatic(sym, text, len);
 }
 
+// With -fgen-jobs=n, the functions are put into batches, and
+// the code for up to n batches is generated at once by worker
+// processes while the parser carries on. Each worker sends the
+// code for its functions back down a pipe. The code is written
+// out in the order of the functions in the file, with the code
+// which the parser made in between, so it is the same as when
+// the functions are done one at a time. The last batch in a file
+// is done by the compiler itself while it waits for the workers
+/*使用 -fgen-jobs=n 时，函数被分成若干批，由工作进程同时为最多 n 批函数生成代码，
+语法分析则继续进行。每个工作进程通过管道把它的函数的代码送回来。代码按函数在文件中的
+顺序写出，中间夹着语法分析生成的代码，所以和一次做一个函数时的输出相同。
+文件中的最后一批函数由编译器自己在等待工作进程时完成。*/
+
+// A function whose code hasn't been written out yet
+struct genfunc {
+  struct ASTnode *tree;		// Its tree, until a worker has it
+  struct symtable *sym;		// Its symbol
+  struct symtable *locls;	// Its local variables
+  int label;			// The first label it can use
+  int place;			// Its place in the statics, or -1
+  char *code;			// Its code, once generated
+  int codelen;
+  char *after;			// The code the parser made after it
+  int afterlen;
+  struct genfunc *next;
+};
+
+enum {
+  GENBATCH = 20000,		// AST nodes in a batch
+  MAXGENJOBS = 64		// Most workers at once
+};
+
+static struct genfunc *Genhead, *Gentail;	// The functions not written out
+static struct genfunc *Batchhead;		// The batch not given to a worker
+static int Batchnodes;				// and its number of AST nodes
+static int Workpid[MAXGENJOBS];		// The workers, oldest first
+static int Workfd[MAXGENJOBS];		// The pipe from each one
+static int Workfuncs[MAXGENJOBS];	// and its number of functions
+static int Nworkers;
+
+// Return the number of nodes in the tree
+static int treenodes(struct ASTnode *n) {
+  if (n == NULL)
+    return (0);
+  return (1 + treenodes(n->left) + treenodes(n->mid) + treenodes(n->right));
+}
+
+// Generate the code for the function f and keep it in f
+static void genkept(struct genfunc *f) {
+  int len;
+
+  Functionid = f->sym;
+  Loclhead = f->locls;
+  labelid = f->label;
+  cgstartdefer();
+  genAST(f->tree, NOLABEL, NOLABEL, NOLABEL, 0);
+  f->code = cgenddefer(&len);
+  f->codelen = len;
+}
+
+// Write len bytes of text down a pipe
+static void writepipe(int fd, char *text, int len) {
+  long wrote;
+
+  while (len > 0) {
+    wrote = write(fd, text, len);
+    if (wrote <= 0)
+      fatal("Unable to write to a pipe");
+    text = text + wrote;
+    len = len - (int) wrote;
+  }
+}
+
+// Read all of the text from a pipe and set its length
+static char *readpipe(int fd, int *len) {
+  char *text = NULL;
+  int size = 0, n = 0;
+  long got;
+
+  while (1) {
+    if (n == size) {
+      size = size * 2 + 65536;
+      text = (char *) realloc(text, size);
+      if (text == NULL)
+	fatal("Unable to malloc in readpipe()");
+    }
+    got = read(fd, text + n, size - n);
+    if (got <= 0)
+      break;
+    n = n + (int) got;
+  }
+  if (got < 0)
+    fatal("Unable to read from a pipe");
+  *len = n;
+  return (text);
+}
+
+// Write out the code for the oldest function
+// and the code which comes after it
+static void writefunc(void) {
+  struct genfunc *f;
+  char *text;
+  int len;
+
+  // A static function goes in its place
+  // in the statics, the others are written out
+  f = Genhead;
+  if (f->place != -1) {
+    Deftext[f->place] = f->code;
+    Deflen[f->place] = f->codelen;
+  } else {
+    cgemitdeferred(f->code, f->codelen);
+    free(f->code);
+  }
+
+  // The code after the newest function is still being held
+  if (f->next == NULL) {
+    text = cgendhold(&len);
+    Gentail = NULL;
+  } else {
+    text = f->after;
+    len = f->afterlen;
+  }
+  cgemitdeferred(text, len);
+  free(text);
+  Genhead = f->next;
+  free(f);
+}
+
+// Get the code from the oldest worker and write out its functions
+static void endworker(void) {
+  char *text;
+  int i, n, len, pos, status;
+  struct genfunc *f;
+
+  text = readpipe(Workfd[0], &len);
+  close(Workfd[0]);
+  if (waitpid(Workpid[0], &status, 0) == -1 || status != 0)
+    fatal("A code generator worker failed");
+
+  // Each function's code comes after its length
+  pos = 0;
+  for (i = 0; i < Workfuncs[0]; i++) {
+    f = Genhead;
+    if (pos + sizeof(int) > len)
+      fatal("Short output from a code generator worker");
+    memcpy(&n, text + pos, sizeof(int));
+    pos = pos + sizeof(int);
+    if (pos + n > len)
+      fatal("Short output from a code generator worker");
+    f->code = (char *) malloc(n + 1);
+    if (f->code == NULL)
+      fatal("Unable to malloc in endworker()");
+    memcpy(f->code, text + pos, n);
+    f->codelen = n;
+    pos = pos + n;
+    writefunc();
+  }
+  free(text);
+
+  for (i = 1; i < Nworkers; i++) {
+    Workpid[i - 1] = Workpid[i];
+    Workfd[i - 1] = Workfd[i];
+    Workfuncs[i - 1] = Workfuncs[i];
+  }
+  Nworkers--;
+}
+
+// Start a worker process to generate the code for the batch
+static void startworker(void) {
+  int fds[2];
+  int pid, n, len;
+  struct genfunc *f;
+
+  // Wait for the oldest worker if they are all busy
+  if (Nworkers == O_genjobs || Nworkers == MAXGENJOBS)
+    endworker();
+
+  // Flush our output so that the worker doesn't repeat it
+  cgflush();
+  fflush(stdout);
+  if (pipe(fds) == -1)
+    fatal("Unable to make a pipe for a code generator worker");
+  pid = fork();
+  if (pid == -1)
+    fatal("Unable to start a code generator worker");
+
+  // The worker sends each function's length and code down the pipe
+  if (pid == 0) {
+    close(fds[0]);
+    for (f = Batchhead; f != NULL; f = f->next) {
+      genkept(f);
+      len = f->codelen;
+      writepipe(fds[1], (char *) &len, sizeof(int));
+      writepipe(fds[1], f->code, len);
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+
+  // The worker has its own copy of the trees
+  n = 0;
+  for (f = Batchhead; f != NULL; f = f->next) {
+    f->tree = NULL;
+    n++;
+  }
+  Workpid[Nworkers] = pid;
+  Workfd[Nworkers] = fds[0];
+  Workfuncs[Nworkers] = n;
+  Nworkers++;
+  Batchhead = NULL;
+  Batchnodes = 0;
+}
+
+// Generate the code for the function tree, whose symbol is sym.
+// Return true if the tree's AST nodes can be freed
+int genfunction(struct ASTnode *tree, struct symtable *sym) {
+  struct genfunc *f;
+  int firstlabel, line, len;
+
+  // The function's labels carry on from the parser's ones. They
+  // are given back afterwards, so that the code for a function
+  // doesn't depend on the functions before it. The parser's line
+  // number is kept as well
+  firstlabel = labelid;
+  line = Line;
+  if (O_genjobs == 1 || O_timelex || O_timereport) {
+    genstartstatic(sym);
+    genAST(tree, NOLABEL, NOLABEL, NOLABEL, 0);
+    genendstatic(sym);
+    labelid = firstlabel;
+    Line = line;
+    return (1);
+  }
+
+  // Keep the function until its code is written out
+  f = (struct genfunc *) malloc(sizeof(struct genfunc));
+  if (f == NULL)
+    fatal("Unable to malloc in genfunction()");
+  f->tree = tree;
+  f->sym = sym;
+  f->locls = Loclhead;
+  f->label = firstlabel;
+  f->place = -1;
+  if (sym->class == C_STATIC)
+    f->place = keepstatic(sym, NULL, 0);
+  f->code = NULL;
+  f->after = NULL;
+  f->afterlen = 0;
+  f->next = NULL;
+
+  // The code held since the last function comes after
+  // it, then hold the code which comes after this one
+  if (Gentail != NULL) {
+    Gentail->after = cgendhold(&len);
+    Gentail->afterlen = len;
+    Gentail->next = f;
+  } else
+    Genhead = f;
+  Gentail = f;
+  cgstarthold();
+
+  // Give the batch to a worker once it is big enough
+  if (Batchhead == NULL)
+    Batchhead = f;
+  Batchnodes = Batchnodes + treenodes(tree);
+  if (Batchnodes < GENBATCH)
+    return (0);
+  startworker();
+  return (1);
+}
+
+// At the end of a file, generate the code for the last batch,
+// then write out the code for all the functions
+static void genfinish(void) {
+  struct genfunc *f;
+  int label;
+
+  label = labelid;
+  for (f = Batchhead; f != NULL; f = f->next)
+    genkept(f);
+  Batchhead = NULL;
+  Batchnodes = 0;
+  Functionid = NULL;
+  Loclhead = NULL;
+  labelid = label;
+
+  while (Nworkers > 0)
+    endworker();
+  while (Genhead != NULL)
+    writefunc();
+}
+
+// Return true if sym is exported, or is a static
+// which has been found to be reachable
+static int reachable(struct symtable *sym) {
+  int i;
+
+  if (sym->class != C_STATIC)
+    return (1);
+  i = sym->st_defer;
+  if (i == 0)
+    return (0);
+  return (Defused[i - 1]);
+}
+
+// At the end of a file, write out the statics which can be
+// reached from the exported functions and throw away the rest.
+// Return the number of statics thrown away
+/*在文件结束时，输出从导出的函数能够到达的静态符号，丢弃其余的。返回丢弃的静态符号个数。*/
+int genstatics(void) {
+  int i, j, changed, removed;
+
+  // Write out the functions still being generated
+  genfinish();
+
+  // Mark the statics used by reachable functions
+  // until there are no more to mark
+  changed = 1;
+  while (changed) {
+    changed = 0;
+    for (i = 0; i < Nuses; i++) {
+      j = Useto[i]->st_defer;
+      if (j != 0 && Defused[j - 1] == 0 && reachable(Usefrom[i])) {
+	Defused[j - 1] = 1;
+	changed = 1;
+      }
+    }
+  }
+
+  // Write out the reachable ones
+  removed = 0;
+  for (i = 0; i < Ndefer; i++) {
+    if (Defused[i])
+      cgemitdeferred(Deftext[i], Deflen[i]);
+    else
+      removed++;
+    free(Deftext[i]);
+    Defsym[i]->st_defer = 0;
+  }
+  Ndefer = 0;
+  Nuses = 0;
+  return (removed);
+}
+
+// The length of each string literal, by the
+// label of its first part, and the label of
+// the string literal being built
+enum {
+  STRLENSINC = 1024		// Number of lengths to add at a time
+};
+static int *Strlens;
+static int Nstrlens;
+static int Strlabel;
+
 // Generate a global string.
 // If append is true, append to
 // previous genglobstr() call.
@@ -623,9 +1364,33 @@ cgglobstr 函数通常由编译器的后端（code generation）部分实现，
 */
 int genglobstr(char *strvalue, int append) {
   int l = genlabel();
+  int len = (int) strlen(strvalue);
+
   cgglobstr(l, strvalue, append);
+
+  // Keep the length of the whole string under its first label
+  if (append) {
+    Strlens[Strlabel] = Strlens[Strlabel] + len;
+    return (l);
+  }
+  if (l >= Nstrlens) {
+    Nstrlens = l + STRLENSINC;
+    Strlens = (int *) realloc(Strlens, Nstrlens * sizeof(int));
+    if (Strlens == NULL)
+      fatal("Unable to malloc in genglobstr()");
+  }
+  Strlabel = l;
+  Strlens[l] = len;
   return (l);
 }
+
+// Return the length of the string literal with the given
+// label, or -1 if there is no string with that label
+int genstrlen(int label) {
+  if (label >= Nstrlens)
+    return (-1);
+  return (Strlens[label]);
+}
 void genglobstrend(void) {
   cgglobstrend();
 }
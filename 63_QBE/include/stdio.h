@@ -31,6 +31,8 @@ int puts(char *s);
 FILE *popen(char *command, char *type);
 int pclose(FILE *stream);
 int fflush(FILE *stream);
+int fileno(FILE *stream);
+int rename(char *oldpath, char *newpath);
 
 extern FILE *stdin;
 extern FILE *stdout;
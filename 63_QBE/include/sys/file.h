@@ -0,0 +1,10 @@
+#ifndef _SYS_FILE_H_
+# define _SYS_FILE_H_
+
+#define LOCK_SH 1
+#define LOCK_EX 2
+#define LOCK_UN 8
+
+int flock(int fd, int operation);
+
+#endif	// _SYS_FILE_H_
@@ -0,0 +1,11 @@
+#ifndef _SYS_MMAN_H_
+# define _SYS_MMAN_H_
+
+#define PROT_READ	1
+#define PROT_WRITE	2
+#define MAP_PRIVATE	2
+
+void *mmap(void *addr, long length, int prot, int flags, int fd, long offset);
+int munmap(void *addr, long length);
+
+#endif	// _SYS_MMAN_H_
@@ -0,0 +1,17 @@
+#ifndef _SYS_SOCKET_H_
+# define _SYS_SOCKET_H_
+
+#define AF_UNIX 1
+#define SOCK_STREAM 1
+#define SHUT_WR 1
+#define MSG_NOSIGNAL 0x4000
+
+int socket(int domain, int type, int protocol);
+int bind(int sockfd, void *addr, int addrlen);
+int listen(int sockfd, int backlog);
+int accept(int sockfd, void *addr, void *addrlen);
+int connect(int sockfd, void *addr, int addrlen);
+int shutdown(int sockfd, int how);
+long send(int sockfd, void *buf, long len, int flags);
+
+#endif	// _SYS_SOCKET_H_
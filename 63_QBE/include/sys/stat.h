@@ -0,0 +1,6 @@
+#ifndef _SYS_STAT_H_
+# define _SYS_STAT_H_
+
+int mkdir(char *pathname, int mode);
+
+#endif	// _SYS_STAT_H_
@@ -0,0 +1,11 @@
+#ifndef _SYS_TIME_H_
+# define _SYS_TIME_H_
+
+struct timeval {
+  long tv_sec;
+  long tv_usec;
+};
+
+int gettimeofday(struct timeval *tv, void *tz);
+
+#endif	// _SYS_TIME_H_
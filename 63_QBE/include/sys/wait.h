@@ -0,0 +1,7 @@
+#ifndef _SYS_WAIT_H_
+# define _SYS_WAIT_H_
+
+int wait(int *wstatus);
+int waitpid(int pid, int *wstatus, int options);
+
+#endif	// _SYS_WAIT_H_
@@ -0,0 +1,11 @@
+#ifndef _TIME_H_
+# define _TIME_H_
+
+typedef long clock_t;
+
+// XSI requires CLOCKS_PER_SEC to be one million
+#define CLOCKS_PER_SEC 1000000
+
+clock_t clock(void);
+
+#endif	// _TIME_H_
@@ -3,5 +3,20 @@
 
 void _exit(int status);
 int unlink(char *pathname);
+int fork(void);
+int pipe(int *pipefd);
+long read(int fd, void *buf, long count);
+long write(int fd, void *buf, long count);
+int close(int fd);
+int dup2(int oldfd, int newfd);
+int chdir(char *path);
+char *getcwd(char *buf, long size);
+int getpid(void);
+
+#define SEEK_END 2
+long lseek(int fd, long offset, int whence);
+
+#define _SC_CLK_TCK 2
+long sysconf(int name);
 
 #endif	// _UNISTD_H_
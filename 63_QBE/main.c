@@ -5,6 +5,8 @@
 #include "decl.h"
 #include <errno.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
 
 // Compiler setup and top-level execution
 // Copyright (c) 2019 Warren Toomey, GPL3
@@ -43,16 +45,139 @@ char *alter_suffix(char *str, char suffix) {
   return (newstr);
 }
 
-// Given an input filename, compile that file
-// down to assembly code. Return the new file's name
+// Scan all the tokens in the input buffer, then rewind
+// the input so that the parser sees it from the start.
+// Return the number of tokens
+/*扫描输入缓冲区中的所有标记，然后回到输入的开头，让语法分析从头开始。返回标记的个数。*/
+static int scanall(char *filename) {
+  int tokens = 0;
+
+  scan(&Token);
+  while (Token.token != T_EOF) {
+    tokens++;
+    scan(&Token);
+  }
+
+  rewindinput();
+  Infilename = filename;
+  Line = 1;
+  Linestart = 1;
+  Putback = '\n';
+  return (tokens);
+}
+
+// Scan all the tokens in the input buffer and report
+// how fast the scanner went. len is the size of the
+// input in bytes
+/*扫描输入缓冲区中的所有标记并报告扫描速度。*/
+static void timelex(char *filename, int len) {
+  long start, usecs, rate, tokrate;
+  int tokens;
+
+  // clock() counts in microseconds
+  start = clock();
+  tokens = scanall(filename);
+  usecs = clock() - start;
+  if (usecs == 0)
+    usecs = 1;
+
+  // Bytes per microsecond is MB/s. Keep two decimal places
+  rate = len;
+  rate = rate * 100 / usecs;
+  tokrate = tokens;
+  tokrate = tokrate * 1000000 / usecs;
+  printf("%s: scanned %d bytes, %d tokens in %ld usecs, %ld.%02ld MB/s",
+	 filename, len, tokens, usecs, rate / 100, rate % 100);
+  printf(", %ld tokens/sec\n", tokrate);
+}
+
+// Start the processes which turn the QBE code for filename
+// into an assembly file (with -S) or an object file, and
+// return a pipe to write the QBE code down. qbe reads the
+// code from its standard input and, unless we keep the
+// assembly, writes to a pipe into as. Set Outfilename to
+// the file that they produce
+/*启动把 filename 的 QBE 代码变成汇编文件（-S）或目标文件的进程，返回写入 QBE 代码的管道。
+qbe 从标准输入读取代码，不保留汇编时把输出通过管道交给 as，不产生任何中间文件。*/
+static FILE *open_pipeline(char *filename) {
+  char cmd[TEXTLEN];
+  FILE *fp;
+
+  // The pipeline's exit status is the one from as. If qbe
+  // fails, give as a .err directive so that it fails too
+  // With -O0 there is no qbe, and as reads the assembly
+  // code from its standard input
+  if (O_x64) {
+    Outfilename = alter_suffix(filename, 'o');
+    snprintf(cmd, TEXTLEN, "%s%s", ASCMD, Outfilename);
+  } else if (O_keepasm) {
+    Outfilename = alter_suffix(filename, 's');
+    snprintf(cmd, TEXTLEN, "%s%s -", QBECMD, Outfilename);
+  } else {
+    Outfilename = alter_suffix(filename, 'o');
+    snprintf(cmd, TEXTLEN, "{ %s- - || echo .err; } | %s%s",
+	     QBECMD, ASCMD, Outfilename);
+  }
+  if (O_verbose)
+    printf("%s\n", cmd);
+  if ((fp = popen(cmd, "w")) == NULL) {
+    fprintf(stderr, "Unable to run %s: %s\n", cmd, strerror(errno));
+    exit(1);
+  }
+  return (fp);
+}
+
+// Close the output file. With -p, wait
+// for the qbe and as processes to finish
+static void close_output(char *filename) {
+  if (!O_pipeline) {
+    fclose(Outfile);
+    return;
+  }
+  if (pclose(Outfile) != 0) {
+    if (O_x64)
+      fprintf(stderr, "Assembly of %s failed\n", filename);
+    else
+      fprintf(stderr, "QBE translation of %s failed\n", filename);
+    unlink(Outfilename);
+    exit(1);
+  }
+}
+
+// Report how fast the code generator went
+// on the functions in this file
+/*报告代码生成器生成这个文件中函数的 QBE 代码的速度。*/
+static void timegen(char *filename) {
+  long usecs, rate;
+
+  usecs = Gentime;
+  if (usecs == 0)
+    usecs = 1;
+  rate = Genbytes * 100 / usecs;
+  printf("%s: generated %ld bytes of QBE code in %ld usecs, %ld.%02ld MB/s\n",
+	 filename, Genbytes, usecs, rate / 100, rate % 100);
+}
+
+// True if the file being compiled can use the compile cache.
+// The options which report on the compilation need it to run
+static int Cacheable;
+
+// Given an input filename, compile that file down to
+// assembly code. Return the new file's name, or NULL if
+// there is nothing more to do with the file
 /*这段代码是一个函数，用于编译给定的输入文件（C语言源文件）*/
 static char *do_compile(char *filename) {
   char cmd[TEXTLEN];
+  int len, removed, prefix, warm;
 
-  // Change the input file's suffix to .q
-  /* 使用 alter_suffix 函数将输入文件名的后缀更改为 'q'，
+  // Change the input file's suffix to .q, or
+  // to .s when we write the assembly directly
+  /* 使用 alter_suffix 函数将输入文件名的后缀更改为 'q'（-O0 时为 's'），
   并将结果存储在 Outfilename 变量中。这里假设输入文件的后缀是可修改的，如果无法修改，输出错误信息并退出。*/
-  Outfilename = alter_suffix(filename, 'q');
+  if (O_x64)
+    Outfilename = alter_suffix(filename, 's');
+  else
+    Outfilename = alter_suffix(filename, 'q');
   if (Outfilename == NULL) {
     fprintf(stderr, "Error: %s has no suffix, try .c on the end\n", filename);
     exit(1);
@@ -65,6 +190,10 @@ static char *do_compile(char *filename) {
   -isystem /tmp/include: 指定一个系统头文件目录，即告诉预处理器在 /tmp/include 目录中寻找系统头文件。这通常用于指定非标准的头文件目录，以便在编译时使用特定的头文件。
   */
   snprintf(cmd, TEXTLEN, "%s %s %s", CPPCMD, INCDIR, filename);
+  if (O_timereport) {
+    resetreport();
+    phasestart(PH_CPP);
+  }
 
   // Open up the pre-processor pipe
   /*
@@ -79,28 +208,127 @@ static char *do_compile(char *filename) {
   }
   Infilename = filename;
 
-  // Create the output file
+  // Read all of the pre-processed input
+  /*把预处理后的全部输入读入扫描器的缓冲区，并关闭管道。*/
+  len = readinput();
+  if (O_timereport)
+    phaseend(PH_CPP);
+
+  Line = 1;			// Reset the scanner将当前行号初始化为 1。
+  Linestart = 1;//表示在新的一行的开头。
+  Putback = '\n';//将 Putback 设置为换行符，表示扫描器的前一个字符是换行符。
+
+  // With -L, only time the scanner
+  /*用 -L 时只对词法分析计时，不做其它工作。*/
+  if (O_lexonly) {
+    timelex(filename, len);
+    return (NULL);
+  }
+
+  // With -emit-pch, write out the header's symbols
+  /*用 -emit-pch 时，把头文件的符号写出去。*/
+  if (O_emitpch) {
+    pchemit(filename, len);
+    return (NULL);
+  }
+
+  // Use the files in the compile cache if it has them
+  /*如果编译缓存中有这个文件生成的文件，就直接使用它们。*/
+  Cacheable = O_cachedir != NULL && !O_dumpAST && !O_dumpsym && !O_timelex
+    && !O_timereport;
+  if (Cacheable && cachefind(filename, inputbuf(), len)) {
+    Cacheable = 0;
+    return (NULL);
+  }
+
+  // Create the output file, or with -p
+  // the pipe to the qbe and as processes
   /*fopen 函数用于打开文件，它的第一个参数是文件路径（在这里是 Outfilename，表示输出文件的路径），
   第二个参数是文件打开模式（在这里是 "w"，表示以写入方式打开文件）。
   如果 fopen 打开文件成功，它将返回一个文件指针（FILE *），该文件指针可以用于写入文件。*/
-  if ((Outfile = fopen(Outfilename, "w")) == NULL) {
+  if (O_pipeline)
+    Outfile = open_pipeline(filename);
+  else if ((Outfile = fopen(Outfilename, "w")) == NULL) {
     fprintf(stderr, "Unable to create %s: %s\n", Outfilename,
 	    strerror(errno));
     exit(1);
   }
 
-  Line = 1;			// Reset the scanner将当前行号初始化为 1。
-  Linestart = 1;//表示在新的一行的开头。
-  Putback = '\n';//将 Putback 设置为换行符，表示扫描器的前一个字符是换行符。
-  clear_symtable();		// Clear the symbol table// 清空符号表，以确保符号表是空的。
+  // In a compile server, the symbol table may already
+  // have the declarations from the headers at the top
+  // of the file. If so, we keep them and skip the headers.
+  // Otherwise, a PCH file may have them
+  /*在编译服务器中，符号表里可能已经有文件开头的头文件中的声明。这时保留它们并跳过这些头文件。
+  否则 PCH 文件中可能有这些声明。*/
+  prefix = 0;
+  warm = 0;
+  if (Serving || O_includepch != NULL)
+    prefix = headerprefix(filename, inputbuf(), len);
+  if (prefix > 0 && Serving)
+    warm = serverwarm();
+  if (!warm) {
+    clear_symtable();		// Clear the symbol table// 清空符号表，以确保符号表是空的。
+    freeinline();		// and the functions kept for inlining
+    if (Serving)
+      resetlabels();
+    if (prefix > 0 && O_includepch != NULL) {
+      if (O_timereport)		// Loading it counts as parsing
+	phasestart(PH_PARSE);
+      warm = pchload(O_includepch, filename);
+      if (O_timereport)
+	phaseend(PH_PARSE);
+    }
+  }
+
+  // Outside a compile server, headers which
+  // aren't warm are parsed with the file
+  if (!warm && !Serving)
+    prefix = 0;
+
+  if (O_timelex)
+    timelex(filename, len);
+
+  // With -ftime-report, time the scanner on a pass
+  // of its own so that it can be told from the parser
+  /*用 -ftime-report 时，让词法分析单独扫描一遍并计时，以便和语法分析区分开。*/
+  if (O_timereport) {
+    phasestart(PH_SCAN);
+    if (warm)			// The parser won't scan the headers
+      inputrange(prefix, len);
+    scanall(filename);
+    phaseend(PH_SCAN);
+    phasestart(PH_PARSE);
+  }
+  Gentime = 0;
+  Genbytes = 0;
+
   if (O_verbose)
     printf("compiling %s\n", filename);
+  genpreamble(filename);	// Output the preamble/*输出编译的前导部分。这可能包括一些汇编代码，用于初始化程序的一些全局设置等。
+  if (prefix > 0) {
+    if (!warm)			// Parse the headers on their own
+      serverparse(prefix);
+    inputrange(prefix, len);	// and then the rest of the file
+  }
   scan(&Token);			// Get the first token from the input调用 scan 函数，从输入文件中获取第一个令牌（token）。这是编译器开始解析源代码的一部分。
   Peektoken.token = 0;		// and set there is no lookahead token设置没有预读令牌。这将在后续的代码中用于处理预读的令牌。
-  genpreamble(filename);	// Output the preamble/*输出编译的前导部分。这可能包括一些汇编代码，用于初始化程序的一些全局设置等。
   global_declarations();	// Parse the global declarations/*解析全局声明。这一部分负责解析源文件中的全局变量和函数声明。在这里进行Token的运动
+  removed = genstatics();	// Output the statics which are used
+  if (O_verbose)
+    printf("%s: removed %d unused static functions and variables\n",
+	   filename, removed);
   genpostamble();		// Output the postamble输出编译的后导部分。这可能包括一些汇编代码，用于结束程序的执行等。
-  fclose(Outfile);		// Close the output file关闭输出文件。这是编译器生成的目标文件或汇编文件。
+
+  // With -p, closing the output waits for qbe and as
+  if (O_timereport) {
+    phaseend(PH_PARSE);
+    phasestart(PH_QBE);
+  }
+  close_output(filename);	// Close the output file关闭输出文件。这是编译器生成的目标文件或汇编文件。
+  if (O_timereport)
+    phaseend(PH_QBE);
+  if (O_timelex)
+    timegen(filename);
 
   // Dump the symbol table if requested
   /*通过检查 O_dumpsym 的值判断是否需要打印符号表。*/
@@ -212,6 +440,93 @@ void do_link(char *outfilename, char **objlist) {
   }
 }
 
+// Take an input file through all the stages up to an
+// object file, or an assembly file with -S. With -p,
+// do_compile() does all of this by itself
+/*把一个输入文件一直处理到目标文件（-S 时到汇编文件）。*/
+static void compile_file(char *filename) {
+  char *qbefile, *asmfile;
+
+  qbefile = do_compile(filename);	// Compile the source file
+  if (qbefile == NULL)		// Nothing more to do with -L
+    return;			// or if the cache had the files
+  if (O_pipeline) {
+    if (Cacheable)
+      cachestore(filename);
+    if (O_timereport)
+      filereport(filename);
+    return;
+  }
+  asmfile = qbefile;		// With -O0 it is already assembly
+  if (!O_x64) {
+    if (O_timereport)
+      phasestart(PH_QBE);
+    asmfile = do_qbe(qbefile);	// Translate the QBE code to assembly
+    if (O_timereport)
+      phaseend(PH_QBE);
+  }
+  if (O_dolink || O_assemble) {
+    if (O_timereport)
+      phasestart(PH_AS);
+    do_assemble(asmfile);	// Assemble it to object form
+    if (O_timereport)
+      phaseend(PH_AS);
+  }
+  if (Cacheable)		// Keep the files in the cache
+    cachestore(filename);
+  if (!O_keepasm) {		// Remove the QBE and assembly files
+    if (!O_x64)			// if we don't need to keep them
+      unlink(qbefile);
+    unlink(asmfile);
+  }
+  if (O_timereport)
+    filereport(filename);
+}
+
+// Compile the input files argv[first] up to argv[argc-1]
+// in worker processes, with up to O_jobs of them running
+// at once. Stop if any of them fails
+/*用子进程编译输入文件，最多同时运行 O_jobs 个，任何一个失败就停止。*/
+static void do_jobs(char **argv, int first, int argc) {
+  int i, pid, status, running = 0, failed = 0;
+
+  for (i = first; i < argc; i++) {
+    // Wait for a worker to finish if they are all busy
+    if (running == O_jobs) {
+      wait(&status);
+      running--;
+      if (status != 0)
+	failed = 1;
+    }
+    if (failed)
+      break;
+
+    // Start a worker on the next file. Flush our
+    // output so that the worker doesn't repeat it
+    fflush(stdout);
+    pid = fork();
+    if (pid == -1) {
+      fprintf(stderr, "Unable to start a worker: %s\n", strerror(errno));
+      exit(1);
+    }
+    if (pid == 0) {
+      compile_file(argv[i]);
+      exit(0);
+    }
+    running++;
+  }
+
+  // Wait for the workers still running
+  while (running > 0) {
+    wait(&status);
+    running--;
+    if (status != 0)
+      failed = 1;
+  }
+  if (failed)
+    exit(1);
+}
+
 // Print out a usage if started incorrectly
 /*
 这个函数的作用是打印程序的用法信息，用于指导用户如何正确启动程序。
@@ -219,24 +534,64 @@ void do_link(char *outfilename, char **objlist) {
 如果用户启动程序时提供了不正确的参数，可以调用这个函数来显示正确的用法信息，并退出程序。
 */
 static void usage(char *prog) {
-  fprintf(stderr, "Usage: %s [-vcSTM] [-o outfile] file [file ...]\n", prog);
+  fprintf(stderr,
+	  "Usage: %s [-vcSTMtpL] [-O0] [-j jobs] [-finline-limit=n]\n",
+	  prog);
+  fprintf(stderr,
+	  "       [-fgen-jobs=n] [-C cachedir] [-fcache-size=n] [-ftime-report[=json]]\n");
+  fprintf(stderr,
+	  "       [-fno-peephole] [-emit-pch] [-include-pch pchfile] [-o outfile]\n");
+  fprintf(stderr, "       file [file ...]\n");
+  fprintf(stderr, "       %s --server socket\n", prog);
+  fprintf(stderr, "       %s --connect socket [options] file [file ...]\n",
+	  prog);
   fprintf(stderr,
 	  "       -v give verbose output of the compilation stages\n");
   fprintf(stderr, "       -c generate object files but don't link them\n");
   fprintf(stderr, "       -S generate assembly files but don't link them\n");
   fprintf(stderr, "       -T dump the AST trees for each input file\n");
   fprintf(stderr, "       -M dump the symbol table for each input file\n");
+  fprintf(stderr,
+	  "       -t report the scanner's and code generator's speed for each input file\n");
+  fprintf(stderr,
+	  "       -p pipe the QBE code through qbe and as with no temporary files\n");
+  fprintf(stderr,
+	  "       -L only scan the input files and report the scanner's speed\n");
+  fprintf(stderr,
+	  "       -O0 write x86-64 assembly directly, without qbe, for a faster compile\n");
+  fprintf(stderr, "       -j jobs, compile up to jobs files at once\n");
+  fprintf(stderr,
+	  "       -finline-limit=n, inline static functions of up to n AST nodes (default 20, 0 is off)\n");
+  fprintf(stderr,
+	  "       -fgen-jobs=n, generate the code for the functions in up to n worker processes\n");
+  fprintf(stderr,
+	  "       -C cachedir, keep the compiled files in cachedir and reuse them\n");
+  fprintf(stderr,
+	  "       -fcache-size=n, limit the cache to n Mbytes (default 64)\n");
+  fprintf(stderr,
+	  "       -ftime-report, report the time and memory used by each phase and function\n");
+  fprintf(stderr,
+	  "       -ftime-report=json, the same report as JSON, one line per file\n");
+  fprintf(stderr,
+	  "       -fno-peephole, don't tidy up each function's QBE code\n");
+  fprintf(stderr,
+	  "       -emit-pch, parse each header file and write its symbols to file.pch\n");
+  fprintf(stderr,
+	  "       -include-pch pchfile, use the symbols in pchfile when a file's headers match it\n");
   fprintf(stderr, "       -o outfile, produce the outfile executable file\n");
+  fprintf(stderr,
+	  "       --server socket, run as a compile server on the Unix socket\n");
+  fprintf(stderr,
+	  "       --connect socket, send the compile to the server on the socket\n");
   exit(1);
 }
 
-// Main program: check arguments and print a usage
-// if we don't have an argument. Open up the input
-// file and call scanfile() to scan the tokens in it.
+// Check the arguments and print a usage if we
+// don't have an argument. Compile each input
+// file and link them. Return the exit status
 enum { MAXOBJ = 100 };
-int main(int argc, char **argv) {
+int runcwj(int argc, char **argv) {
   char *outfilename = AOUT;/*存储输出文件的名称。可以通过 -o 命令行选项进行更改，指定生成的可执行文件的名称。*/
-  char *qbefile, *asmfile, *objfile;/*存储生成的中间文件（QBE 文件、汇编文件、目标文件）的文件名。*/
   char *objlist[MAXOBJ];/*存储所有生成的目标文件的列表。这个列表将用于链接操作。*/
   int i, j, objcnt = 0;/*跟踪 objlist 数组中存储的目标文件的数量。*/
 
@@ -247,6 +602,20 @@ int main(int argc, char **argv) {
   O_assemble = 0;/*是否进行汇编。*/
   O_verbose = 0;/*是否输出详细信息。*/
   O_dolink = 1;/*是否进行链接。*/
+  O_timelex = 0;/*是否报告词法分析的速度。*/
+  O_pipeline = 0;/*是否用管道连接 qbe 和 as，不产生中间文件。*/
+  O_x64 = 0;/*是否不经过 qbe，直接生成 x86-64 汇编代码。*/
+  O_lexonly = 0;/*是否只做词法分析并报告速度。*/
+  O_jobs = 1;/*同时编译的文件数。*/
+  O_genjobs = 1;/*同时生成代码的工作进程数。*/
+  O_inlinelimit = 20;/*内联的函数最多有多少个 AST 节点，0 表示不内联。*/
+  O_peephole = 1;/*是否对每个函数的 QBE 代码做窥孔优化。*/
+  O_cachedir = NULL;/*编译缓存目录，NULL 表示不用缓存。*/
+  O_timereport = 0;/*是否报告每个阶段所用的时间和内存。*/
+  O_cachesize = 64 * 1048576;/*编译缓存的最大字节数。*/
+  O_emitpch = 0;/*是否把头文件的符号写到 PCH 文件中。*/
+  O_includepch = NULL;/*使用的 PCH 文件，NULL 表示不用。*/
+  checkkeywords();
 
   // Scan for command-line options
   for (i = 1; i < argc; i++) {
@@ -282,46 +651,142 @@ int main(int argc, char **argv) {
 	case 'v':
 	  O_verbose = 1;
 	  break;
+	case 't':
+	  O_timelex = 1;
+	  break;
+	case 'p':
+	  O_pipeline = 1;
+	  break;
+	case 'O':
+	  // -O0: write x86-64 assembly code directly
+	  // instead of going through qbe. This chooses
+	  // the code generator in cgx64.c for backend.c
+	  if (strcmp(argv[i], "-O0"))
+	    usage(argv[0]);
+	  O_x64 = 1;
+	  j++;
+	  break;
+	case 'e':
+	  // -emit-pch: write each header's symbols to a PCH file
+	  if (strcmp(argv[i], "-emit-pch"))
+	    usage(argv[0]);
+	  O_emitpch = 1;
+	  O_assemble = 0;
+	  O_dolink = 0;
+	  while (argv[i][j + 1])
+	    j++;
+	  break;
+	case 'i':
+	  // -include-pch pchfile: the PCH file to use
+	  if (strcmp(argv[i], "-include-pch") || i + 1 >= argc)
+	    usage(argv[0]);
+	  O_includepch = argv[++i];	// Save & skip to next argument
+	  break;
+	case 'L':
+	  O_lexonly = 1;
+	  O_assemble = 0;
+	  O_dolink = 0;
+	  break;
+	case 'j':
+	  if (i + 1 >= argc)
+	    usage(argv[0]);
+	  O_jobs = atoi(argv[++i]);	// Save & skip to next argument
+	  if (O_jobs < 1)
+	    usage(argv[0]);
+	  break;
+	case 'C':
+	  if (i + 1 >= argc)
+	    usage(argv[0]);
+	  O_cachedir = argv[++i];	// Save & skip to next argument
+	  break;
+	case 'f':
+	  // -finline-limit=n: the size of the largest
+	  // function to inline, or 0 to inline nothing.
+	  // -fgen-jobs=n: the number of code generator workers.
+	  // -fcache-size=n: the compile cache's size in Mbytes.
+	  // -ftime-report[=json]: report each phase's times.
+	  // -fno-peephole: don't run the peephole pass
+	  if (!strncmp(argv[i], "-finline-limit=", 15)) {
+	    O_inlinelimit = atoi(argv[i] + 15);
+	    if (O_inlinelimit < 0)
+	      usage(argv[0]);
+	  } else if (!strncmp(argv[i], "-fgen-jobs=", 11)) {
+	    O_genjobs = atoi(argv[i] + 11);
+	    if (O_genjobs < 1)
+	      usage(argv[0]);
+	  } else if (!strncmp(argv[i], "-fcache-size=", 13)) {
+	    O_cachesize = atoi(argv[i] + 13);
+	    if (O_cachesize < 1)
+	      usage(argv[0]);
+	    O_cachesize = O_cachesize * 1048576;
+	  } else if (!strcmp(argv[i], "-ftime-report"))
+	    O_timereport = 1;
+	  else if (!strcmp(argv[i], "-ftime-report=json"))
+	    O_timereport = 2;
+	  else if (!strcmp(argv[i], "-fno-peephole"))
+	    O_peephole = 0;
+	  else
+	    usage(argv[0]);
+
+	  // Skip the rest of this argument
+	  while (argv[i][j + 1])
+	    j++;
+	  break;
 	default:
 	  usage(argv[0]);
       }
     }
   }
 
+  // With -O0 and -S the assembly file is written
+  // directly, so there is nothing to pipe it through
+  if (O_x64 && O_keepasm)
+    O_pipeline = 0;
+
   // Ensure we have at lease one input file argument
   /*如果确实没有提供输入文件参数，程序会调用 usage(argv[0]) 函数，该函数会打印出程序的用法信息，并终止程序的执行。*/
   if (i >= argc)
     usage(argv[0]);
 
-  // Work on each input file in turn
-  while (i < argc) {
-    /*使用 do_compile 函数将源文件编译为 QBE 中间代码文件。*/
-    qbefile = do_compile(argv[i]);	// Compile the source file
-    /*使用 do_qbe 函数将 QBE 文件转换为汇编语言文件。*/
-    asmfile = do_qbe(qbefile);
-    /*如果设置了链接标志 O_dolink 或者汇编标志 O_assemble，则使用 do_assemble 函数将汇编文件汇编成目标文件。*/
-    if (O_dolink || O_assemble) {
-      objfile = do_assemble(asmfile);	// Assemble it to object forma
+  // Make the list of object files we will produce
+  if (O_dolink || O_assemble) {
+    for (j = i; j < argc; j++) {
       if (objcnt == (MAXOBJ - 2)) {
 	fprintf(stderr, "Too many object files for the compiler to handle\n");
 	exit(1);
       }
-      /*将生成的目标文件名添加到对象文件列表 objlist 中。*/
-      objlist[objcnt++] = objfile;	// Add the object file's name
+      /*将目标文件名添加到对象文件列表 objlist 中。*/
+      objlist[objcnt++] = alter_suffix(argv[j], 'o');	// Add the object file's name
       objlist[objcnt] = NULL;	// to the list of object files
     }
-    /*如果不需要保留中间文件（QBE 和汇编文件），则使用 unlink 函数删除这些文件。*/
-    if (!O_keepasm) {		// Remove the QBE and assembly files
-      unlink(qbefile);		// if we don't need to keep them
-      unlink(asmfile);
-    }
-    i++;
   }
 
+  // Set up the compile cache
+  if (O_cachedir != NULL)
+    cacheinit();
+
+  // Work on each input file in turn, or give them to
+  // worker processes. In a compile server, each file gets
+  // its own process, so that each starts from the headers
+  // already in the server's symbol table
+  /*依次处理每个输入文件，或者用 -j 把它们交给多个子进程同时编译。
+  在编译服务器中每个文件都有自己的进程，都从服务器符号表中已有的头文件声明开始。*/
+  if (O_jobs > 1 || Serving)
+    do_jobs(argv, i, argc);
+  else
+    for (j = i; j < argc; j++)
+      compile_file(argv[j]);
+
   // Now link all the object files together
   /*如果 O_dolink 为真，表示需要进行链接操作，则调用 do_link 函数将所有对象文件链接在一起，生成最终的可执行文件。*/
   if (O_dolink) {
+    if (O_timereport)
+      phasestart(PH_LINK);
     do_link(outfilename, objlist);
+    if (O_timereport) {
+      phaseend(PH_LINK);
+      linkreport();
+    }
 
     // If we don't need to keep the object
     // files, then remove them
@@ -331,5 +796,19 @@ int main(int argc, char **argv) {
     }
   }
 
+  // With -v, report on the compile cache
+  if (O_cachedir != NULL && O_verbose)
+    cachestats();
+
   return (0);
 }
+
+// Main program: run as a compile server, send a
+// compile to one, or do the compile ourselves
+int main(int argc, char **argv) {
+  if (argc > 2 && !strcmp(argv[1], "--server"))
+    return (serve(argv[2]));
+  if (argc > 2 && !strcmp(argv[1], "--connect"))
+    return (client(argv[2], argc - 2, argv + 2));
+  return (runcwj(argc, argv));
+}
@@ -84,3 +84,78 @@ void fatalc(char *s, int c) {
   unlink(Outfilename);
   exit(1);
 }
+
+// Size of each block in a memory arena
+enum { ARENABLOCK = 65536 };
+
+// Allocate size bytes from the arena a, aligned to 8 bytes.
+// Blocks are kept when the arena is reset, so we move up
+// to the next block with room and only malloc a new block
+// when we run off the end of the list
+/* 从内存池 a 中分配 size 字节，按 8 字节对齐。内存池重置后内存块会被保留重用，
+只有在用完所有内存块时才调用 malloc 分配新的块。*/
+void *arenaalloc(struct arena *a, int size) {
+  struct arenablock *b;
+  char *p;
+
+  size = (size + 7) & ~7;
+  b = a->cur;
+  while (b != NULL && b->used + size > b->size)
+    b = b->next;
+
+  // Make a new block, big enough for this object,
+  // and put it on the end of the list
+  if (b == NULL) {
+    b = (struct arenablock *) malloc(sizeof(struct arenablock));
+    if (b == NULL)
+      fatal("Unable to malloc an arena block in arenaalloc");
+    b->size = ARENABLOCK;
+    if (size > ARENABLOCK)
+      b->size = size;
+    b->mem = (char *) malloc(b->size);
+    if (b->mem == NULL)
+      fatal("Unable to malloc an arena block in arenaalloc");
+    b->used = 0;
+    b->next = NULL;
+    if (a->tail != NULL)
+      a->tail->next = b;
+    else
+      a->head = b;
+    a->tail = b;
+  }
+
+  a->cur = b;
+  p = b->mem + b->used;
+  b->used = b->used + size;
+
+  // Keep count of the bytes in use for -ftime-report
+  Arenaused = Arenaused + size;
+  if (Arenaused > Arenapeak)
+    Arenapeak = Arenaused;
+  return ((void *) p);
+}
+
+// Copy the string s into the arena a
+char *arenastrdup(struct arena *a, char *s) {
+  char *p;
+  int i, len;
+
+  for (len = 0; s[len]; len++);
+  p = (char *) arenaalloc(a, len + 1);
+  for (i = 0; i <= len; i++)
+    p[i] = s[i];
+  return (p);
+}
+
+// Release everything allocated from the arena a.
+// The blocks are kept to be used again
+/* 释放内存池 a 中分配的所有对象，内存块留着以后再用。*/
+void arenareset(struct arena *a) {
+  struct arenablock *b;
+
+  for (b = a->head; b != NULL; b = b->next) {
+    Arenaused = Arenaused - b->used;
+    b->used = 0;
+  }
+  a->cur = a->head;
+}
@@ -5,18 +5,48 @@
 // AST Tree Optimisation Code
 // Copyright (c) 2019 Warren Toomey, GPL3
 
+// Return true if the value val fits in an A_INTLIT with the
+// type of tree n. char and int arithmetic is done in 32 bits,
+// so these values are wrapped to 32 bits by intleaf() and
+// always fit. A long value must be in the range of an int
+/*判断值 val 能否放进类型与 n 相同的整数字面值节点。char 和 int 的运算是 32 位的，
+intleaf() 会把值截断到 32 位，所以总能放下；long 的值必须在 int 的范围内。*/
+static int fitsleaf(struct ASTnode *n, long val) {
+  if (genprimsize(n->type) == 8)
+    if (val > 2147483647 || val < -2147483647)
+      return (0);
+  return (1);
+}
+
+// Make an A_INTLIT leaf with the type of tree n and the
+// value val. The value is an int, as cwj doesn't widen
+// the arguments to a call: fold1() and fold2() check
+// their long values with fitsleaf() and then cast them
+/*用 n 的类型和值 val 生成一个整数字面值叶节点。val 是 int，因为 cwj 不会把
+调用的实参扩展到形参的类型；fold1() 和 fold2() 先用 fitsleaf() 检查 long 的值再转换。*/
+static struct ASTnode *intleaf(struct ASTnode *n, int val) {
+  return (mkastleaf(A_INTLIT, n->type, NULL, NULL, val));
+}
+
 // Fold an AST tree with a binary operator
-// and two A_INTLIT children. Return either 
+// and two A_INTLIT children. Return either
 // the original tree or a new leaf node.
+// The values are worked out in 64 bits
+// and then wrapped to the width of the tree's type
 /*对常数进行运算*/
 static struct ASTnode *fold2(struct ASTnode *n) {
-  int val, leftval, rightval;
+  long val, leftval, rightval, mask;
+  int width;
 
-  // Get the values from each child
+  // Get the values from each child, and
+  // the width in bits of the operation
   leftval = n->left->a_intvalue;
   rightval = n->right->a_intvalue;
+  width = 32;
+  if (genprimsize(n->type) == 8)
+    width = 64;
 
-  // Perform some of the binary operations.
+  // Perform the binary operations.
   // For any AST op we can't do, return
   // the original tree.
   switch (n->op) {
@@ -30,25 +60,87 @@ static struct ASTnode *fold2(struct ASTnode *n) {
       val = leftval * rightval;
       break;
     case A_DIVIDE:
-      // Don't try to divide by zero.
+    case A_MOD:
+      // Don't try to divide by zero, and leave
+      // the overflow of INT_MIN / -1 to run time
       if (rightval == 0)
 	return (n);
-      val = leftval / rightval;
+      if (n->op == A_DIVIDE)
+	val = leftval / rightval;
+      else
+	val = leftval % rightval;
+      if (width == 32 && val > 2147483647)
+	return (n);
+      break;
+    case A_AND:
+      val = leftval & rightval;
+      break;
+    case A_OR:
+      val = leftval | rightval;
+      break;
+    case A_XOR:
+      val = leftval ^ rightval;
+      break;
+    case A_LSHIFT:
+    case A_RSHIFT:
+      // Leave shifts that are out of range to run time.
+      // Shifts work on the bits of the value, so make a
+      // 32-bit value positive first. Right shifts are
+      // logical, so we can't do a negative long
+      if (rightval < 0 || rightval >= width)
+	return (n);
+      if (width == 32) {
+	mask = 1;
+	mask = mask << 32;
+	mask = mask - 1;
+	leftval = leftval & mask;
+      } else if (leftval < 0 || rightval >= 32)
+	return (n);
+      if (n->op == A_LSHIFT)
+	val = leftval << rightval;
+      else
+	val = leftval >> rightval;
+      break;
+    case A_EQ:
+      val = leftval == rightval;
+      break;
+    case A_NE:
+      val = leftval != rightval;
+      break;
+    case A_LT:
+      val = leftval < rightval;
+      break;
+    case A_GT:
+      val = leftval > rightval;
+      break;
+    case A_LE:
+      val = leftval <= rightval;
+      break;
+    case A_GE:
+      val = leftval >= rightval;
+      break;
+    case A_LOGAND:
+      val = leftval && rightval;
+      break;
+    case A_LOGOR:
+      val = leftval || rightval;
       break;
     default:
       return (n);
   }
 
-  // Return a leaf node with the new value
+  // Return a leaf node with the new value, if it fits
   /*返回一个整数字面值的字符*/
-  return (mkastleaf(A_INTLIT, n->type, NULL, NULL, val));
+  if (!fitsleaf(n, val))
+    return (n);
+  return (intleaf(n, (int) val));
 }
 
 // Fold an AST tree with a unary operator
-// and one INTLIT children. Return either 
+// and one INTLIT children. Return either
 // the original tree or a new leaf node.
 static struct ASTnode *fold1(struct ASTnode *n) {
-  int val;
+  long val;
 
   // Get the child value. Do the
   // operation if recognised.
@@ -63,45 +155,1435 @@ static struct ASTnode *fold1(struct ASTnode *n) {
     case A_LOGNOT:
       val = !val;
       break;
+    case A_NEGATE:
+      val = -val;
+      break;
+    case A_TOBOOL:
+      val = val != 0;
+      break;
+    case A_SCALE:
+      // The scale factor is in the node's size
+      val = val * n->a_size;
+      break;
+    case A_CAST:
+      // Casting to a char keeps the bottom byte.
+      // Other casts leave the value as it is
+      if (n->type == P_CHAR)
+	val = val & 0xff;
+      break;
     default:
       return (n);
   }
 
-  // Return a leaf node with the new value
-  return (mkastleaf(A_INTLIT, n->type, NULL, NULL, val));
+  // Return a leaf node with the new value, if it fits
+  if (!fitsleaf(n, val))
+    return (n);
+  return (intleaf(n, (int) val));
+}
+
+// Fold a statement or expression whose condition,
+// the left child, is an A_INTLIT. Return the part
+// of the tree which will run, which can be NULL
+/*折叠条件（左子树）为常数的语句或表达式，返回会被执行的部分（可能为 NULL），
+也就是删除 if (0) 和 while (0) 这样的死代码。*/
+static struct ASTnode *foldcond(struct ASTnode *n) {
+  struct ASTnode *choice;
+  int val = n->left->a_intvalue;
+
+  switch (n->op) {
+    case A_IF:
+      // Keep only the true or the false statement
+      if (val)
+	return (n->mid);
+      return (n->right);
+    case A_WHILE:
+      // A loop which never runs goes away
+      if (val)
+	return (n);
+      return (NULL);
+    case A_TERNARY:
+      // Choose one expression, as long as
+      // it has the same type as the ternary
+      if (val)
+	choice = n->mid;
+      else
+	choice = n->right;
+      if (choice->type == n->type)
+	return (choice);
+      return (n);
+    case A_LOGAND:
+      // 0 && x is 0, without evaluating x
+      if (val == 0)
+	return (intleaf(n, 0));
+      if (n->right->op == A_INTLIT)
+	return (fold2(n));
+      return (n);
+    case A_LOGOR:
+      // 1 || x is 1, without evaluating x
+      if (val)
+	return (intleaf(n, 1));
+      if (n->right->op == A_INTLIT)
+	return (fold2(n));
+      return (n);
+  }
+  return (n);
+}
+
+// Return true if evaluating the tree has no side effects,
+// i.e. it has no assignments, calls, or increments
+static int noeffects(struct ASTnode *n) {
+  if (n == NULL)
+    return (1);
+  switch (n->op) {
+    case A_ASSIGN:
+    case A_ASPLUS:
+    case A_ASMINUS:
+    case A_ASSTAR:
+    case A_ASSLASH:
+    case A_ASMOD:
+    case A_FUNCCALL:
+    case A_PREINC:
+    case A_PREDEC:
+    case A_POSTINC:
+    case A_POSTDEC:
+      return (0);
+  }
+  if (noeffects(n->left) && noeffects(n->mid))
+    return (noeffects(n->right));
+  return (0);
+}
+
+// Return true if the value of the tree is known to be
+// positive or zero: a char loaded from memory or widened
+// to a bigger type. Arithmetic on chars is done in 32 bits
+// and can go negative, so it doesn't count
+static int nonnegative(struct ASTnode *n) {
+  if (n->op == A_WIDEN && n->left->type == P_CHAR)
+    return (1);
+  if (n->type == P_CHAR && (n->op == A_IDENT || n->op == A_DEREF))
+    return (1);
+  return (0);
+}
+
+// If val is a power of two 2^k with k > 0,
+// return k. Otherwise return -1
+static int powerof2(int val) {
+  int k;
+
+  for (k = 1; k < 31; k++)
+    if (val == 1 << k)
+      return (k);
+  return (-1);
+}
+
+// Simplify a binary operation with one A_INTLIT child using
+// the algebraic identities: x+0, x-0, x|0, x^0, x<<0, x>>0,
+// x*1 and x/1 are x; x*0, x&0 and x%1 are 0 when x has no
+// side effects; x*2^k is x<<k; and when x can't be negative,
+// x/2^k is x>>k and x%2^k is x&(2^k-1). Return the new tree
+/*用代数恒等式化简有一个常数子树的二元运算，返回新的树。*/
+static struct ASTnode *simplify(struct ASTnode *n) {
+  struct ASTnode *x;
+  int val, k;
+
+  if (n->left == NULL || n->right == NULL)
+    return (n);
+
+  // Find the literal and the other tree, x. The literal
+  // can be on the left only if the operation is commutative
+  if (n->right->op == A_INTLIT) {
+    x = n->left;
+    val = n->right->a_intvalue;
+  } else if (n->left->op == A_INTLIT) {
+    switch (n->op) {
+      case A_ADD:
+      case A_MULTIPLY:
+      case A_AND:
+      case A_OR:
+      case A_XOR:
+	break;
+      default:
+	return (n);
+    }
+    x = n->right;
+    val = n->left->a_intvalue;
+  } else
+    return (n);
+
+  // x must have the type of the whole tree if
+  // it's going to replace it, or be its left child
+  if (x->type != n->type)
+    return (n);
+
+  switch (n->op) {
+    case A_ADD:
+    case A_SUBTRACT:
+    case A_OR:
+    case A_XOR:
+    case A_LSHIFT:
+    case A_RSHIFT:
+      if (val == 0)
+	return (x);
+      break;
+    case A_MULTIPLY:
+      if (val == 1)
+	return (x);
+      if (val == 0 && noeffects(x))
+	return (intleaf(n, 0));
+      k = powerof2(val);
+      if (k > 0) {
+	n->op = A_LSHIFT;
+	n->left = x;
+	n->right = mkastleaf(A_INTLIT, n->type, NULL, NULL, k);
+      }
+      break;
+    case A_DIVIDE:
+      if (val == 1)
+	return (x);
+      k = powerof2(val);
+      if (k > 0 && nonnegative(x)) {
+	n->op = A_RSHIFT;
+	n->right = mkastleaf(A_INTLIT, n->type, NULL, NULL, k);
+      }
+      break;
+    case A_MOD:
+      if (val == 1 && noeffects(x))
+	return (intleaf(n, 0));
+      k = powerof2(val);
+      if (k > 0 && nonnegative(x)) {
+	n->op = A_AND;
+	n->right = mkastleaf(A_INTLIT, n->type, NULL, NULL, val - 1);
+      }
+      break;
+    case A_AND:
+      if (val == -1)
+	return (x);
+      if (val == 0 && noeffects(x))
+	return (intleaf(n, 0));
+      break;
+  }
+  return (n);
+}
+
+// If the tree calls strlen() on a string literal,
+// return a leaf with the string's length.
+// Otherwise return the tree unchanged
+/*对字符串字面量调用 strlen() 时，返回字符串长度的叶节点，否则原样返回。*/
+static struct ASTnode *foldstrlen(struct ASTnode *n) {
+  int len;
+
+  if (strcmp(n->sym->name, "strlen") != 0 || n->left == NULL)
+    return (n);
+  if (n->left->a_size != 1 || n->left->right->op != A_STRLIT)
+    return (n);
+  len = genstrlen(n->left->right->a_intvalue);
+  if (len == -1)
+    return (n);
+  return (intleaf(n, len));
 }
 
 // Attempt to do constant folding on
 // the AST tree with the root node n
 /* 这是一个递归函数，它对给定的 AST 树进行常量折叠。首先，它检查节点是否为 NULL，如果是，则直接返回。
-然后，它递归地对左子树和右子树调用自身。最后，如果左子树和右子树都是整数字面量（A_INTLIT），则调用 fold2 或 fold1 进行折叠。*/
+然后，它递归地对三棵子树调用自身。条件为常数的语句和表达式交给 foldcond，
+两个子树都是整数字面量（A_INTLIT）时调用 fold2，一元运算调用 fold1，其余的用代数恒等式化简。*/
 static struct ASTnode *fold(struct ASTnode *n) {
 
   if (n == NULL)
     return (NULL);
 
   // Fold on the left child, then
-  // do the same on the right child
+  // do the same on the middle and right children
   n->left = fold(n->left);
+  n->mid = fold(n->mid);
   n->right = fold(n->right);
 
+  // Remove the code that a constant condition skips
+  switch (n->op) {
+    case A_IF:
+    case A_WHILE:
+    case A_TERNARY:
+    case A_LOGAND:
+    case A_LOGOR:
+      if (n->left->op == A_INTLIT)
+	return (foldcond(n));
+      return (n);
+  }
+  if (n->op == A_FUNCCALL)
+    n = foldstrlen(n);
+
   // If both children are A_INTLITs, do a fold2()
   if (n->left && n->left->op == A_INTLIT) {
     if (n->right && n->right->op == A_INTLIT)
-      n = fold2(n);
-    else
-      // If only the left is A_INTLIT, do a fold1()
-      n = fold1(n);
+      return (fold2(n));
+    // If there is only a left A_INTLIT child, do a fold1()
+    if (n->right == NULL)
+      return (fold1(n));
+  }
+
+  // Otherwise try the algebraic identities
+  return (simplify(n));
+}
+
+// Inlining of small static functions. When a static function
+// whose body is a single "return expr;" has been parsed, a copy
+// of expr is kept. Calls to the function in later functions are
+// replaced by a copy of expr, where each parameter is replaced
+// by its argument. An argument which is not a literal or a local
+// variable is first assigned to a new local variable, so that it
+// is evaluated once and in the usual order
+/*小的 static 函数的内联。函数体只有一条 "return expr;" 的 static 函数解析完后，保存 expr 的一份拷贝。
+之后的函数中对它的调用被替换成 expr 的拷贝，其中的参数换成实参。
+不是字面值或局部变量的实参先赋给一个新的局部变量，保证它只按原来的顺序求值一次。*/
+
+static struct arena Inlarena;	// Holds the kept trees
+static struct ASTnode *Inlhead;	// List of kept functions, linked by mid
+static int Inlvars;		// Number of locals made for arguments
+
+// Return the number of nodes in a tree
+static int treesize(struct ASTnode *n) {
+  int size;
+
+  if (n == NULL)
+    return (0);
+  size = treesize(n->left) + treesize(n->mid);
+  size = size + treesize(n->right);
+  return (size + 1);
+}
+
+// Return true if a function's return expression can be
+// inlined: it uses no local variables, and its parameters
+// are only read. parentop is the operation of n's parent
+static int inlinable(struct ASTnode *n, int parentop) {
+  if (n == NULL)
+    return (1);
+  if (n->sym != NULL) {
+    if (n->sym->class == C_LOCAL)
+      return (0);
+    if (n->sym->class == C_PARAM) {
+      if (n->op != A_IDENT)
+	return (0);
+      if (n->rvalue == 0 && parentop != A_DEREF)
+	return (0);
+    }
+  }
+  if (!inlinable(n->left, n->op) || !inlinable(n->mid, n->op))
+    return (0);
+  return (inlinable(n->right, n->op));
+}
+
+// Copy a tree into the inline arena
+static struct ASTnode *keeptree(struct ASTnode *n) {
+  struct ASTnode *k;
+
+  if (n == NULL)
+    return (NULL);
+  k = (struct ASTnode *) arenaalloc(&Inlarena, sizeof(struct ASTnode));
+  k->op = n->op;
+  k->type = n->type;
+  k->ctype = n->ctype;
+  k->rvalue = n->rvalue;
+  k->left = keeptree(n->left);
+  k->mid = keeptree(n->mid);
+  k->right = keeptree(n->right);
+  k->sym = n->sym;
+  k->a_intvalue = n->a_intvalue;
+  k->linenum = n->linenum;
+  return (k);
+}
+
+// Given an A_FUNCTION tree, keep a copy of the return
+// expression if the function can be inlined
+static void keepinline(struct ASTnode *n) {
+  struct ASTnode *body, *k;
+  struct symtable *parm;
+
+  // It must be a static function with a single return statement
+  if (n->sym->class != C_STATIC)
+    return;
+  body = n->left;
+  if (body != NULL && body->op == A_GLUE && body->left == NULL)
+    body = body->right;
+  if (body == NULL || body->op != A_RETURN)
+    return;
+  if (body->left->type != n->sym->type)
+    return;
+
+  // The expression must be small enough
+  if (treesize(body->left) > O_inlinelimit)
+    return;
+
+  // The parameters must be scalars whose address isn't taken
+  for (parm = n->sym->member; parm != NULL; parm = parm->next) {
+    if (parm->st_hasaddr)
+      return;
+    if (!inttype(parm->type) && !ptrtype(parm->type))
+      return;
+  }
+  if (!inlinable(body->left, A_RETURN))
+    return;
+
+  // Keep the function and its expression
+  k = (struct ASTnode *) arenaalloc(&Inlarena, sizeof(struct ASTnode));
+  k->op = A_FUNCTION;
+  k->sym = n->sym;
+  k->left = keeptree(body->left);
+  k->mid = Inlhead;
+  Inlhead = k;
+}
+
+// Forget the kept functions at the end of an input file
+void freeinline(void) {
+  Inlhead = NULL;
+  arenareset(&Inlarena);
+}
+
+// Copy a kept expression into the AST arena. reps is a list of
+// A_GLUE nodes: each one has a parameter's symbol, and the tree
+// which replaces that parameter as its right child
+static struct ASTnode *substitute(struct ASTnode *n, struct ASTnode *reps) {
+  struct ASTnode *left, *mid, *right;
+
+  if (n == NULL)
+    return (NULL);
+
+  // Replace a parameter with a copy of its tree.
+  // With no list, this is a plain copy
+  if (reps != NULL && n->op == A_IDENT && n->sym->class == C_PARAM) {
+    for (left = reps; left != NULL; left = left->left)
+      if (left->sym == n->sym)
+	return (substitute(left->right, NULL));
+    fatals("Unknown parameter in inlined function", n->sym->name);
+  }
+
+  left = substitute(n->left, reps);
+  mid = substitute(n->mid, reps);
+  right = substitute(n->right, reps);
+  left = mkastnode(n->op, n->type, n->ctype, left, mid, right, n->sym,
+		   n->a_intvalue);
+  left->rvalue = n->rvalue;
+  left->linenum = n->linenum;
+  return (left);
+}
+
+// Return true if an argument can be used directly in place
+// of its parameter: a literal or a local variable, possibly
+// widened. These have no side effects, and the inlined
+// expression can't change them
+static int trivialarg(struct ASTnode *n) {
+  if (n->op == A_WIDEN)
+    n = n->left;
+  if (n->op == A_INTLIT)
+    return (1);
+  if (n->op != A_IDENT || n->sym->stype != S_VARIABLE)
+    return (0);
+  if (n->sym->class != C_LOCAL && n->sym->class != C_PARAM)
+    return (0);
+  return (n->sym->st_hasaddr == 0);
+}
+
+// Replace a function call with the kept expression
+// of the function, if there is one
+static struct ASTnode *inlinecall(struct ASTnode *n) {
+  struct ASTnode *k, *glue, *arg, *rep, *lval;
+  struct ASTnode *reps = NULL, *binds = NULL;
+  struct symtable *parm, *local;
+  char name[20];
+  int i;
+
+  // Find the function and check the number of arguments
+  for (k = Inlhead; k != NULL; k = k->mid)
+    if (k->sym == n->sym)
+      break;
+  if (k == NULL)
+    return (n);
+  i = 0;
+  for (glue = n->left; glue != NULL; glue = glue->left)
+    i++;
+  if (i != n->sym->nelems)
+    return (n);
+
+  // Convert each argument to its parameter's type
+  for (glue = n->left; glue != NULL; glue = glue->left) {
+    parm = n->sym->member;
+    for (i = 1; i < glue->a_size; i++)
+      parm = parm->next;
+    if (!inttype(glue->right->type) && !ptrtype(glue->right->type))
+      return (n);
+    arg = modify_type(glue->right, parm->type, parm->ctype, 0);
+    if (arg == NULL)
+      return (n);
+    glue->right = arg;
+  }
+
+  // Work out what replaces each parameter. The arguments
+  // are in the list from last to first, which is the
+  // order in which they are evaluated
+  for (glue = n->left; glue != NULL; glue = glue->left) {
+    parm = n->sym->member;
+    for (i = 1; i < glue->a_size; i++)
+      parm = parm->next;
+    arg = glue->right;
+    if (trivialarg(arg))
+      rep = arg;
+    else {
+      // Assign the argument to a new local variable
+      sprintf(name, ".i%d", Inlvars++);
+      local = addlocl(name, parm->type, parm->ctype, S_VARIABLE, 1);
+      rep = mkastleaf(A_IDENT, parm->type, parm->ctype, local, 0);
+      rep->rvalue = 1;
+      lval = mkastleaf(A_IDENT, parm->type, parm->ctype, local, 0);
+      arg = mkastnode(A_ASSIGN, parm->type, parm->ctype, arg, NULL, lval,
+		      NULL, 0);
+      if (binds == NULL)
+	binds = arg;
+      else
+	binds = mkastnode(A_GLUE, P_NONE, NULL, binds, NULL, arg, NULL, 0);
+    }
+    reps = mkastnode(A_GLUE, P_NONE, NULL, reps, NULL, rep, parm, 0);
+  }
+
+  // Copy the expression. If there are assignments, do them
+  // first and use a glue with a type to give the value
+  k = substitute(k->left, reps);
+  if (binds != NULL)
+    k = mkastnode(A_GLUE, n->type, n->ctype, binds, NULL, k, NULL, 0);
+  return (k);
+}
+
+// Inline the calls in an AST tree. The calls in an
+// argument list are done before the call itself. The
+// copied expressions don't need to be done again, as
+// they were done before the function was kept
+static struct ASTnode *inlinetree(struct ASTnode *n) {
+  if (n == NULL)
+    return (NULL);
+  n->left = inlinetree(n->left);
+  n->mid = inlinetree(n->mid);
+  n->right = inlinetree(n->right);
+  if (n->op == A_FUNCCALL)
+    return (inlinecall(n));
+  return (n);
+}
+
+// Loop optimisation. The A_WHILE loops in a function are done
+// from the innermost out. First, pure expressions whose value
+// can't change in the loop are worked out once before the loop,
+// into new local variables. Then, for each local variable i which
+// the loop changes in one top-level statement by a constant step,
+// each address base + (i * k + c) * size, where base, k and c
+// don't change in the loop, becomes a pointer which is set before
+// the loop and stepped along with i
+/*循环优化。函数中的 A_WHILE 循环从最内层向外处理。先把循环中值不会变的纯表达式
+移到循环前面计算一次，存进新的局部变量。然后对于循环只在一条顶层语句中按常数步长改变的
+局部变量 i，把每个 base + (i * k + c) * size 形式的地址（base、k 和 c 在循环中不变）
+换成一个指针：在循环前设置好，并和 i 一起步进。*/
+
+static int Loopvars;		// Number of locals made for loops
+static struct ASTnode *Preloop;	// Code to run before the loop
+
+// The induction variable being done, its step, the
+// list of addresses made into pointers, and the code
+// to step them
+static struct symtable *Ivvar;
+static int Ivstep;
+static struct ASTnode *Ivaddrs;
+static struct ASTnode *Ivincs;
+static struct ASTnode *Coef;	// Coefficient of Ivvar found by linear()
+
+// Return true if the symbol is a local variable or
+// parameter which lives in a temporary
+static int tempvar(struct symtable *sym) {
+  if (sym->class != C_LOCAL && sym->class != C_PARAM)
+    return (0);
+  if (sym->stype != S_VARIABLE)
+    return (0);
+  return (sym->st_hasaddr == 0);
+}
+
+// Return the number of places in the tree which change sym
+static int writes(struct ASTnode *n, struct symtable *sym) {
+  int count = 0;
+
+  if (n == NULL)
+    return (0);
+  switch (n->op) {
+    case A_IDENT:
+      if (n->sym == sym && n->rvalue == 0)
+	count = 1;
+      break;
+    case A_POSTINC:
+    case A_POSTDEC:
+    case A_ADDR:
+      if (n->sym == sym)
+	count = 1;
+      break;
+    case A_ASPLUS:
+    case A_ASMINUS:
+    case A_ASSTAR:
+    case A_ASSLASH:
+    case A_ASMOD:
+      // The left child is the variable, as an rvalue
+      if (n->left->op == A_IDENT && n->left->sym == sym)
+	count = 1;
+      break;
+  }
+  count = count + writes(n->left, sym);
+  count = count + writes(n->mid, sym);
+  return (count + writes(n->right, sym));
+}
+
+// Return true if the tree is a pure computation
+// whose value can't change in the loop
+static int invariant(struct ASTnode *n, struct ASTnode *loop) {
+  if (n == NULL)
+    return (1);
+  switch (n->op) {
+    case A_INTLIT:
+    case A_STRLIT:
+      return (1);
+    case A_ADDR:
+      if (n->sym != NULL)
+	return (1);
+      break;
+    case A_IDENT:
+      if (n->rvalue == 0 || !tempvar(n->sym))
+	return (0);
+      return (writes(loop, n->sym) == 0);
+    case A_ADD:
+    case A_SUBTRACT:
+    case A_MULTIPLY:
+    case A_AND:
+    case A_OR:
+    case A_XOR:
+    case A_LSHIFT:
+    case A_RSHIFT:
+    case A_WIDEN:
+    case A_SCALE:
+    case A_NEGATE:
+    case A_INVERT:
+    case A_CAST:
+      break;
+    default:
+      // Division can trap, so it stays where it is
+      return (0);
   }
-  // Return the possibly modified tree
+  if (!invariant(n->left, loop))
+    return (0);
+  return (invariant(n->right, loop));
+}
+
+// Make a new local variable for a loop
+// or a common subexpression
+static struct symtable *loopvar(int type, struct symtable *ctype) {
+  char name[20];
+
+  sprintf(name, ".l%d", Loopvars++);
+  return (addlocl(name, type, ctype, S_VARIABLE, 1));
+}
+
+// Make an A_IDENT leaf for a variable
+static struct ASTnode *varleaf(struct symtable *var, int rvalue) {
+  struct ASTnode *n;
+
+  n = mkastleaf(A_IDENT, var->type, var->ctype, var, 0);
+  n->rvalue = rvalue;
   return (n);
 }
 
-// Optimise an AST tree by
-// constant folding in all sub-trees
+// Return an assignment of tree n to a variable
+static struct ASTnode *assignvar(struct ASTnode *n, struct symtable *var) {
+  return (mkastnode(A_ASSIGN, var->type, var->ctype, n, NULL,
+		    varleaf(var, 0), NULL, 0));
+}
+
+// Add a statement to the list of code in s
+static struct ASTnode *addstmt(struct ASTnode *s, struct ASTnode *n) {
+  if (s == NULL)
+    return (n);
+  return (mkastnode(A_GLUE, P_NONE, NULL, s, NULL, n, NULL, 0));
+}
+
+// Replace each invariant expression in the tree with a new
+// variable, which is set before the loop. Nested loops
+// have already had their invariants moved out
+static struct ASTnode *hoist(struct ASTnode *n, struct ASTnode *loop) {
+  struct symtable *var;
+
+  if (n == NULL || n->op == A_WHILE)
+    return (n);
+
+  // Only move an operation, not a leaf
+  if (n->left != NULL && (inttype(n->type) || ptrtype(n->type)) &&
+      invariant(n, loop)) {
+    var = loopvar(n->type, n->ctype);
+    Preloop = addstmt(Preloop, assignvar(n, var));
+    return (varleaf(var, 1));
+  }
+  n->left = hoist(n->left, loop);
+  n->mid = hoist(n->mid, loop);
+  n->right = hoist(n->right, loop);
+  return (n);
+}
+
+// Return true if the two trees are the same
+static int sametree(struct ASTnode *a, struct ASTnode *b) {
+  if (a == NULL || b == NULL)
+    return (a == b);
+  if (a->op != b->op || a->type != b->type || a->sym != b->sym)
+    return (0);
+  if (a->a_intvalue != b->a_intvalue || a->rvalue != b->rvalue)
+    return (0);
+  if (!sametree(a->left, b->left) || !sametree(a->mid, b->mid))
+    return (0);
+  return (sametree(a->right, b->right));
+}
+
+// Multiply the coefficient by tree n
+static void scalecoef(struct ASTnode *n) {
+  if (Coef->op == A_INTLIT && Coef->a_intvalue == 1)
+    Coef = n;
+  else if (Coef->op == A_INTLIT && n->op == A_INTLIT)
+    Coef = mkastleaf(A_INTLIT, Coef->type, NULL, NULL,
+		     Coef->a_intvalue * n->a_intvalue);
+  else
+    Coef = mkastnode(A_MULTIPLY, n->type, NULL, Coef, NULL, n, NULL, 0);
+}
+
+// Return true if the tree is i * k + c for the induction
+// variable i, where k and c don't change in the loop.
+// Set Coef to k
+static int linear(struct ASTnode *n, struct ASTnode *loop) {
+  switch (n->op) {
+    case A_IDENT:
+      if (n->sym != Ivvar)
+	return (0);
+      Coef = mkastleaf(A_INTLIT, n->type, NULL, NULL, 1);
+      return (1);
+    case A_WIDEN:
+      return (linear(n->left, loop));
+    case A_ADD:
+      if (invariant(n->right, loop))
+	return (linear(n->left, loop));
+      if (invariant(n->left, loop))
+	return (linear(n->right, loop));
+      return (0);
+    case A_SUBTRACT:
+      if (invariant(n->right, loop))
+	return (linear(n->left, loop));
+      return (0);
+    case A_MULTIPLY:
+      if (invariant(n->right, loop) && linear(n->left, loop)) {
+	scalecoef(n->right);
+	return (1);
+      }
+      if (invariant(n->left, loop) && linear(n->right, loop)) {
+	scalecoef(n->left);
+	return (1);
+      }
+      return (0);
+    case A_LSHIFT:
+      if (n->right->op != A_INTLIT)
+	return (0);
+      if (n->right->a_intvalue < 0 || n->right->a_intvalue > 30)
+	return (0);
+      if (!linear(n->left, loop))
+	return (0);
+      scalecoef(mkastleaf(A_INTLIT, n->type, NULL, NULL,
+			  1 << n->right->a_intvalue));
+      return (1);
+  }
+  return (0);
+}
+
+// If the tree is an address base + (i * k + c) * size,
+// replace it with a pointer which steps along with
+// the induction variable i. Return the pointer or NULL
+static struct symtable *ivpointer(struct ASTnode *n, struct ASTnode *loop) {
+  struct ASTnode *base, *idx, *a, *step;
+  struct symtable *ptr, *var;
+  int size;
+
+  // Find the base and the scaled index. An index
+  // into chars is only widened
+  if (n->right->op == A_SCALE || n->right->op == A_WIDEN) {
+    base = n->left;
+    idx = n->right;
+  } else if (n->left->op == A_SCALE || n->left->op == A_WIDEN) {
+    base = n->right;
+    idx = n->left;
+  } else
+    return (NULL);
+  size = 1;
+  if (idx->op == A_SCALE)
+    size = idx->a_size;
+  idx = idx->left;
+  if (!inttype(idx->type) || !invariant(base, loop) || !linear(idx, loop))
+    return (NULL);
+
+  // Use the same pointer for the same address
+  for (a = Ivaddrs; a != NULL; a = a->left)
+    if (sametree(a->right, n))
+      return (a->sym);
+
+  // Work out the step of the pointer in bytes. A
+  // step which isn't a constant is set before the loop
+  size = size * Ivstep;
+  if (Coef->op == A_INTLIT)
+    step = mkastleaf(A_INTLIT, P_LONG, NULL, NULL, Coef->a_intvalue * size);
+  else {
+    step = substitute(Coef, NULL);
+    if (step->type != P_LONG)
+      step = mkastunary(A_WIDEN, P_LONG, NULL, step, NULL, 0);
+    step = mkastnode(A_MULTIPLY, P_LONG, NULL, step, NULL,
+		     mkastleaf(A_INTLIT, P_LONG, NULL, NULL, size), NULL, 0);
+    var = loopvar(P_LONG, NULL);
+    Preloop = addstmt(Preloop, assignvar(simplify(step), var));
+    step = varleaf(var, 1);
+  }
+
+  // Set the pointer before the loop, and step it
+  ptr = loopvar(n->type, n->ctype);
+  Preloop = addstmt(Preloop, assignvar(n, ptr));
+  step = mkastnode(A_ADD, n->type, n->ctype, varleaf(ptr, 1), NULL, step,
+		   NULL, 0);
+  Ivincs = addstmt(Ivincs, assignvar(step, ptr));
+  Ivaddrs = mkastnode(A_GLUE, P_NONE, NULL, Ivaddrs, NULL, n, ptr, 0);
+  return (ptr);
+}
+
+// Replace the addresses in the tree which
+// step along with the induction variable
+static struct ASTnode *reduce(struct ASTnode *n, struct ASTnode *loop) {
+  struct symtable *ptr;
+
+  if (n == NULL)
+    return (NULL);
+  if (n->op == A_ADD && ptrtype(n->type)) {
+    ptr = ivpointer(n, loop);
+    if (ptr != NULL)
+      return (varleaf(ptr, 1));
+  }
+  n->left = reduce(n->left, loop);
+  n->mid = reduce(n->mid, loop);
+  n->right = reduce(n->right, loop);
+  return (n);
+}
+
+// Do the strength reduction for the induction variable
+// var, which the statement stmt steps by step
+static void strength(struct ASTnode *stmt, struct symtable *var, int step,
+		     struct ASTnode *loop) {
+  struct ASTnode *n;
+
+  Ivvar = var;
+  Ivstep = step;
+  Ivaddrs = NULL;
+  Ivincs = NULL;
+  loop->left = reduce(loop->left, loop);
+  loop->right = reduce(loop->right, loop);
+  if (Ivincs == NULL)
+    return;
+
+  // Step the pointers after the statement
+  // by making it into a glue of the two
+  n = mkastnode(stmt->op, stmt->type, stmt->ctype, stmt->left, stmt->mid,
+		stmt->right, stmt->sym, stmt->a_intvalue);
+  n->rvalue = stmt->rvalue;
+  n->linenum = stmt->linenum;
+  stmt->op = A_GLUE;
+  stmt->type = P_NONE;
+  stmt->ctype = NULL;
+  stmt->left = n;
+  stmt->mid = NULL;
+  stmt->right = Ivincs;
+  stmt->sym = NULL;
+  stmt->a_intvalue = 0;
+  stmt->rvalue = 0;
+}
+
+// Find the top-level statements in a loop body which
+// step a local int or long variable by a constant,
+// and strength reduce the loop for each variable
+static void findivs(struct ASTnode *n, struct ASTnode *loop) {
+  struct symtable *var = NULL;
+  struct ASTnode *val;
+  int step = 0;
+
+  if (n == NULL)
+    return;
+  switch (n->op) {
+    case A_GLUE:
+      if (n->type == P_NONE) {
+	findivs(n->left, loop);
+	findivs(n->right, loop);
+      }
+      return;
+    case A_POSTINC:
+      var = n->sym;
+      step = 1;
+      break;
+    case A_POSTDEC:
+      var = n->sym;
+      step = -1;
+      break;
+    case A_PREINC:
+      var = n->left->sym;
+      step = 1;
+      break;
+    case A_PREDEC:
+      var = n->left->sym;
+      step = -1;
+      break;
+    case A_ASPLUS:
+    case A_ASMINUS:
+      // var += c or var -= c
+      if (n->left->op != A_IDENT || n->right->op != A_INTLIT)
+	return;
+      var = n->left->sym;
+      step = n->right->a_intvalue;
+      if (n->op == A_ASMINUS)
+	step = -step;
+      break;
+    case A_ASSIGN:
+      // var = var + c or var = var - c
+      val = n->left;
+      if (n->right->op != A_IDENT)
+	return;
+      if (val->op != A_ADD && val->op != A_SUBTRACT)
+	return;
+      if (val->right->op != A_INTLIT || val->left->op != A_IDENT ||
+	  val->left->sym != n->right->sym)
+	return;
+      var = n->right->sym;
+      step = val->right->a_intvalue;
+      if (val->op == A_SUBTRACT)
+	step = -step;
+      break;
+    default:
+      return;
+  }
+  if (!tempvar(var) || (var->type != P_INT && var->type != P_LONG))
+    return;
+  if (writes(loop, var) != 1)
+    return;
+  strength(n, var, step, loop);
+}
+
+// Return true if the tree has a continue for this loop
+static int continues(struct ASTnode *n) {
+  if (n == NULL || n->op == A_WHILE)
+    return (0);
+  if (n->op == A_CONTINUE)
+    return (1);
+  if (continues(n->left) || continues(n->mid))
+    return (1);
+  return (continues(n->right));
+}
+
+// Optimise an A_WHILE loop. Return the loop,
+// glued after any code to run before it
+static struct ASTnode *optloop(struct ASTnode *n) {
+  Preloop = NULL;
+  n->left = hoist(n->left, n);
+  n->right = hoist(n->right, n);
+
+  // A continue would skip the statement which steps
+  // an induction variable, and not the pointers'
+  if (!continues(n->right))
+    findivs(n->right, n);
+  if (Preloop == NULL)
+    return (n);
+  return (mkastnode(A_GLUE, P_NONE, NULL, Preloop, NULL, n, NULL, 0));
+}
+
+// Optimise the loops in a tree, innermost first
+static struct ASTnode *loops(struct ASTnode *n) {
+  if (n == NULL)
+    return (NULL);
+  n->left = loops(n->left);
+  n->mid = loops(n->mid);
+  n->right = loops(n->right);
+  if (n->op == A_WHILE)
+    return (optloop(n));
+  return (n);
+}
+
+// Local common subexpression elimination. The simple
+// statements which follow each other, with no if, while or
+// switch between them, are taken as a run. A pure expression
+// which is worked out more than once in the run is saved in a
+// new variable where it is first worked out, and the variable
+// is used in the other places, up to the first statement which
+// changes a variable in the expression. Loads from memory are
+// shared up to the first statement which stores through a
+// pointer or calls a function
+/*局部公共子表达式消除。中间没有 if、while 或 switch 的连续简单语句作为一串处理。
+在这一串语句中被计算了不止一次的纯表达式，在第一次计算时存进一个新的变量，其他地方改用这个
+变量，直到某条语句改变了表达式中的变量为止。从内存读出的值可以共享到某条语句通过指针写内存
+或者调用函数为止。*/
+
+enum { RUNMAX = 32 };
+static struct ASTnode *Runstmt[RUNMAX];	// The run of statements
+static int Nrun;
+
+static struct ASTnode *Cstmt;	// The statement being done
+static int Memok;		// True if memory can't change in it
+static int Cfirst;		// True until the first place is replaced
+
+// Return true if the tree might store to
+// memory, i.e. not just to a temporary
+static int stores(struct ASTnode *n) {
+  if (n == NULL)
+    return (0);
+  switch (n->op) {
+    case A_FUNCCALL:
+      return (1);
+    case A_ASSIGN:
+      if (n->right->op != A_IDENT || !tempvar(n->right->sym))
+	return (1);
+      break;
+    case A_ASPLUS:
+    case A_ASMINUS:
+    case A_ASSTAR:
+    case A_ASSLASH:
+    case A_ASMOD:
+      if (n->left->op != A_IDENT || !tempvar(n->left->sym))
+	return (1);
+      break;
+    case A_POSTINC:
+    case A_POSTDEC:
+      if (n->sym == NULL || !tempvar(n->sym))
+	return (1);
+      break;
+    case A_PREINC:
+    case A_PREDEC:
+      if (n->left->sym == NULL || !tempvar(n->left->sym))
+	return (1);
+      break;
+  }
+  if (stores(n->left) || stores(n->mid))
+    return (1);
+  return (stores(n->right));
+}
+
+// Return true if the tree has no side effects
+// and its value can't change in the statement
+static int pure(struct ASTnode *n) {
+  if (n == NULL)
+    return (1);
+  switch (n->op) {
+    case A_INTLIT:
+    case A_STRLIT:
+      return (1);
+    case A_ADDR:
+      if (n->sym != NULL)
+	return (1);
+      break;
+    case A_IDENT:
+      if (n->rvalue == 0)
+	return (0);
+      if (tempvar(n->sym))
+	return (writes(Cstmt, n->sym) == 0);
+      return (Memok);
+    case A_DEREF:
+      if (n->rvalue == 0 || Memok == 0)
+	return (0);
+      break;
+    case A_ADD:
+    case A_SUBTRACT:
+    case A_MULTIPLY:
+    case A_AND:
+    case A_OR:
+    case A_XOR:
+    case A_LSHIFT:
+    case A_RSHIFT:
+    case A_WIDEN:
+    case A_SCALE:
+    case A_NEGATE:
+    case A_INVERT:
+    case A_CAST:
+      break;
+    default:
+      return (0);
+  }
+  if (!pure(n->left))
+    return (0);
+  return (pure(n->right));
+}
+
+// Return true if the children of the tree are always
+// worked out in order, left before mid before right.
+// Function arguments and the parts of &&, || and ?:
+// are not looked at
+static int inorder(struct ASTnode *n) {
+  switch (n->op) {
+    case A_FUNCCALL:
+    case A_TERNARY:
+    case A_LOGOR:
+    case A_LOGAND:
+      return (0);
+  }
+  return (1);
+}
+
+// Count the places in tree n where tree e is worked out
+static int occurs(struct ASTnode *n, struct ASTnode *e) {
+  int count;
+
+  if (n == NULL)
+    return (0);
+  if (sametree(n, e))
+    return (1);
+  if (!inorder(n))
+    return (0);
+  count = occurs(n->left, e) + occurs(n->mid, e);
+  return (count + occurs(n->right, e));
+}
+
+// Replace each place in tree n where tree e is worked out
+// with the variable var. The first place also sets var
+static struct ASTnode *replace(struct ASTnode *n, struct ASTnode *e,
+			       struct symtable *var) {
+  if (n == NULL)
+    return (NULL);
+  if (sametree(n, e)) {
+    if (Cfirst) {
+      Cfirst = 0;
+      return (assignvar(n, var));
+    }
+    return (varleaf(var, 1));
+  }
+  if (!inorder(n))
+    return (n);
+  n->left = replace(n->left, e, var);
+  n->mid = replace(n->mid, e, var);
+  n->right = replace(n->right, e, var);
+  return (n);
+}
+
+// Return true if statement s changes the value of tree e
+static int killed(struct ASTnode *e, struct ASTnode *s) {
+  if (e == NULL)
+    return (0);
+  if (e->op == A_IDENT) {
+    if (tempvar(e->sym))
+      return (writes(s, e->sym) != 0);
+    return (stores(s));
+  }
+  if (e->op == A_DEREF && stores(s))
+    return (1);
+  if (killed(e->left, s))
+    return (1);
+  return (killed(e->right, s));
+}
+
+// Look for common subexpressions in tree n, which is part of
+// statement k of the run. Try the biggest ones first. A lone
+// operation on two leaves isn't worth a variable unless it
+// loads from memory
+static void cse(struct ASTnode *n, int k) {
+  struct symtable *var;
+  int i, last, count;
+
+  if (n == NULL)
+    return;
+  if (n->left != NULL && (inttype(n->type) || ptrtype(n->type)) &&
+      (n->op == A_DEREF || treesize(n) > 3) && pure(n)) {
+
+    // Find the last statement where n has the same value
+    // and count the places where it is worked out
+    last = k;
+    while (last + 1 < Nrun && !killed(n, Runstmt[last + 1]))
+      last++;
+    count = 0;
+    for (i = k; i <= last; i++)
+      count = count + occurs(Runstmt[i], n);
+
+    // Replace them with a new variable
+    if (count > 1) {
+      var = loopvar(n->type, n->ctype);
+      Cfirst = 1;
+      for (i = k; i <= last; i++)
+	Runstmt[i] = replace(Runstmt[i], n, var);
+      return;
+    }
+  }
+  if (!inorder(n))
+    return;
+  cse(n->left, k);
+  cse(n->mid, k);
+  cse(n->right, k);
+}
+
+// Look for common subexpressions in the run
+static void cserun(void) {
+  int k;
+
+  for (k = 0; k < Nrun; k++) {
+    Cstmt = Runstmt[k];
+    Memok = !stores(Cstmt);
+    cse(Runstmt[k], k);
+  }
+}
+
+// Add the statements in the run to the list of statements
+static struct ASTnode *endrun(struct ASTnode *list) {
+  int k;
+
+  cserun();
+  for (k = 0; k < Nrun; k++)
+    list = addstmt(list, Runstmt[k]);
+  Nrun = 0;
+  return (list);
+}
+
+// Look for common subexpressions in an expression on its own
+static struct ASTnode *cseexpr(struct ASTnode *n) {
+  Runstmt[0] = n;
+  Nrun = 1;
+  cserun();
+  Nrun = 0;
+  return (Runstmt[0]);
+}
+
+static struct ASTnode *csebody(struct ASTnode *n);
+
+// Do common subexpression elimination on the statements
+// in tree n, and add them to the list of statements
+static struct ASTnode *csestmts(struct ASTnode *n, struct ASTnode *list) {
+  struct ASTnode *c;
+
+  if (n == NULL)
+    return (list);
+
+  // A glue with a type is an inlined call, not statements
+  if (n->op == A_GLUE && n->type == P_NONE) {
+    list = csestmts(n->left, list);
+    return (csestmts(n->right, list));
+  }
+  switch (n->op) {
+    case A_IF:
+    case A_SWITCH:
+      // The condition is worked out straight after
+      // the run, so it can be the end of the run
+      if (Nrun == RUNMAX)
+	list = endrun(list);
+      Runstmt[Nrun] = n->left;
+      Nrun++;
+      cserun();
+      Nrun--;
+      n->left = Runstmt[Nrun];
+      list = endrun(list);
+      break;
+    case A_WHILE:
+      // The condition is worked out on each loop
+      list = endrun(list);
+      n->left = cseexpr(n->left);
+      break;
+    default:
+      // A simple statement: add it to the run
+      if (Nrun == RUNMAX)
+	list = endrun(list);
+      Runstmt[Nrun] = n;
+      Nrun++;
+      return (list);
+  }
+
+  // Now do the statements inside this one
+  switch (n->op) {
+    case A_IF:
+      n->mid = csebody(n->mid);
+      n->right = csebody(n->right);
+      break;
+    case A_WHILE:
+      n->right = csebody(n->right);
+      break;
+    case A_SWITCH:
+      for (c = n->right; c != NULL; c = c->right)
+	c->left = csebody(c->left);
+      break;
+  }
+  return (addstmt(list, n));
+}
+
+// Do common subexpression elimination on a compound
+// statement. Return the new tree of statements
+static struct ASTnode *csebody(struct ASTnode *n) {
+  struct ASTnode *list;
+
+  list = csestmts(n, NULL);
+  return (endrun(list));
+}
+
+// Self tail calls. A call by a function to itself whose value is
+// returned straight away or, in a void function, which is the last
+// thing done, becomes an A_TAILCALL: the arguments are copied into
+// the parameters and the code jumps back to the top of the function.
+// Locals and parameters on the stack are reused by the jump, so when
+// the address of one is taken, the address must not be able to
+// leave the function
+/*自尾调用。函数对自身的调用，如果调用的值马上被返回，或者在 void 函数中
+是最后做的事情，就变成 A_TAILCALL：把实参复制到形参中，再跳回函数开头。
+栈上的局部变量和形参会被这次跳转重用，所以取了它们的地址时，地址不能离开这个函数。*/
+
+static struct symtable *Tailfunc;	// The function being done
+
+// Return true if the address of a local
+// or a parameter is taken in the tree
+static int takesaddr(struct ASTnode *n) {
+  if (n == NULL)
+    return (0);
+  if (n->op == A_ADDR && n->sym != NULL &&
+      (n->sym->class == C_LOCAL || n->sym->class == C_PARAM))
+    return (1);
+  if (takesaddr(n->left) || takesaddr(n->mid))
+    return (1);
+  return (takesaddr(n->right));
+}
+
+// Return true if a pointer can leave the tree: passed
+// to a function, or stored anywhere but in a temporary
+static int leaks(struct ASTnode *n) {
+  struct ASTnode *glue;
+
+  if (n == NULL)
+    return (0);
+  switch (n->op) {
+    case A_FUNCCALL:
+      for (glue = n->left; glue != NULL; glue = glue->left)
+	if (ptrtype(glue->right->type) && glue->right->op != A_STRLIT)
+	  return (1);
+      break;
+    case A_ASSIGN:
+      if (ptrtype(n->left->type) &&
+	  (n->right->op != A_IDENT || !tempvar(n->right->sym)))
+	return (1);
+      break;
+  }
+  if (leaks(n->left) || leaks(n->mid))
+    return (1);
+  return (leaks(n->right));
+}
+
+// Make n into an A_TAILCALL if it is a call to the function
+// being done, changing each argument to the type of its
+// parameter. Return NULL if it can't be done
+static struct ASTnode *tailcall(struct ASTnode *n) {
+  struct ASTnode *glue, *arg;
+  struct symtable *parm;
+  int i;
+
+  if (n == NULL || n->op != A_FUNCCALL || n->sym != Tailfunc)
+    return (NULL);
+
+  // There must be an argument for each parameter
+  i = 0;
+  if (n->left != NULL)
+    i = n->left->a_size;
+  if (i != Tailfunc->nelems)
+    return (NULL);
+
+  // Each argument is glued with its position
+  for (glue = n->left; glue != NULL; glue = glue->left) {
+    parm = Tailfunc->member;
+    for (i = 1; i < glue->a_size; i++)
+      parm = parm->next;
+    arg = glue->right;
+    if (!inttype(arg->type) && !ptrtype(arg->type))
+      return (NULL);
+    arg = modify_type(arg, parm->type, parm->ctype, 0);
+    if (arg == NULL)
+      return (NULL);
+    glue->right = arg;
+  }
+  n->op = A_TAILCALL;
+  return (n);
+}
+
+// Make the self tail calls in a statement into jumps.
+// last is true if nothing is done after the statement
+// in a void function
+static struct ASTnode *tailstmt(struct ASTnode *n, int last) {
+  struct ASTnode *c, *t;
+
+  if (n == NULL)
+    return (NULL);
+  switch (n->op) {
+    case A_RETURN:
+      t = tailcall(n->left);
+      if (t != NULL)
+	return (t);
+      break;
+    case A_FUNCCALL:
+      if (last) {
+	t = tailcall(n);
+	if (t != NULL)
+	  return (t);
+      }
+      break;
+    case A_GLUE:
+      // A glue with a type is an inlined call, not statements.
+      // A bare return after a call leaves it last
+      if (n->type != P_NONE)
+	break;
+      t = n->right;
+      if (t != NULL && t->op == A_RETURN && t->left == NULL)
+	n->left = tailstmt(n->left, 1);
+      else
+	n->left = tailstmt(n->left, 0);
+      n->right = tailstmt(n->right, last);
+      break;
+    case A_IF:
+      n->mid = tailstmt(n->mid, last);
+      n->right = tailstmt(n->right, last);
+      break;
+    case A_WHILE:
+      n->right = tailstmt(n->right, 0);
+      break;
+    case A_SWITCH:
+      for (c = n->right; c != NULL; c = c->right)
+	c->left = tailstmt(c->left, 0);
+      break;
+  }
+  return (n);
+}
+
+// Make the self tail calls in the body of function func into jumps
+static struct ASTnode *tailcalls(struct ASTnode *n, struct symtable *func) {
+  Tailfunc = func;
+  if (takesaddr(n) && leaks(n))
+    return (n);
+  return (tailstmt(n, func->type == P_VOID));
+}
+
+// Optimise an AST tree by inlining calls to small
+// static functions in a function body, by constant
+// folding in all sub-trees, by optimising loops, by
+// sharing common subexpressions and by making self
+// tail calls into jumps
 /*它通过调用 fold 函数对 AST 树进行常量折叠（constant folding）。
-常量折叠是一种编译器优化技术，旨在在编译时计算常量表达式的值，从而减少运行时的计算开销。*/
+常量折叠是一种编译器优化技术，旨在在编译时计算常量表达式的值，从而减少运行时的计算开销。
+对函数体先把小的 static 函数的调用内联进来，折叠之后再优化其中的循环。*/
 struct ASTnode *optimise(struct ASTnode *n) {
+  if (n->op == A_FUNCTION && O_inlinelimit > 0)
+    n->left = inlinetree(n->left);
   n = fold(n);
+
+  // Optimise the loops in a function body
+  if (n->op == A_FUNCTION)
+    n->left = loops(n->left);
+
+  // Keep a small static function to inline its calls
+  if (n->op == A_FUNCTION && O_inlinelimit > 0)
+    keepinline(n);
+
+  // Share the common subexpressions in the function
+  if (n->op == A_FUNCTION)
+    n->left = csebody(n->left);
+
+  // Make the self tail calls into jumps
+  if (n->op == A_FUNCTION)
+    n->left = tailcalls(n->left, n->sym);
   return (n);
 }
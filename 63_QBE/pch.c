@@ -0,0 +1,337 @@
+#include "defs.h"
+#include "data.h"
+#include "decl.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Precompiled headers
+// Copyright (c) 2019 Warren Toomey, GPL3
+
+// cwj -emit-pch file.h parses a header on its own and writes the
+// symbols which it declares to file.h.pch. With -include-pch
+// file.h.pch, a file whose headers, as found by headerprefix(),
+// are the same text gets these symbols instead of parsing its
+// headers. The PCH file has a key which hashes the compiler,
+// the options which change the symbols and the header text.
+// If the key doesn't match, the headers are parsed as usual.
+//
+// Only headers which make no code and have no statics can be
+// precompiled: their structs, unions, enums and typedefs, and
+// their extern variables and function prototypes.
+//
+// The PCH file is an image which is mapped in and used in place.
+// It starts with PCH_HEADLEN longs, then has the symbols as
+// struct symtables and then their names. In the file a pointer
+// to a symbol is its position in the symbols plus one, a name
+// is its offset in the names plus one, and zero is NULL.
+// Loading the file turns these back into pointers.
+/*cwj -emit-pch file.h 单独分析一个头文件，把它声明的符号写到 file.h.pch 中。用 -include-pch file.h.pch 时，
+如果一个文件的头文件（由 headerprefix() 找出）文本相同，就直接使用这些符号，不再分析头文件。
+PCH 文件中的键是编译器、影响符号的选项和头文件文本的哈希值，键不匹配时照常分析头文件。
+
+只有不生成代码、没有静态符号的头文件才能预编译：其中的结构体、联合体、枚举和 typedef，
+以及 extern 变量和函数原型。
+
+PCH 文件是一个映射进来直接使用的映像：先是 PCH_HEADLEN 个 long，然后是作为 struct symtable 的符号，
+最后是它们的名字。文件中指向符号的指针是符号的位置加一，名字是它在名字中的偏移加一，零表示 NULL。
+载入文件时把它们变回指针。*/
+
+// The longs at the start of a PCH file
+enum {
+  PCH_MAGIC, PCH_KEY1, PCH_KEY2, PCH_SIZE, PCH_NSYMS, PCH_LABEL,
+  PCH_GLOB, PCH_STRUCT, PCH_UNION, PCH_ENUM, PCH_TYPE,
+  PCH_HEADLEN
+};
+
+enum {
+  PCHMAGIC = 0x6863706a,	// "jpch"
+  PCHSYMS = 1024		// Initial size of the symbol array
+};
+
+// The symbols being written out, in order
+static struct symtable **Pchsyms;
+static int Npchsyms;
+static int Pchsymsize;
+
+// The mapped in PCH file whose symbols are in use
+static char *Pchimage;
+static long Pchsize;
+
+// Give sym and the symbols after it in its list the next
+// positions in the PCH file, and then do the same for their
+// members. We keep the position in the st_offset field, as
+// that is only used by locals
+static void numbersym(struct symtable *sym) {
+  for (; sym != NULL; sym = sym->next) {
+    if (sym->st_offset != 0)	// Already numbered
+      return;
+    if (sym->class == C_STATIC)
+      fatals("Can't precompile the static symbol", sym->name);
+    if (sym->initlist != NULL)
+      fatals("Can't precompile the initialised variable", sym->name);
+    if (Npchsyms == Pchsymsize) {
+      Pchsymsize = Pchsymsize * 2;
+      Pchsyms = (struct symtable **)
+	realloc(Pchsyms, Pchsymsize * sizeof(struct symtable *));
+      if (Pchsyms == NULL)
+	fatal("Unable to malloc in numbersym()");
+    }
+    Pchsyms[Npchsyms++] = sym;
+    sym->st_offset = Npchsyms;
+    numbersym(sym->member);
+  }
+}
+
+// Return what a pointer to sym becomes in the PCH file
+static long symref(struct symtable *sym) {
+  if (sym == NULL)
+    return (0);
+  if (sym->st_offset == 0)
+    fatals("Can't precompile a symbol not in a list", sym->name);
+  return (sym->st_offset);
+}
+
+// Return what sym's ctype becomes in the PCH file. It
+// is only set for structs, unions and pointers to them
+static long ctyperef(struct symtable *sym) {
+  int base = sym->type - (sym->type & 0xf);
+
+  if (base != P_STRUCT && base != P_UNION)
+    return (0);
+  return (symref(sym->ctype));
+}
+
+// Return the size of the PCH file for the numbered symbols
+static long pchsize(void) {
+  long size;
+  int i;
+
+  size = PCH_HEADLEN * sizeof(long) + Npchsyms * sizeof(struct symtable);
+  for (i = 0; i < Npchsyms; i++)
+    if (Pchsyms[i]->name != NULL)
+      size = size + strlen(Pchsyms[i]->name) + 1;
+  return (size);
+}
+
+// Write out the symbols, then their names
+static void writesyms(FILE *fp) {
+  struct symtable *sym, *rec;
+  long nameoff = 1;
+  int i;
+
+  rec = (struct symtable *) malloc(sizeof(struct symtable));
+  if (rec == NULL)
+    fatal("Unable to malloc in writesyms()");
+  for (i = 0; i < Npchsyms; i++) {
+    sym = Pchsyms[i];
+    memcpy(rec, sym, sizeof(struct symtable));
+    rec->name = NULL;
+    if (sym->name != NULL) {
+      rec->name = (char *) nameoff;
+      nameoff = nameoff + strlen(sym->name) + 1;
+    }
+    rec->ctype = (struct symtable *) ctyperef(sym);
+    rec->next = (struct symtable *) symref(sym->next);
+    rec->member = (struct symtable *) symref(sym->member);
+    rec->hnext = NULL;
+    rec->st_offset = 0;
+    fwrite(rec, sizeof(struct symtable), 1, fp);
+  }
+  free(rec);
+
+  for (i = 0; i < Npchsyms; i++) {
+    sym = Pchsyms[i];
+    if (sym->name != NULL)
+      fwrite(sym->name, 1, strlen(sym->name) + 1, fp);
+  }
+}
+
+// Parse the header filename, whose len bytes of pre-processed
+// text are in the input buffer, and write its symbols out
+// to filename.pch
+void pchemit(char *filename, int len) {
+  char path[TEXTLEN];
+  long head[PCH_HEADLEN];
+  long key[2];
+  char *text;
+  FILE *fp;
+  int textlen;
+
+  // All of the input is header text
+  headerprefix(NULL, inputbuf(), len);
+  text = headertext(&textlen);
+  pchkey(text, textlen, key);
+
+  // Parse the header. Anything which makes code
+  // can't be precompiled
+  if ((Outfile = fopen("/dev/null", "w")) == NULL)
+    fatal("Unable to open /dev/null");
+  clear_symtable();
+  freeinline();
+  scan(&Token);
+  Peektoken.token = 0;
+  global_declarations();
+  if (cgoutbytes() != 0)
+    fatals("A precompiled header can't make any code", filename);
+
+  // Number the symbols in all the lists
+  Npchsyms = 0;
+  if (Pchsyms == NULL) {
+    Pchsymsize = PCHSYMS;
+    Pchsyms =
+      (struct symtable **) malloc(Pchsymsize * sizeof(struct symtable *));
+  }
+  numbersym(Globhead);
+  numbersym(Structhead);
+  numbersym(Unionhead);
+  numbersym(Enumhead);
+  numbersym(Typehead);
+
+  head[PCH_MAGIC] = PCHMAGIC;
+  head[PCH_KEY1] = key[0];
+  head[PCH_KEY2] = key[1];
+  head[PCH_SIZE] = pchsize();
+  head[PCH_NSYMS] = Npchsyms;
+  head[PCH_LABEL] = nextlabel();
+  head[PCH_GLOB] = symref(Globhead);
+  head[PCH_STRUCT] = symref(Structhead);
+  head[PCH_UNION] = symref(Unionhead);
+  head[PCH_ENUM] = symref(Enumhead);
+  head[PCH_TYPE] = symref(Typehead);
+
+  snprintf(path, TEXTLEN, "%s.pch", filename);
+  if ((fp = fopen(path, "w")) == NULL) {
+    fprintf(stderr, "Unable to create %s: %s\n", path, strerror(errno));
+    exit(1);
+  }
+  fwrite(head, sizeof(long), PCH_HEADLEN, fp);
+  writesyms(fp);
+  fclose(fp);
+  fclose(Outfile);
+  Outfile = NULL;
+
+  if (O_verbose)
+    printf("wrote %d symbols to %s\n", Npchsyms, path);
+}
+
+// Given the symbols from a PCH file, return what ref becomes
+static struct symtable *pchsym(char *syms, struct symtable *ref) {
+  long i;
+
+  i = (long) ref;
+  if (i == 0)
+    return (NULL);
+  return ((struct symtable *) (syms + (i - 1) * sizeof(struct symtable)));
+}
+
+// Return true if ref is NULL or one of the n symbols in a PCH file
+static int pchrefok(struct symtable *ref, int n) {
+  long i;
+
+  i = (long) ref;
+  return (i >= 0 && i <= n);
+}
+
+// Return true if the n symbols in a PCH file, followed by
+// namelen bytes of names, only refer to each other and to
+// names inside the file. A name always ends before the file
+// does, as the last byte of the names is a NUL
+static int pchcheck(long *head, char *syms, int n, long namelen) {
+  struct symtable *sym;
+  long off;
+  int i;
+
+  if (namelen > 0 && syms[n * sizeof(struct symtable) + namelen - 1] != 0)
+    return (0);
+  for (i = 0; i < n; i++) {
+    sym = (struct symtable *) (syms + i * sizeof(struct symtable));
+    off = (long) sym->name;
+    if (off < 0 || off > namelen)
+      return (0);
+    if (!pchrefok(sym->ctype, n) || !pchrefok(sym->next, n) ||
+	!pchrefok(sym->member, n))
+      return (0);
+  }
+  for (i = PCH_GLOB; i <= PCH_TYPE; i++)
+    if (!pchrefok((struct symtable *) head[i], n))
+      return (0);
+  return (1);
+}
+
+// Put the symbols from the PCH file at path into the symbol
+// table for filename, whose header text is the one found by
+// headerprefix(). Return 1 if they are in, or 0 if the file
+// is for some other headers
+int pchload(char *path, char *filename) {
+  struct symtable *sym;
+  long key[2];
+  long *head;
+  char *syms, *names, *text;
+  long off, maxsyms, namelen;
+  int fd, i, n, textlen;
+
+  // Unmap the last file's symbols, and map this file in
+  if (Pchimage != NULL)
+    munmap(Pchimage, Pchsize);
+  Pchimage = NULL;
+  if ((fd = open(path, O_RDONLY)) == -1) {
+    fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+    exit(1);
+  }
+  Pchsize = lseek(fd, 0, SEEK_END);
+  Pchimage = (char *) mmap(NULL, Pchsize, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (Pchimage == (char *) -1 || Pchsize < PCH_HEADLEN * sizeof(long))
+    fatals("Unable to map in the precompiled header", path);
+  head = (long *) Pchimage;
+  if (head[PCH_MAGIC] != PCHMAGIC || head[PCH_SIZE] != Pchsize)
+    fatals("Not a precompiled header", path);
+
+  // Check that it is for these headers
+  text = headertext(&textlen);
+  pchkey(text, textlen, key);
+  if (head[PCH_KEY1] != key[0] || head[PCH_KEY2] != key[1]) {
+    if (O_verbose)
+      printf("%s is not for the headers in %s\n", path, filename);
+    return (0);
+  }
+
+  // Check that the symbols fit in the file, and that their
+  // references and names are in range before any are used
+  syms = Pchimage + PCH_HEADLEN * sizeof(long);
+  maxsyms = (Pchsize - PCH_HEADLEN * sizeof(long)) / sizeof(struct symtable);
+  if (head[PCH_NSYMS] < 0 || head[PCH_NSYMS] > maxsyms)
+    fatals("Bad precompiled header", path);
+  n = (int) head[PCH_NSYMS];
+  names = syms + n * sizeof(struct symtable);
+  namelen = Pchsize - PCH_HEADLEN * sizeof(long) - n * sizeof(struct symtable);
+  if (!pchcheck(head, syms, n, namelen))
+    fatals("Bad precompiled header", path);
+
+  // Turn the references back into pointers
+  for (i = 0; i < n; i++) {
+    sym = (struct symtable *) (syms + i * sizeof(struct symtable));
+    if (sym->name != NULL) {
+      off = (long) sym->name;
+      sym->name = internname(names + off - 1);
+    }
+    sym->ctype = pchsym(syms, sym->ctype);
+    sym->next = pchsym(syms, sym->next);
+    sym->member = pchsym(syms, sym->member);
+  }
+
+  Globhead = pchsym(syms, (struct symtable *) head[PCH_GLOB]);
+  Structhead = pchsym(syms, (struct symtable *) head[PCH_STRUCT]);
+  Unionhead = pchsym(syms, (struct symtable *) head[PCH_UNION]);
+  Enumhead = pchsym(syms, (struct symtable *) head[PCH_ENUM]);
+  Typehead = pchsym(syms, (struct symtable *) head[PCH_TYPE]);
+  relinksymtable();
+  Nsymbols = Nsymbols + n;
+  skiplabels((int) head[PCH_LABEL]);
+  if (O_verbose)
+    printf("using %d symbols from %s for %s\n", n, path, filename);
+  return (1);
+}
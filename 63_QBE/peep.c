@@ -0,0 +1,722 @@
+#include "defs.h"
+#include "data.h"
+#include "decl.h"
+
+// Peephole optimisation of the QBE code
+// Copyright (c) 2019 Warren Toomey, GPL3
+
+// cg.c keeps the QBE code for a function in memory and hands
+// it to peephole() when the function is done. The text is split
+// into a list of instructions, each with its destination, type,
+// operation and arguments. Then, within each basic block:
+//  - a use of a temporary which was set by a copy is replaced
+//    by what it copies, a constant or a temporary or variable of
+//    the same type, until either of them is set again;
+//  - a load from an address which was just stored to or loaded
+//    from becomes a copy of that value. A store through a pointer
+//    or a call can change any memory, apart from the stack slots
+//    whose address is only ever used to load and store.
+// After that, the temporaries which are never used are removed,
+// and a temporary which is set and then only copied to a variable
+// by the next instruction is replaced by the variable. The list
+// is then written out as text again.
+/*cg.c 把一个函数的 QBE 代码留在内存里，函数结束时交给 peephole()。文本被拆成指令表，
+每条指令有目标、类型、操作和参数。然后在每个基本块内：
+ - 用 copy 设置的临时变量，在它或者它复制的值被重新设置之前，其使用处都换成被复制的值，
+   即常量或者同类型的临时变量、变量；
+ - 刚存过或者读过的地址再读一次，就变成那个值的 copy。通过指针的存储或者函数调用可能改变任何内存，
+   只有地址只用于读写的栈槽除外。
+之后删除从未使用的临时变量；一个临时变量被设置后，下一条指令只是把它复制给某个变量时，
+直接用这个变量代替它。最后把指令表重新写成文本。*/
+
+enum {
+  PEEPINC = 1024,		// Number of instructions or arguments
+  				// to add to the lists at a time
+  NREMEMBER = 16		// Loads and stores remembered in a block
+};
+
+// The instructions. A line which isn't an instruction,
+// i.e. a label or the first or last line of the function,
+// has no operation and is kept as text. A removed
+// instruction has neither an operation nor any text
+static char **Itext;		// The line, if not an instruction
+static char **Idest;		// Temporary or variable set, or NULL
+static int *Iq;			// QBE type of the destination
+static char **Iop;		// Operation
+static char **Icallee;		// Function called, for a call
+static int *Iarg;		// Position of the first argument in Args
+static int *Inargs;		// Number of arguments
+static int Ninsns;
+static int Maxinsns;
+
+// The arguments of all the instructions, and
+// the QBE type of each argument of a call
+static char **Args;
+static int *Argq;
+static int Nargs;
+static int Maxargs;
+
+// For each temporary: the number of uses and sets, its QBE
+// type, or '?' if it has more than one, the value which it
+// is a copy of in the block being done, or NULL, and the
+// last instruction which set it and its basic block
+static int *Tuses;
+static int *Tdefs;
+static int *Tq;
+static char **Tcopy;
+static int *Tlast;
+static int *Tblock;
+static int Ntemps;
+static int Maxtemps;
+
+// The temporaries set by a copy in the block being done
+static int *Copies;
+static int Ncopies;
+
+// The named variables: their QBE type, and whether they are
+// stack slots whose address is only used to load and store
+static char **Vname;
+static int *Vq;
+static int *Vslot;
+static int Nvars;
+static int Maxvars;
+
+// The loads and stores remembered in the block being done:
+// the address, the value at it, the width of the memory
+// and the operation which gets the value for a load
+static char *Maddr[NREMEMBER];
+static char *Mval[NREMEMBER];
+static int Mwidth[NREMEMBER];
+static char *Mop[NREMEMBER];
+static int Nremember;
+
+// Return the number n of the temporary %.tn, or 0 if s isn't one
+static int tempnum(char *s) {
+  int n = 0;
+
+  if (s[0] != '%' || s[1] != '.' || s[2] != 't')
+    return (0);
+  s = s + 3;
+  while (*s >= '0' && *s <= '9') {
+    n = n * 10 + *s - '0';
+    s++;
+  }
+  if (*s != 0 || n > Ntemps)
+    return (0);
+  return (n);
+}
+
+// Return true if s is an integer constant
+static int isconstant(char *s) {
+  return ((*s >= '0' && *s <= '9') || *s == '-');
+}
+
+// Return true if the operation starts with prefix
+static int opis(char *op, char *prefix) {
+  return (strncmp(op, prefix, strlen(prefix)) == 0);
+}
+
+// Make the list of instructions big enough for one more
+static void growinsns(void) {
+  if (Ninsns < Maxinsns)
+    return;
+  Maxinsns = Maxinsns + PEEPINC;
+  Itext = (char **) realloc(Itext, Maxinsns * sizeof(char *));
+  Idest = (char **) realloc(Idest, Maxinsns * sizeof(char *));
+  Iq = (int *) realloc(Iq, Maxinsns * sizeof(int));
+  Iop = (char **) realloc(Iop, Maxinsns * sizeof(char *));
+  Icallee = (char **) realloc(Icallee, Maxinsns * sizeof(char *));
+  Iarg = (int *) realloc(Iarg, Maxinsns * sizeof(int));
+  Inargs = (int *) realloc(Inargs, Maxinsns * sizeof(int));
+  Copies = (int *) realloc(Copies, Maxinsns * sizeof(int));
+  if (Itext == NULL || Idest == NULL || Iq == NULL || Iop == NULL ||
+      Icallee == NULL || Iarg == NULL || Inargs == NULL || Copies == NULL)
+    fatal("Unable to malloc in growinsns()");
+}
+
+// Add an argument of QBE type q, or 0 if
+// it has no type, to the last instruction
+static void addarg(char *arg, int q) {
+  if (Nargs == Maxargs) {
+    Maxargs = Maxargs + PEEPINC;
+    Args = (char **) realloc(Args, Maxargs * sizeof(char *));
+    Argq = (int *) realloc(Argq, Maxargs * sizeof(int));
+    if (Args == NULL || Argq == NULL)
+      fatal("Unable to malloc in addarg()");
+  }
+  Args[Nargs] = arg;
+  Argq[Nargs] = q;
+  Nargs++;
+  Inargs[Ninsns - 1] = Inargs[Ninsns - 1] + 1;
+}
+
+// Return the position of the named variable, or -1
+static int findvar(char *name) {
+  int i;
+
+  for (i = 0; i < Nvars; i++)
+    if (strcmp(Vname[i], name) == 0)
+      return (i);
+  return (-1);
+}
+
+// Note that the named variable has QBE type q. If it has
+// been given another type already, its type is unknown
+static void addvar(char *name, int q) {
+  int i = findvar(name);
+
+  if (i != -1) {
+    if (Vq[i] != q)
+      Vq[i] = '?';
+    return;
+  }
+  if (Nvars == Maxvars) {
+    Maxvars = Maxvars + PEEPINC;
+    Vname = (char **) realloc(Vname, Maxvars * sizeof(char *));
+    Vq = (int *) realloc(Vq, Maxvars * sizeof(int));
+    Vslot = (int *) realloc(Vslot, Maxvars * sizeof(int));
+    if (Vname == NULL || Vq == NULL || Vslot == NULL)
+      fatal("Unable to malloc in addvar()");
+  }
+  Vname[Nvars] = name;
+  Vq[Nvars] = q;
+  Vslot[Nvars] = 0;
+  Nvars++;
+}
+
+// Split a line of QBE code into an instruction. The
+// line is NUL-terminated, and each part of it is
+// NUL-terminated in place
+static void parseline(char *line) {
+  char *s = line;
+  char *arg;
+  int q, i = Ninsns;
+
+  growinsns();
+  Ninsns++;
+  Itext[i] = line;
+  Idest[i] = NULL;
+  Iq[i] = 0;
+  Iop[i] = NULL;
+  Icallee[i] = NULL;
+  Iarg[i] = Nargs;
+  Inargs[i] = 0;
+
+  // Labels and the function's first and last
+  // lines are kept as they are
+  if (*s != ' ')
+    return;
+  s = s + 2;
+
+  // The destination and its type: "%name =q "
+  if (*s == '%') {
+    Idest[i] = s;
+    while (*s != ' ')
+      s++;
+    *s = 0;
+    Iq[i] = s[2];
+    s = s + 4;
+  }
+
+  // The operation
+  Iop[i] = s;
+  while (*s != ' ' && *s != 0)
+    s++;
+  if (*s == 0)
+    return;
+  *s = 0;
+  s++;
+
+  // A call's arguments are "q value, " up to a ')'
+  if (strcmp(Iop[i], "call") == 0) {
+    Icallee[i] = s;
+    while (*s != '(')
+      s++;
+    *s = 0;
+    s++;
+    while (*s != ')') {
+      q = *s;
+      arg = s + 2;
+      while (*s != ',')
+	s++;
+      *s = 0;
+      s = s + 2;
+      addarg(arg, q);
+    }
+    return;
+  }
+
+  // Other arguments are separated by ", "
+  while (1) {
+    arg = s;
+    while (*s != ',' && *s != 0)
+      s++;
+    addarg(arg, 0);
+    if (*s == 0)
+      break;
+    *s = 0;
+    s = s + 2;
+  }
+}
+
+// Note the types of the function's parameters from its first
+// line, e.g. "function w $f(w %a, l %b, ) {". The names are
+// copied, as this line is written out again unchanged.
+// Return the number of parameters
+static int parseparams(char *line) {
+  char *s = line;
+  char *name;
+  int q, len, count = 0;
+
+  while (*s != '(')
+    s++;
+  s++;
+  while (*s != ')') {
+    q = *s;
+    s = s + 2;
+    len = 0;
+    while (s[len] != ',')
+      len++;
+    name = (char *) malloc(len + 1);
+    if (name == NULL)
+      fatal("Unable to malloc in parseparams()");
+    memcpy(name, s, len);
+    name[len] = 0;
+    addvar(name, q);
+    count++;
+    s = s + len + 2;
+  }
+  return (count);
+}
+
+// Find the named variables and their types, and the
+// stack slots whose address is only used to load and store.
+// Count the uses and sets of each temporary and find its type
+static void scaninsns(void) {
+  int i, j, t, v;
+  char *arg;
+
+  for (i = 0; i < Ninsns; i++) {
+    if (Idest[i] != NULL) {
+      t = tempnum(Idest[i]);
+      if (t == 0)
+	addvar(Idest[i], Iq[i]);
+      else {
+	Tdefs[t] = Tdefs[t] + 1;
+	if (Tq[t] == 0)
+	  Tq[t] = Iq[i];
+	else if (Tq[t] != Iq[i])
+	  Tq[t] = '?';
+      }
+      if (opis(Iop[i], "alloc"))
+	Vslot[findvar(Idest[i])] = 1;
+    }
+  }
+
+  // A slot whose address is used as a value escapes
+  for (i = 0; i < Ninsns; i++) {
+    for (j = 0; j < Inargs[i]; j++) {
+      arg = Args[Iarg[i] + j];
+      if (*arg == '%' && tempnum(arg) == 0) {
+	v = findvar(arg);
+	if (v != -1 &&
+	    !(j == 0 && opis(Iop[i], "load")) &&
+	    !(j == 1 && opis(Iop[i], "store")))
+	  Vslot[v] = 0;
+      }
+    }
+  }
+}
+
+// Return the QBE type of a value: 0 for a constant, which
+// can be used as any type, or '?' if it isn't known
+static int valuetype(char *value) {
+  int t, v;
+
+  if (isconstant(value))
+    return (0);
+  if (*value == '$')
+    return ('l');
+  t = tempnum(value);
+  if (t != 0)
+    return (Tq[t]);
+  v = findvar(value);
+  if (v == -1)
+    return ('?');
+  return (Vq[v]);
+}
+
+// Return true if the address is a stack slot
+// whose address is only used to load and store
+static int privateslot(char *addr) {
+  int v;
+
+  if (*addr != '%' || tempnum(addr) != 0)
+    return (0);
+  v = findvar(addr);
+  return (v != -1 && Vslot[v]);
+}
+
+// Forget the remembered load or store at position m
+static void forget(int m) {
+  Nremember--;
+  Maddr[m] = Maddr[Nremember];
+  Mval[m] = Mval[Nremember];
+  Mwidth[m] = Mwidth[Nremember];
+  Mop[m] = Mop[Nremember];
+}
+
+// Forget the remembered loads and stores of the memory which
+// a store to addr, or a call if addr is NULL, might change.
+// Nothing else can point at a private stack slot, so a store
+// to one only changes that slot. Any other store, and a call,
+// might change all the memory apart from the private slots
+static void clobber(char *addr) {
+  int m = 0, private = 0;
+
+  if (addr != NULL && privateslot(addr))
+    private = 1;
+  while (m < Nremember) {
+    if (private) {
+      if (strcmp(Maddr[m], addr) == 0)
+	forget(m);
+      else
+	m++;
+    } else if (!privateslot(Maddr[m]))
+      forget(m);
+    else
+      m++;
+  }
+}
+
+// Remember that the memory at addr, of the given width,
+// holds value, which a load gets with the operation op
+static void remember(char *addr, char *value, int width, char *op) {
+  if (Nremember == NREMEMBER)
+    Nremember = 0;
+  Maddr[Nremember] = addr;
+  Mval[Nremember] = value;
+  Mwidth[Nremember] = width;
+  Mop[Nremember] = op;
+  Nremember++;
+}
+
+// Return the width of memory which a load
+// or store operation uses, or 0 if unknown
+static int opwidth(char *op) {
+  if (strcmp(op, "loadub") == 0 || strcmp(op, "storeb") == 0)
+    return ('b');
+  if (strcmp(op, "loadsw") == 0 || strcmp(op, "storew") == 0)
+    return ('w');
+  if (strcmp(op, "loadl") == 0 || strcmp(op, "storel") == 0)
+    return ('l');
+  return (0);
+}
+
+// The destination dest is being set: forget
+// the copies and memory which refer to it
+static void setdest(char *dest) {
+  int i, t, m = 0;
+
+  t = tempnum(dest);
+  if (t != 0)
+    Tcopy[t] = NULL;
+  for (i = 0; i < Ncopies; i++) {
+    t = Copies[i];
+    if (Tcopy[t] != NULL && strcmp(Tcopy[t], dest) == 0)
+      Tcopy[t] = NULL;
+  }
+  while (m < Nremember) {
+    if (strcmp(Maddr[m], dest) == 0 || strcmp(Mval[m], dest) == 0)
+      forget(m);
+    else
+      m++;
+  }
+}
+
+// Start a new basic block: forget all the
+// copies and the remembered memory
+static void newblock(void) {
+  int i;
+
+  for (i = 0; i < Ncopies; i++)
+    Tcopy[Copies[i]] = NULL;
+  Ncopies = 0;
+  Nremember = 0;
+}
+
+// Return true if the argument at position j of
+// instruction i can be replaced by the value
+static int canreplace(int i, int j, char *value) {
+  if (!isconstant(value))
+    return (1);
+
+  // Keep constants out of conditions and addresses
+  if (j == 0 && (strcmp(Iop[i], "jnz") == 0 || opis(Iop[i], "load")))
+    return (0);
+  if (j == 1 && opis(Iop[i], "store"))
+    return (0);
+  return (1);
+}
+
+// Go through the instructions in order, replacing the
+// uses of copies and the loads whose value is known
+static void propagate(void) {
+  int i, j, t, m, width;
+  char *arg, *addr;
+
+  for (i = 0; i < Ninsns; i++) {
+    if (Iop[i] == NULL)
+      newblock();
+    else {
+      // Replace the arguments which are copies
+      for (j = 0; j < Inargs[i]; j++) {
+	t = tempnum(Args[Iarg[i] + j]);
+	if (t != 0 && Tcopy[t] != NULL && canreplace(i, j, Tcopy[t]))
+	  Args[Iarg[i] + j] = Tcopy[t];
+      }
+
+      // A load of remembered memory becomes a copy of its value
+      width = opwidth(Iop[i]);
+      addr = NULL;
+      if (width != 0)
+	addr = Args[Iarg[i] + Inargs[i] - 1];
+      if (width != 0 && opis(Iop[i], "load")) {
+	m = 0;
+	while (m < Nremember &&
+	       (Mwidth[m] != width || strcmp(Maddr[m], addr) != 0))
+	  m++;
+	if (m < Nremember) {
+	  Iop[i] = Mop[m];
+	  Args[Iarg[i]] = Mval[m];
+	  width = 0;
+	}
+      }
+
+      if (Idest[i] != NULL)
+	setdest(Idest[i]);
+      if (strcmp(Iop[i], "call") == 0)
+	clobber(NULL);
+
+      // Remember what is in memory after a load or a store.
+      // A byte loaded back after a store has to be extended
+      if (width != 0 && opis(Iop[i], "store")) {
+	clobber(addr);
+	arg = Args[Iarg[i]];
+	if (width == 'b')
+	  remember(addr, arg, width, "extub");
+	else
+	  remember(addr, arg, width, "copy");
+      } else if (width != 0 && strcmp(addr, Idest[i]) != 0)
+	remember(addr, Idest[i], width, "copy");
+
+      // Note a copy to a temporary of a value of the same type
+      t = 0;
+      if (Idest[i] != NULL && strcmp(Iop[i], "copy") == 0)
+	t = tempnum(Idest[i]);
+      if (t != 0) {
+	arg = Args[Iarg[i]];
+	if (strcmp(arg, Idest[i]) != 0 &&
+	    (valuetype(arg) == 0 || valuetype(arg) == Iq[i])) {
+	  Tcopy[t] = arg;
+	  Copies[Ncopies] = t;
+	  Ncopies++;
+	}
+      }
+
+      if (strcmp(Iop[i], "jmp") == 0 || strcmp(Iop[i], "jnz") == 0 ||
+	  strcmp(Iop[i], "ret") == 0)
+	newblock();
+    }
+  }
+}
+
+// Remove instruction i, and its uses of temporaries
+static void removeinsn(int i) {
+  int j, t;
+
+  for (j = 0; j < Inargs[i]; j++) {
+    t = tempnum(Args[Iarg[i] + j]);
+    if (t != 0)
+      Tuses[t] = Tuses[t] - 1;
+  }
+  if (Idest[i] != NULL) {
+    t = tempnum(Idest[i]);
+    if (t != 0)
+      Tdefs[t] = Tdefs[t] - 1;
+  }
+  Iop[i] = NULL;
+  Itext[i] = NULL;
+}
+
+// Remove the instructions which set temporaries that are
+// never used: those set again later in the same block with
+// no use in between, then those with no uses at all. Calls
+// are kept for what else they do. Then, where a temporary
+// is set and then only copied to a variable of the same type
+// by the next instruction, set the variable instead
+static void removedead(void) {
+  int i, j, t, block = 0, changed = 1;
+
+  for (i = 0; i < Ninsns; i++)
+    for (j = 0; j < Inargs[i]; j++) {
+      t = tempnum(Args[Iarg[i] + j]);
+      if (t != 0)
+	Tuses[t] = Tuses[t] + 1;
+    }
+
+  for (i = 0; i < Ninsns; i++) {
+    if (Iop[i] == NULL)
+      block++;
+    else {
+      for (j = 0; j < Inargs[i]; j++) {
+	t = tempnum(Args[Iarg[i] + j]);
+	if (t != 0)
+	  Tlast[t] = -1;
+      }
+      t = 0;
+      if (Idest[i] != NULL)
+	t = tempnum(Idest[i]);
+      if (t != 0) {
+	j = Tlast[t];
+	if (Tblock[t] == block && j != -1 && strcmp(Iop[j], "call") != 0)
+	  removeinsn(j);
+	Tlast[t] = i;
+	Tblock[t] = block;
+      }
+      if (strcmp(Iop[i], "jmp") == 0 || strcmp(Iop[i], "jnz") == 0 ||
+	  strcmp(Iop[i], "ret") == 0)
+	block++;
+    }
+  }
+
+  // Going backwards, the uses are usually
+  // removed before the instruction that sets them
+  while (changed) {
+    changed = 0;
+    for (i = Ninsns - 1; i >= 0; i--) {
+      if (Iop[i] != NULL && Idest[i] != NULL &&
+	  strcmp(Iop[i], "call") != 0) {
+	t = tempnum(Idest[i]);
+	if (t != 0 && Tuses[t] == 0) {
+	  removeinsn(i);
+	  changed = 1;
+	}
+      }
+    }
+  }
+
+  for (i = 1; i < Ninsns; i++) {
+    // Find the instruction before this one
+    j = i - 1;
+    while (j > 0 && Iop[j] == NULL && Itext[j] == NULL)
+      j--;
+    t = 0;
+    if (Iop[i] != NULL && Iop[j] != NULL && Idest[j] != NULL &&
+	strcmp(Iop[i], "copy") == 0)
+      t = tempnum(Args[Iarg[i]]);
+    if (t != 0 && Tuses[t] == 1 && Tdefs[t] == 1 &&
+	strcmp(Idest[j], Args[Iarg[i]]) == 0 && Iq[j] == Iq[i]) {
+      Idest[j] = Idest[i];
+      removeinsn(i);
+    }
+  }
+}
+
+// Write out the instructions as QBE code
+static void writeinsns(void) {
+  int i, j;
+
+  for (i = 0; i < Ninsns; i++) {
+    if (Iop[i] == NULL) {
+      if (Itext[i] != NULL) {
+	emits(Itext[i]);
+	emitc('\n');
+      }
+    } else {
+      emits("  ");
+      if (Idest[i] != NULL) {
+	emits(Idest[i]);
+	emits(" =");
+	emitc(Iq[i]);
+	emitc(' ');
+      }
+      emits(Iop[i]);
+      if (Icallee[i] != NULL) {
+	emitc(' ');
+	emits(Icallee[i]);
+	emitc('(');
+	for (j = Iarg[i]; j < Iarg[i] + Inargs[i]; j++) {
+	  emitc(Argq[j]);
+	  emitc(' ');
+	  emits(Args[j]);
+	  emits(", ");
+	}
+	emitc(')');
+      } else {
+	for (j = 0; j < Inargs[i]; j++) {
+	  if (j == 0)
+	    emitc(' ');
+	  else
+	    emits(", ");
+	  emits(Args[Iarg[i] + j]);
+	}
+      }
+      emitc('\n');
+    }
+  }
+}
+
+// Optimise the len bytes of QBE code for a function in
+// text, which uses temporaries 1 to ntemps, and write
+// it out. The text is changed in place
+void peephole(char *text, int len, int ntemps) {
+  int i, nparams = 0, start = 0;
+
+  Ninsns = 0;
+  Nargs = 0;
+  Nvars = 0;
+  Ncopies = 0;
+  Nremember = 0;
+  Ntemps = ntemps;
+  if (ntemps >= Maxtemps) {
+    Maxtemps = ntemps + PEEPINC;
+    Tuses = (int *) realloc(Tuses, Maxtemps * sizeof(int));
+    Tdefs = (int *) realloc(Tdefs, Maxtemps * sizeof(int));
+    Tq = (int *) realloc(Tq, Maxtemps * sizeof(int));
+    Tcopy = (char **) realloc(Tcopy, Maxtemps * sizeof(char *));
+    Tlast = (int *) realloc(Tlast, Maxtemps * sizeof(int));
+    Tblock = (int *) realloc(Tblock, Maxtemps * sizeof(int));
+    if (Tuses == NULL || Tdefs == NULL || Tq == NULL || Tcopy == NULL ||
+	Tlast == NULL || Tblock == NULL)
+      fatal("Unable to malloc in peephole()");
+  }
+  for (i = 0; i <= ntemps; i++) {
+    Tuses[i] = 0;
+    Tdefs[i] = 0;
+    Tq[i] = 0;
+    Tcopy[i] = NULL;
+    Tlast[i] = -1;
+    Tblock[i] = -1;
+  }
+
+  // Split the text into lines, and the lines into instructions
+  for (i = 0; i < len; i++) {
+    if (text[i] == '\n') {
+      text[i] = 0;
+      parseline(text + start);
+      start = i + 1;
+    }
+  }
+  if (Ninsns > 0)
+    nparams = parseparams(Itext[0]);
+
+  scaninsns();
+  propagate();
+  removedead();
+  writeinsns();
+
+  // The parameter names were copied
+  for (i = 0; i < nparams; i++)
+    free(Vname[i]);
+}
@@ -0,0 +1,266 @@
+#include "defs.h"
+#include "data.h"
+#include "decl.h"
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/times.h>
+
+// Time and memory reports for -ftime-report
+// Copyright (c) 2019 Warren Toomey, GPL3
+
+// For each phase of the compilation we keep the wall time,
+// the CPU time of the compiler and of the processes it ran,
+// and the most memory in use in the compiler's arenas, i.e.
+// the AST nodes and symbols. Phases can nest: the optimiser
+// and code generator run inside the parser. Each function's
+// times and sizes are kept as well
+/*对编译的每个阶段记录墙钟时间、编译器及其子进程的 CPU 时间，以及编译器内存池（AST 节点和符号）
+中占用内存的最大值。阶段可以嵌套：优化器和代码生成器在语法分析器里面运行。每个函数的时间和大小也会记录下来。*/
+
+static char *Phasename[] = {
+  "cpp", "scan", "parse", "optimise", "genAST", "qbe", "as", "link"
+};
+
+static long Phwall[NPHASES];	// Time spent in each phase, in usecs
+static long Phcpu[NPHASES];
+static long Phpeak[NPHASES];	// Most arena bytes in use
+static long Startwall[NPHASES];	// When the phase started
+static long Startcpu[NPHASES];
+static long Outerpeak[NPHASES];	// Arena peak of the enclosing phases
+
+// The functions in the file being compiled
+static int Nfuncs;
+static int Maxfuncs;
+static char **Fname;
+static long *Fnodes;
+static long *Fwall;
+static long *Fopt;
+static long *Fgen;
+static long *Fbytes;
+static long *Fpeak;
+
+// Where the current function started
+static long Fstartwall, Fstartopt, Fstartgen, Fstartnodes, Fstartbytes;
+
+// Return the wall clock time in usecs
+static long wallclock(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+// Return the CPU time used by the compiler and by the
+// processes which it has waited for, in usecs
+static long cputime(void) {
+  struct tms t;
+  long ticks, tickusecs;
+
+  // The processes' times are in clock ticks
+  times(&t);
+  ticks = t.tms_cutime + t.tms_cstime;
+  tickusecs = 1000000 / sysconf(_SC_CLK_TCK);
+  return (clock() + ticks * tickusecs);
+}
+
+// Start timing a phase. Track the arena
+// peak for this phase on its own
+void phasestart(int phase) {
+  Outerpeak[phase] = Arenapeak;
+  Arenapeak = Arenaused;
+  Startwall[phase] = wallclock();
+  Startcpu[phase] = cputime();
+}
+
+// Stop timing a phase and add on its times
+void phaseend(int phase) {
+  Phwall[phase] = Phwall[phase] + wallclock() - Startwall[phase];
+  Phcpu[phase] = Phcpu[phase] + cputime() - Startcpu[phase];
+  if (Arenapeak > Phpeak[phase])
+    Phpeak[phase] = Arenapeak;
+  if (Outerpeak[phase] > Arenapeak)
+    Arenapeak = Outerpeak[phase];
+}
+
+// Forget the times and functions of the last file
+void resetreport(void) {
+  int i;
+
+  for (i = 0; i < NPHASES; i++) {
+    Phwall[i] = 0;
+    Phcpu[i] = 0;
+    Phpeak[i] = 0;
+  }
+  for (i = 0; i < Nfuncs; i++)
+    free(Fname[i]);
+  Nfuncs = 0;
+  Nastnodes = 0;
+  Nsymbols = 0;
+}
+
+// Note the start of a function
+void funcstart(void) {
+  Fstartwall = wallclock();
+  Fstartopt = Phwall[PH_OPT];
+  Fstartgen = Phwall[PH_GEN];
+  Fstartnodes = Nastnodes;
+  Fstartbytes = cgoutbytes();
+  Arenapeak = Arenaused;
+}
+
+// Record the times and sizes of the function
+// which has just had its code generated
+void funcend(char *name) {
+  // Grow the arrays of functions as needed
+  if (Nfuncs == Maxfuncs) {
+    Maxfuncs = Maxfuncs * 2 + 16;
+    Fname = (char **) realloc(Fname, Maxfuncs * sizeof(char *));
+    Fnodes = (long *) realloc(Fnodes, Maxfuncs * sizeof(long));
+    Fwall = (long *) realloc(Fwall, Maxfuncs * sizeof(long));
+    Fopt = (long *) realloc(Fopt, Maxfuncs * sizeof(long));
+    Fgen = (long *) realloc(Fgen, Maxfuncs * sizeof(long));
+    Fbytes = (long *) realloc(Fbytes, Maxfuncs * sizeof(long));
+    Fpeak = (long *) realloc(Fpeak, Maxfuncs * sizeof(long));
+    if (Fpeak == NULL)
+      fatal("Unable to malloc the function list in funcend");
+  }
+  Fname[Nfuncs] = strdup(name);
+  Fnodes[Nfuncs] = Nastnodes - Fstartnodes;
+  Fwall[Nfuncs] = wallclock() - Fstartwall;
+  Fopt[Nfuncs] = Phwall[PH_OPT] - Fstartopt;
+  Fgen[Nfuncs] = Phwall[PH_GEN] - Fstartgen;
+  Fbytes[Nfuncs] = cgoutbytes() - Fstartbytes;
+  Fpeak[Nfuncs] = Arenapeak;
+  Nfuncs++;
+}
+
+// Print a time in usecs as milliseconds
+static void printms(long usecs) {
+  printf(" %7ld.%03ld", usecs / 1000, usecs % 1000);
+}
+
+// Return true if phase i is in the report.
+// With -O0 there is no qbe phase
+static int phaseshown(int i) {
+  return (i != PH_QBE || !O_x64);
+}
+
+// Print the phases from first to last as a table
+static void phasetable(int first, int last) {
+  long wall = 0, cpu = 0;
+  int i;
+
+  printf("%-10s %11s %11s %9s\n", "phase", "wall ms", "cpu ms", "peak KB");
+  for (i = first; i <= last; i++) {
+    if (phaseshown(i)) {
+      printf("%-10s", Phasename[i]);
+      printms(Phwall[i]);
+      printms(Phcpu[i]);
+      printf(" %9ld\n", Phpeak[i] / 1024);
+      wall = wall + Phwall[i];
+      cpu = cpu + Phcpu[i];
+    }
+  }
+  printf("%-10s", "total");
+  printms(wall);
+  printms(cpu);
+  printf("\n");
+}
+
+// Print the phases from first to last as JSON
+static void phasejson(int first, int last) {
+  int i;
+
+  printf("\"phases\": {");
+  for (i = first; i <= last; i++) {
+    if (phaseshown(i)) {
+      if (i > first)
+	printf(", ");
+      printf("\"%s\": {\"wall_us\": %ld, \"cpu_us\": %ld, \"peak_bytes\": %ld}",
+	     Phasename[i], Phwall[i], Phcpu[i], Phpeak[i]);
+    }
+  }
+  printf("}");
+}
+
+// Print s as a JSON string. A " or \ is escaped with a
+// backslash, as in a C string literal, and the other
+// control characters become \u escapes
+/*把 s 作为 JSON 字符串打印出来。" 和 \ 像 C 字符串字面值中那样用反斜杠转义，
+其他控制字符写成 \u 转义。*/
+static void jsonstring(char *s) {
+  int c;
+
+  putchar('"');
+  while (*s) {
+    c = *s & 0xff;
+    if (c == '"' || c == '\\')
+      printf("\\%c", c);
+    else if (c < ' ')
+      printf("\\u%04x", c);
+    else
+      putchar(c);
+    s++;
+  }
+  putchar('"');
+}
+
+// Print the report for a file, as a table or
+// with -ftime-report=json as one line of JSON.
+// The parse time is what is left of the front end
+// once scanning, optimising and genAST() are taken out
+/*打印一个文件的报告：表格形式，或者用 -ftime-report=json 时输出一行 JSON。语法分析的时间是
+前端总时间去掉词法分析、优化和 genAST() 之后剩下的部分。*/
+void filereport(char *filename) {
+  int i;
+
+  Phwall[PH_PARSE] =
+    Phwall[PH_PARSE] - Phwall[PH_SCAN] - Phwall[PH_OPT] - Phwall[PH_GEN];
+  Phcpu[PH_PARSE] =
+    Phcpu[PH_PARSE] - Phcpu[PH_SCAN] - Phcpu[PH_OPT] - Phcpu[PH_GEN];
+
+  if (O_timereport == 2) {
+    printf("{\"file\": ");
+    jsonstring(filename);
+    printf(", \"ast_nodes\": %ld, \"symbols\": %ld, ", Nastnodes, Nsymbols);
+    phasejson(PH_CPP, PH_AS);
+    printf(", \"functions\": [");
+    for (i = 0; i < Nfuncs; i++) {
+      if (i > 0)
+	printf(", ");
+      printf("{\"name\": \"%s\", \"ast_nodes\": %ld, ", Fname[i], Fnodes[i]);
+      printf("\"wall_us\": %ld, \"opt_us\": %ld, \"gen_us\": %ld, ",
+	     Fwall[i], Fopt[i], Fgen[i]);
+      printf("\"qbe_bytes\": %ld, \"peak_bytes\": %ld}", Fbytes[i], Fpeak[i]);
+    }
+    printf("]}\n");
+  } else {
+    printf("Time report for %s: %ld AST nodes, %ld symbols\n",
+	   filename, Nastnodes, Nsymbols);
+    phasetable(PH_CPP, PH_AS);
+    printf("%-20s %7s %11s %11s %11s %9s %8s\n", "function", "nodes",
+	   "wall ms", "opt ms", "gen ms", "QBE bytes", "peak KB");
+    for (i = 0; i < Nfuncs; i++) {
+      printf("%-20s %7ld", Fname[i], Fnodes[i]);
+      printms(Fwall[i]);
+      printms(Fopt[i]);
+      printms(Fgen[i]);
+      printf(" %9ld %8ld\n", Fbytes[i], Fpeak[i] / 1024);
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+// Print the report for the link step
+void linkreport(void) {
+  if (O_timereport == 2) {
+    printf("{\"link\": true, ");
+    phasejson(PH_LINK, PH_LINK);
+    printf("}\n");
+  } else {
+    printf("Time report for linking\n");
+    phasetable(PH_LINK, PH_LINK);
+  }
+}
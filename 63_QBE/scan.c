@@ -5,19 +5,160 @@
 // Lexical scanning
 // Copyright (c) 2019 Warren Toomey, GPL3
 
-// Return the position of character c
-// in string s, or -1 if c not found
-/*该函数用于查找字符 c 在字符串 s 中的位置。函数返回找到的字符在字符串中的索引，如果字符未找到，则返回 -1。*/
-static int chrpos(char *s, int c) {
-  int i;
-  for (i = 0; s[i] != '\0'; i++)
-    if (s[i] == (char) c)
-      return (i);
-  return (-1);
+// Character classes. Chclass[] holds the classes of each
+// character, Chvalue[] its value as a hex digit or -1, and
+// Chtoken[] the token for characters which are a token all
+// by themselves. All three are indexed by c+1, so that EOF,
+// which is -1, has an entry of its own
+/*字符类别表。Chclass[] 记录每个字符的类别，Chvalue[] 记录它作为十六进制数字的值（不是则为 -1），
+Chtoken[] 记录单独构成一个标记的字符所对应的标记。三张表都用 c+1 作下标，这样 EOF（即 -1）也有自己的表项。*/
+enum {
+  CH_SPACE = 1,			// Whitespace
+  CH_DIGIT = 2,			// 0 to 9
+  CH_IDSTART = 4,		// Can start an identifier
+  CH_IDENT = 8			// Can be in an identifier
+};
+static int Chclass[257];
+static int Chvalue[257];
+static int Chtoken[257];
+
+// Fill in the character class tables
+static void initclass(void) {
+  int c;
+
+  for (c = 0; c < 257; c++)
+    Chvalue[c] = -1;
+  Chclass[' ' + 1] = CH_SPACE;
+  Chclass['\t' + 1] = CH_SPACE;
+  Chclass['\n' + 1] = CH_SPACE;
+  Chclass['\r' + 1] = CH_SPACE;
+  Chclass['\f' + 1] = CH_SPACE;
+  for (c = 'a'; c <= 'z'; c++)
+    Chclass[c + 1] = CH_IDSTART | CH_IDENT;
+  for (c = 'A'; c <= 'Z'; c++)
+    Chclass[c + 1] = CH_IDSTART | CH_IDENT;
+  Chclass['_' + 1] = CH_IDSTART | CH_IDENT;
+  for (c = '0'; c <= '9'; c++) {
+    Chclass[c + 1] = CH_DIGIT | CH_IDENT;
+    Chvalue[c + 1] = c - '0';
+  }
+  for (c = 'a'; c <= 'f'; c++) {
+    Chclass[c + 1] = CH_IDSTART | CH_IDENT;
+    Chvalue[c + 1] = c - 'a' + 10;
+  }
+  for (c = 'A'; c <= 'F'; c++) {
+    Chclass[c + 1] = CH_IDSTART | CH_IDENT;
+    Chvalue[c + 1] = c - 'A' + 10;
+  }
+
+  Chtoken[';' + 1] = T_SEMI;
+  Chtoken['{' + 1] = T_LBRACE;
+  Chtoken['}' + 1] = T_RBRACE;
+  Chtoken['(' + 1] = T_LPAREN;
+  Chtoken[')' + 1] = T_RPAREN;
+  Chtoken['[' + 1] = T_LBRACKET;
+  Chtoken[']' + 1] = T_RBRACKET;
+  Chtoken['~' + 1] = T_INVERT;
+  Chtoken['^' + 1] = T_XOR;
+  Chtoken[',' + 1] = T_COMMA;
+  Chtoken['.' + 1] = T_DOT;
+  Chtoken[':' + 1] = T_COLON;
+  Chtoken['?' + 1] = T_QUESTION;
+}
+
+// The whole of the pre-processed input is read into
+// Inbuf and scanned with Inptr, which runs up to Inend.
+// *Inend is always a NUL, so the scanning loops below
+// can peek one character ahead without a bounds check
+/* 预处理后的全部输入被读入 Inbuf，用 Inptr 指针扫描到 Inend 为止。
+*Inend 总是 NUL，扫描循环可以不做越界检查直接向前看一个字符。*/
+enum { INBUFSIZE = 65536 };
+static char *Inbuf;
+static int Inbufsize;
+static char *Inptr;
+static char *Inend;
+static int Inendchar;		// Character replaced by the NUL at Inend
+
+// Read all of Infile into the input buffer
+// and close it. Return the number of bytes read
+int readinput(void) {
+  int len = 0, n;
+
+  if (Inbuf == NULL) {
+    initclass();
+    Inbufsize = INBUFSIZE;
+    Inbuf = (char *) malloc(Inbufsize);
+    if (Inbuf == NULL)
+      fatal("Unable to malloc the input buffer in readinput");
+  }
+
+  // Read in big chunks, doubling the buffer as it fills.
+  // Keep one byte spare for the NUL at the end
+  while (1) {
+    if (len == Inbufsize - 1) {
+      Inbufsize = Inbufsize * 2;
+      Inbuf = (char *) realloc(Inbuf, Inbufsize);
+      if (Inbuf == NULL)
+	fatal("Unable to grow the input buffer in readinput");
+    }
+    n = (int) fread(Inbuf + len, 1, Inbufsize - 1 - len, Infile);
+    if (n <= 0)
+      break;
+    len = len + n;
+  }
+  pclose(Infile);
+  Infile = NULL;
+
+  Inbuf[len] = 0;
+  Inptr = Inbuf;
+  Inend = Inbuf + len;
+  Inendchar = 0;
+  return (len);
+}
+
+// Copy len bytes of text into the input buffer
+void setinput(char *text, int len) {
+  if (Inbuf == NULL)
+    initclass();
+  if (Inbufsize < len + 1) {
+    Inbufsize = len + 1;
+    Inbuf = (char *) realloc(Inbuf, Inbufsize);
+    if (Inbuf == NULL)
+      fatal("Unable to grow the input buffer in setinput");
+  }
+  memcpy(Inbuf, text, len);
+  Inbuf[len] = 0;
+  Inptr = Inbuf;
+  Inend = Inbuf + len;
+  Inendchar = 0;
+}
+
+// Scan only the input buffer from start, which is at the
+// start of a line, up to end. The character at end is put
+// back when the range changes
+/*只扫描输入缓冲区中从 start（在一行的开头）到 end 的部分。end 处的字符换成 NUL，范围改变时再放回去。*/
+void inputrange(int start, int end) {
+  *Inend = (char) Inendchar;
+  Inptr = Inbuf + start;
+  Inend = Inbuf + end;
+  Inendchar = *Inend;
+  *Inend = 0;
+  Linestart = 1;
+  Putback = '\n';
 }
 
-// Get the next character from the input file.
-/*这段代码定义了一个函数 next，该函数用于从输入文件中获取下一个字符。*/
+// Return the input buffer
+char *inputbuf(void) {
+  return (Inbuf);
+}
+
+// Go back to the start of the input buffer
+void rewindinput(void) {
+  Inptr = Inbuf;
+}
+
+// Get the next character from the input buffer.
+/*这段代码定义了一个函数 next，该函数用于从输入缓冲区中获取下一个字符。*/
 static int next(void) {
   int c, l;
 
@@ -26,9 +167,14 @@ static int next(void) {
     Putback = 0;
     return (c);
   }
-  /*fgetc(Infile) 是标准C库函数中的一个用于从文件中读取字符的函数。它会读取文件流 Infile 的下一个字符，并返回该字符的 ASCII 值*/
-  c = fgetc(Infile);		// Read from input file
-  
+  /*从输入缓冲区中取出下一个字符，到达末尾时返回 EOF。*/
+  if (Inptr == Inend)		// Read from the input buffer
+    c = EOF;
+  else {
+    c = *Inptr & 0xff;
+    Inptr++;
+  }
+
   /*此循环检查是否在行的开头遇到了 #，表示可能是一个预处理语句。*/
   while (Linestart && c == '#') {	// We've hit a pre-processor statement
     /*如果是预处理语句，将 Linestart 设置为 0，表示不再位于行的开头。*/
@@ -49,10 +195,18 @@ static int next(void) {
 	Infilename = strdup(Text);	// save it. Then update the line num
       Line = l;
     }
-    /*循环读取输入文件 Infile 中的字符，直到遇到换行符为止。这样做的目的是跳过当前行的剩余部分，使文件指针指向下一行的开头。*/
-    while ((c = fgetc(Infile)) != '\n');	// Skip to the end of the line
+    /*跳过当前行的剩余部分，使 Inptr 指向下一行的开头。*/
+    while (Inptr < Inend && *Inptr != '\n')	// Skip to the end of the line
+      Inptr++;
+    if (Inptr < Inend)
+      Inptr++;
     /*获取下一行的第一个字符。*/
-    c = fgetc(Infile);		// and get the next character
+    if (Inptr == Inend)		// and get the next character
+      c = EOF;
+    else {
+      c = *Inptr & 0xff;
+      Inptr++;
+    }
     /*将 Linestart 标志设置为 1，表示现在位于新行的开头。*/
     Linestart = 1;		// Now back at the start of the line
   }
@@ -78,7 +232,7 @@ static int skip(void) {
   int c;
 
   c = next();
-  while (' ' == c || '\t' == c || '\n' == c || '\r' == c || '\f' == c) {
+  while (Chclass[c + 1] & CH_SPACE) {
     c = next();
   }
   return (c);
@@ -88,14 +242,14 @@ static int skip(void) {
 static int hexchar(void) {
   int c, h, n = 0, f = 0;
 
-  // Loop getting characters
-  while (isxdigit(c = next())) {
-    // Convert from char to int value
-    h = chrpos("0123456789abcdef", tolower(c));
-
+  // Loop getting characters and
+  // converting them to int values
+  c = next();
+  while ((h = Chvalue[c + 1]) >= 0) {
     // Add to running hex value
     n = n * 16 + h;
     f = 1;
+    c = next();
   }
 
   // We hit a non-hex character, put it back
@@ -153,7 +307,8 @@ static int scanch(void) {
       case '5':
       case '6':
       case '7':
-	for (i = c2 = 0; isdigit(c) && c < '8'; c = next()) {
+	for (i = c2 = 0; (Chclass[c + 1] & CH_DIGIT) && c < '8';
+	     c = next()) {
 	  if (++i > 3)
 	    break;
 	  c2 = c2 * 8 + (c - '0');
@@ -186,16 +341,25 @@ static int scanint(int c) {
       radix = 8;
 
   }
-  // Convert each character into an int value
-  while ((k = chrpos("0123456789abcdef", tolower(c))) >= 0) {
+  // If c isn't a digit, put it back
+  k = Chvalue[c + 1];
+  if (k < 0) {
+    putback(c);
+    return (val);
+  }
+
+  // Convert each character into an int value. The rest
+  // of the digits are read straight from the input buffer,
+  // and the character which ends them is left there
+  while (k >= 0) {
     if (k >= radix)
       fatalc("invalid digit in integer literal", c);
     val = val * radix + k;
-    c = next();
+    c = *Inptr & 0xff;
+    k = Chvalue[c + 1];
+    if (k >= 0)
+      Inptr++;
   }
-
-  // We hit a non-integer character, put it back.
-  putback(c);
   return (val);
 }
 
@@ -207,11 +371,21 @@ static int scanstr(char *buf) {
 
   // Loop while we have enough buffer space
   for (i = 0; i < TEXTLEN - 1; i++) {
-    // Get the next char and append to buf
-    // Return when we hit the ending double quote
-    if ((c = scanch()) == '"') {
-      buf[i] = 0;
-      return (i);
+    // Copy ordinary characters straight out of the input
+    // buffer. Leave escapes and newlines to scanch()
+    c = *Inptr & 0xff;
+    if (Putback == 0 && c != '"' && c != '\\' && c != '\n' && c != 0) {
+      Inptr++;
+    } else {
+      // Return when we hit the ending double quote.
+      // An escaped one, \", doesn't end the string
+      c = next();
+      if (c == '"') {
+	buf[i] = 0;
+	return (i);
+      }
+      putback(c);
+      c = scanch();
     }
     buf[i] = (char) c;
   }
@@ -222,107 +396,30 @@ static int scanstr(char *buf) {
 }
 
 // Scan an identifier from the input file and
-// store it in buf[]. Return the identifier's length
+// store it in buf[]. Return the identifier's length.
+// c has just come from next(), so nothing is put back:
+// the rest of the identifier is read straight from the
+// input buffer and the character which ends it is left there
 static int scanident(int c, char *buf, int lim) {
   int i = 0;
 
   // Allow digits, alpha and underscores
-  while (isalpha(c) || isdigit(c) || '_' == c) {
+  while (Chclass[c + 1] & CH_IDENT) {
     // Error if we hit the identifier length limit,
     // else append to buf[] and get next character
-    if (lim - 1 == i) {
+    if (lim - 1 == i)
       fatal("Identifier too long");
-    } else if (i < lim - 1) {
-      buf[i++] = (char) c;
-    }
-    c = next();
+    buf[i++] = (char) c;
+    c = *Inptr & 0xff;
+    if (Chclass[c + 1] & CH_IDENT)
+      Inptr++;
   }
 
-  // We hit a non-valid character, put it back.
   // NUL-terminate the buf[] and return the length
-  putback(c);
   buf[i] = '\0';
   return (i);
 }
 
-// Given a word from the input, return the matching
-// keyword token number or 0 if it's not a keyword.
-// Switch on the first letter so that we don't have
-// to waste time strcmp()ing against all the keywords.
-static int keyword(char *s) {
-  switch (*s) {
-    case 'b':
-      if (!strcmp(s, "break"))
-	return (T_BREAK);
-      break;
-    case 'c':
-      if (!strcmp(s, "case"))
-	return (T_CASE);
-      if (!strcmp(s, "char"))
-	return (T_CHAR);
-      if (!strcmp(s, "continue"))
-	return (T_CONTINUE);
-      break;
-    case 'd':
-      if (!strcmp(s, "default"))
-	return (T_DEFAULT);
-      break;
-    case 'e':
-      if (!strcmp(s, "else"))
-	return (T_ELSE);
-      if (!strcmp(s, "enum"))
-	return (T_ENUM);
-      if (!strcmp(s, "extern"))
-	return (T_EXTERN);
-      break;
-    case 'f':
-      if (!strcmp(s, "for"))
-	return (T_FOR);
-      break;
-    case 'i':
-      if (!strcmp(s, "if"))
-	return (T_IF);
-      if (!strcmp(s, "int"))
-	return (T_INT);
-      break;
-    case 'l':
-      if (!strcmp(s, "long"))
-	return (T_LONG);
-      break;
-    case 'r':
-      if (!strcmp(s, "return"))
-	return (T_RETURN);
-      break;
-    case 's':
-      if (!strcmp(s, "sizeof"))
-	return (T_SIZEOF);
-      if (!strcmp(s, "static"))
-	return (T_STATIC);
-      if (!strcmp(s, "struct"))
-	return (T_STRUCT);
-      if (!strcmp(s, "switch"))
-	return (T_SWITCH);
-      break;
-    case 't':
-      if (!strcmp(s, "typedef"))
-	return (T_TYPEDEF);
-      break;
-    case 'u':
-      if (!strcmp(s, "union"))
-	return (T_UNION);
-      break;
-    case 'v':
-      if (!strcmp(s, "void"))
-	return (T_VOID);
-      break;
-    case 'w':
-      if (!strcmp(s, "while"))
-	return (T_WHILE);
-      break;
-  }
-  return (0);
-}
-
 // List of token strings, for debugging purposes
 char *Tstring[] = {
   "EOF", "=", "+=", "-=", "*=", "/=", "%=",
@@ -339,10 +436,55 @@ char *Tstring[] = {
   "->", ":"
 };
 
+// Keywords by their perfect hash. The multipliers in
+// keyword() were found by a search so that each keyword
+// in Tstring[] lands in a slot of its own
+/*按完美哈希排列的关键字。keyword() 中的乘数是搜索出来的，使 Tstring[] 中的每个关键字都落在不同的槽中。*/
+static int Kwtoken[32] = {
+  0, 0, T_EXTERN, 0, T_LONG, 0, T_IF, 0,
+  T_CHAR, T_BREAK, 0, T_DEFAULT, T_CONTINUE, T_WHILE, T_SIZEOF, T_INT,
+  T_CASE, 0, T_STRUCT, T_TYPEDEF, T_ELSE, 0, T_STATIC, 0,
+  T_VOID, T_UNION, T_RETURN, 0, T_ENUM, 0, T_SWITCH, T_FOR
+};
+
+// Given a word from the input and its length, return
+// the matching keyword token number or 0 if it's not
+// a keyword. Hash the word to the one keyword it could
+// be, and strcmp() against that
+static int keyword(char *s, int len) {
+  int h, tokentype;
+
+  // All keywords have from 2 to 8 letters
+  if (len < 2 || len > 8)
+    return (0);
+  h = (s[0] * 4 + s[1] * 20 + s[len - 1] * 28 + len) & 31;
+  tokentype = Kwtoken[h];
+  if (tokentype != 0 && !strcmp(s, Tstring[tokentype]))
+    return (tokentype);
+  return (0);
+}
+
+// Check that each keyword in Tstring[] hashes back to its
+// own token. Kwtoken[] and the multipliers in keyword() are
+// worked out by hand, and a new keyword which lands in a
+// taken slot would otherwise be scanned as an identifier
+/*检查 Tstring[] 中的每个关键字都能哈希回它自己的标记。Kwtoken[] 和 keyword() 中的乘数是手工算出的，
+新加的关键字如果落在已被占用的槽中，就会被当作标识符。*/
+void checkkeywords(void) {
+  int t;
+
+  for (t = T_VOID; t <= T_STATIC; t++)
+    if (keyword(Tstring[t], (int) strlen(Tstring[t])) != t) {
+      fprintf(stderr, "keyword() doesn't find the keyword %s\n",
+	      Tstring[t]);
+      exit(1);
+    }
+}
+
 // Scan and return the next token found in the input.
 // Return 1 if token valid, 0 if no tokens left.
 int scan(struct token *t) {
-  int c, tokentype;
+  int c, tokentype, len;
 
   // If we have a lookahead token, return this token
   if (Peektoken.token != 0) {
@@ -355,6 +497,14 @@ int scan(struct token *t) {
   // Skip whitespace
   c = skip();
 
+  // Characters which are a token by themselves
+  // come straight from the table
+  if ((tokentype = Chtoken[c + 1]) != 0) {
+    t->token = tokentype;
+    t->tokstr = Tstring[tokentype];
+    return (1);
+  }
+
   // Determine the token based on
   // the input character
   switch (c) {
@@ -378,7 +528,7 @@ int scan(struct token *t) {
 	t->token = T_ARROW;
       } else if (c == '=') {
 	t->token = T_ASMINUS;
-      } else if (isdigit(c)) {	// Negative int literal
+      } else if (Chclass[c + 1] & CH_DIGIT) {	// Negative int literal
       /*如果后续字符是数字，则说明这是一个负整数字面量（Negative Integer Literal）。
       使用 scanint 函数扫描整数，由于前面的字符是减号，因此将整数值取负。
       将标记类型设置为 T_INTLIT 表示整数面量。*/
@@ -413,45 +563,6 @@ int scan(struct token *t) {
 	t->token = T_MOD;
       }
       break;
-    case ';':
-      t->token = T_SEMI;
-      break;
-    case '{':
-      t->token = T_LBRACE;
-      break;
-    case '}':
-      t->token = T_RBRACE;
-      break;
-    case '(':
-      t->token = T_LPAREN;
-      break;
-    case ')':
-      t->token = T_RPAREN;
-      break;
-    case '[':
-      t->token = T_LBRACKET;
-      break;
-    case ']':
-      t->token = T_RBRACKET;
-      break;
-    case '~':
-      t->token = T_INVERT;
-      break;
-    case '^':
-      t->token = T_XOR;
-      break;
-    case ',':
-      t->token = T_COMMA;
-      break;
-    case '.':
-      t->token = T_DOT;
-      break;
-    case ':':
-      t->token = T_COLON;
-      break;
-    case '?':
-      t->token = T_QUESTION;
-      break;
     case '=':
       if ((c = next()) == '=') {
 	t->token = T_EQ;
@@ -521,17 +632,17 @@ int scan(struct token *t) {
     default:
       // If it's a digit, scan the
       // literal integer value in
-      if (isdigit(c)) {
+      if (Chclass[c + 1] & CH_DIGIT) {
 	t->intvalue = scanint(c);/*数字的值*/
 	t->token = T_INTLIT;
 	break;
-      } else if (isalpha(c) || '_' == c) {
+      } else if (Chclass[c + 1] & CH_IDSTART) {
 	// Read in a keyword or identifier
   /*调用 scanident(c, Text, TEXTLEN) 函数读取关键字或标识符的内容，并存储在 Text 中。*/
-	scanident(c, Text, TEXTLEN);
+	len = scanident(c, Text, TEXTLEN);
 
 	// If it's a recognised keyword, return that token
-	if ((tokentype = keyword(Text)) != 0) {
+	if ((tokentype = keyword(Text, len)) != 0) {
 	  t->token = tokentype;
 	  break;
 	}
@@ -0,0 +1,374 @@
+#include "defs.h"
+#include "data.h"
+#include "decl.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+// Compile server
+// Copyright (c) 2019 Warren Toomey, GPL3
+
+// cwj --server socket listens on a Unix socket. cwj --connect
+// socket [options] file ... sends its working directory and its
+// arguments to the server, which runs the compile in a worker
+// process. The worker's stdout and stderr go back down the
+// connection, followed by one byte with its exit status.
+//
+// Most files start with the same #includes. The server keeps
+// the declarations from the last set of headers it has seen in
+// its symbol table, and each worker inherits them. When a file
+// starts with the same headers, the worker skips them and only
+// parses the rest of the file. The headers are all the text
+// before the first line of the file's own code, and they are
+// compared without cpp's line markers. When they are new, the
+// worker parses them itself and, if they made no code, leaves
+// their text in a file for the server to parse once the
+// request is done.
+/*cwj --server socket 在 Unix 套接字上监听。cwj --connect socket [选项] 文件 ... 把当前目录和
+参数发给服务器，服务器在工作进程中编译。工作进程的 stdout 和 stderr 通过连接发回去，
+最后是一个字节的退出状态。
+
+大多数文件开头都包含同样的头文件。服务器在符号表中保留最近见过的一组头文件的声明，
+每个工作进程都继承它们。文件开头的头文件相同时，工作进程跳过它们，只分析文件的其余部分。
+头文件是文件自己的第一行代码之前的全部文本，比较时不算 cpp 的行标记。遇到新的头文件时，
+工作进程自己分析它们，如果没有生成代码，就把它们的文本留在一个文件里，
+请求完成后由服务器分析。*/
+
+enum {
+  SOCKPATHLEN = 108			// Longest path of a Unix socket
+};
+
+static char *Warmtext;		// Header text whose declarations are in
+static int Warmlen;		// the symbol table, without line markers
+static char *Headtext;		// The same for the file being compiled
+static int Headlen;
+static char *Notepath;		// File where a worker leaves new header text
+
+// Put the address of the Unix socket at path into addr and
+// return its length. The address is the family, AF_UNIX,
+// in two bytes and then the NUL-terminated path
+static int sockaddr(char *addr, char *path) {
+  int len = (int) strlen(path);
+
+  if (len >= SOCKPATHLEN)
+    fatals("Socket path is too long", path);
+  addr[0] = (char) AF_UNIX;
+  addr[1] = 0;
+  memcpy(addr + 2, path, len + 1);
+  return (len + 3);
+}
+
+// Make a new Unix socket
+static int newsocket(void) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd == -1) {
+    fprintf(stderr, "Unable to make a socket: %s\n", strerror(errno));
+    exit(1);
+  }
+  return (fd);
+}
+
+// Read everything from fd up to the end of file into a new
+// NUL-terminated buffer. Set *len to the number of bytes read
+static char *readall(int fd, int *len) {
+  int size = TEXTLEN, got = 0;
+  long n;
+  char *buf = (char *) malloc(size);
+
+  while (1) {
+    if (got == size - 1) {
+      size = size * 2;
+      buf = (char *) realloc(buf, size);
+    }
+    if (buf == NULL)
+      fatal("Unable to malloc in readall()");
+    n = read(fd, buf + got, size - 1 - got);
+    if (n <= 0)
+      break;
+    got = got + (int) n;
+  }
+  buf[got] = 0;
+  *len = got;
+  return (buf);
+}
+
+// Return true if the line marker at s names the file
+static int markernames(char *s, char *filename) {
+  while (*s != '"' && *s != '\n' && *s != 0)
+    s++;
+  if (*s != '"')
+    return (0);
+  s++;
+  while (*filename != 0 && *s == *filename) {
+    s++;
+    filename++;
+  }
+  return (*filename == 0 && *s == '"');
+}
+
+// Given the len bytes of pre-processed text of filename in buf,
+// return the length of the headers at its start: the text up
+// to the line marker before the first line of the file's own
+// code. Keep the lines of the headers which aren't line markers
+// or blank in Headtext. Return 0 if there are no headers. If
+// filename is NULL, the whole of buf is headers
+int headerprefix(char *filename, char *buf, int len) {
+  int i = 0, start, j, marker = 0, infile = 0, blank;
+
+  free(Headtext);
+  Headtext = (char *) malloc(len + 1);
+  if (Headtext == NULL)
+    fatal("Unable to malloc in headerprefix()");
+  Headlen = 0;
+
+  while (i < len) {
+    // Find the end of this line
+    start = i;
+    while (i < len && buf[i] != '\n')
+      i++;
+    if (i < len)
+      i++;
+
+    // A line marker says which file the lines after it are from
+    if (buf[start] == '#') {
+      marker = start;
+      infile = filename != NULL && markernames(buf + start, filename);
+    } else {
+      blank = 1;
+      for (j = start; j < i; j++)
+	if (buf[j] != ' ' && buf[j] != '\t' && buf[j] != '\n')
+	  blank = 0;
+      if (!blank) {
+	// The first code in the file itself ends the headers
+	if (infile) {
+	  if (Headlen == 0)
+	    return (0);
+	  return (marker);
+	}
+	memcpy(Headtext + Headlen, buf + start, i - start);
+	Headlen = Headlen + i - start;
+      }
+    }
+  }
+  if (filename == NULL)
+    return (len);
+  return (0);
+}
+
+// Return the header text kept by headerprefix()
+// and set *len to its length
+char *headertext(int *len) {
+  *len = Headlen;
+  return (Headtext);
+}
+
+// Return true if the symbol table already has the declarations
+// from the headers found by headerprefix(). They can only be
+// used once, as the rest of the file adds to the symbol table
+int serverwarm(void) {
+  int i;
+
+  if (Warmtext == NULL || Warmlen != Headlen)
+    return (0);
+  for (i = 0; i < Headlen; i++)
+    if (Warmtext[i] != Headtext[i])
+      return (0);
+  Warmtext = NULL;
+  return (1);
+}
+
+// Leave the text of the headers for the server. The file
+// is renamed into place, so the server never sees half of it
+static void leavenote(void) {
+  char tmpname[TEXTLEN];
+  FILE *fp;
+
+  snprintf(tmpname, TEXTLEN, "%s.%d", Notepath, getpid());
+  if ((fp = fopen(tmpname, "w")) == NULL)
+    return;
+  fwrite(Headtext, 1, Headlen, fp);
+  fclose(fp);
+  rename(tmpname, Notepath);
+}
+
+// Parse the declarations in the headers, which are the first
+// prefix bytes of the input. If they made no code, leave their
+// text for the server so that it has them ready next time
+void serverparse(int prefix) {
+  long before = cgoutbytes();
+
+  inputrange(0, prefix);
+  Line = 1;
+  scan(&Token);
+  Peektoken.token = 0;
+  global_declarations();
+  if (cgoutbytes() == before)
+    leavenote();
+}
+
+// If a worker left the text of some new headers, parse it
+// so that its declarations are ready for the next request
+static void warmup(void) {
+  FILE *fp;
+  char *text;
+  int len;
+
+  if ((fp = fopen(Notepath, "r")) == NULL)
+    return;
+  text = readall(fileno(fp), &len);
+  fclose(fp);
+  unlink(Notepath);
+
+  free(Warmtext);
+  Warmtext = NULL;
+  clear_symtable();
+  freeinline();
+  resetlabels();
+  setinput(text, len);
+  Infilename = Notepath;
+  Line = 1;
+  Linestart = 1;
+  Putback = '\n';
+  scan(&Token);
+  Peektoken.token = 0;
+  global_declarations();
+  Warmtext = text;
+  Warmlen = len;
+}
+
+// Run the compile sent down the connection conn, with stdout
+// and stderr going back down it. Return its exit status
+static int dorequest(int conn) {
+  char *req, *s;
+  char **args;
+  int len, n, i;
+
+  // The request is the working directory and then the
+  // arguments, each one NUL-terminated
+  req = readall(conn, &len);
+  n = 0;
+  for (i = 0; i < len; i++)
+    if (req[i] == 0)
+      n++;
+
+  fflush(stdout);
+  fflush(stderr);
+  dup2(conn, 1);
+  dup2(conn, 2);
+  if (n == 0 || chdir(req) == -1) {
+    fprintf(stderr, "Bad directory in compile request: %s\n", req);
+    return (1);
+  }
+
+  // Make the argument list, with our own name first
+  args = (char **) malloc((n + 1) * sizeof(char *));
+  if (args == NULL)
+    fatal("Unable to malloc in dorequest()");
+  args[0] = "cwj";
+  s = req + strlen(req) + 1;
+  for (i = 1; i < n; i++) {
+    args[i] = s;
+    s = s + strlen(s) + 1;
+  }
+  args[n] = NULL;
+  Serving = 1;
+  return (runcwj(n, args));
+}
+
+// Run a compile server on the Unix socket at path. It handles
+// one request at a time, each in a new worker process
+int serve(char *path) {
+  char addr[SOCKPATHLEN + 2];
+  char notename[TEXTLEN];
+  int fd, conn, pid, status, len;
+  char c;
+
+  fd = newsocket();
+  len = sockaddr(addr, path);
+  unlink(path);
+  if (bind(fd, (void *) addr, len) == -1 || listen(fd, 64) == -1) {
+    fprintf(stderr, "Unable to listen on %s: %s\n", path, strerror(errno));
+    exit(1);
+  }
+  snprintf(notename, TEXTLEN, "%s.warm", path);
+  Notepath = strdup(notename);
+  unlink(Notepath);
+
+  while (1) {
+    conn = accept(fd, NULL, NULL);
+    if (conn == -1)
+      continue;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+      close(fd);
+      exit(dorequest(conn));
+    }
+
+    // Send back the worker's exit status, or 1 if it didn't
+    // exit normally. The client may have gone, e.g. after a
+    // Ctrl-C, so don't let a broken connection kill the server
+    status = 256;
+    if (pid != -1)
+      waitpid(pid, &status, 0);
+    c = (char) ((status >> 8) & 0xff);
+    if ((status & 0x7f) != 0)
+      c = 1;
+    if (send(conn, &c, 1, MSG_NOSIGNAL) != 1)
+      fprintf(stderr, "Unable to send the exit status: %s\n",
+	      strerror(errno));
+    close(conn);
+    warmup();
+  }
+  return (0);
+}
+
+// Send the NUL-terminated string s down fd
+static void sendstring(int fd, char *s) {
+  write(fd, s, strlen(s) + 1);
+}
+
+// Send a compile to the server on the Unix socket at path: our
+// working directory and the arguments argv[1] to argv[argc-1].
+// Copy what comes back to stdout, apart from the last byte
+// which is the compile's exit status. Return that status
+int client(char *path, int argc, char **argv) {
+  char addr[SOCKPATHLEN + 2];
+  char buf[TEXTLEN];
+  int fd, len, i, held = -1;
+  long n;
+
+  fd = newsocket();
+  len = sockaddr(addr, path);
+  if (connect(fd, (void *) addr, len) == -1) {
+    fprintf(stderr, "Unable to connect to the cwj server on %s: %s\n",
+	    path, strerror(errno));
+    exit(1);
+  }
+  if (getcwd(buf, TEXTLEN) == NULL)
+    fatal("Unable to get the working directory");
+  sendstring(fd, buf);
+  for (i = 1; i < argc; i++)
+    sendstring(fd, argv[i]);
+  shutdown(fd, SHUT_WR);
+
+  // Hold back the last byte received, as it may be the status
+  while (1) {
+    n = read(fd, buf, TEXTLEN);
+    if (n <= 0)
+      break;
+    if (held != -1)
+      putchar(held);
+    fwrite(buf, 1, n - 1, stdout);
+    held = buf[n - 1] & 0xff;
+  }
+  close(fd);
+  if (held == -1) {
+    fprintf(stderr, "No answer from the cwj server on %s\n", path);
+    return (1);
+  }
+  return (held);
+}
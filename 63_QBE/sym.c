@@ -23,6 +23,171 @@ void appendsym(struct symtable **head, struct symtable **tail,
   node->next = NULL;
 }
 
+// Sizes of the name table and the initial size
+// of each symbol hash index. Both are powers of two
+enum {
+  NAMEHASHSIZE = 16384,
+  NAMEHASHMASK = 16383,
+  SYMHASHSIZE = 64
+};
+
+// The table of interned names, and the hash indexes
+// over the symbol lists. Parameter lists are short and
+// are still searched linearly. The symbols and the
+// interned names live in an arena which is reset when
+// we start on a new input file
+static struct arena Symarena;
+static struct intern **Namehash;
+static struct symhash Globhash;
+static struct symhash Loclhash;
+static struct symhash Membhash;
+static struct symhash Structhash;
+static struct symhash Unionhash;
+static struct symhash Enumhash;
+static struct symhash Typehash;
+
+// Hash a name for the name table
+/* 计算名字的哈希值，保持在 24 位以内以免溢出 */
+static int strhash(char *s) {
+  int h = 0;
+
+  while (*s) {
+    h = (h * 33 + *s) & 0xffffff;
+    s++;
+  }
+  return (h);
+}
+
+// Return the interned copy of s, or NULL if
+// s has never been interned
+static char *findname(char *s) {
+  struct intern *n;
+
+  if (Namehash == NULL)
+    return (NULL);
+  for (n = Namehash[strhash(s) & NAMEHASHMASK]; n != NULL; n = n->next)
+    if (!strcmp(s, n->str))
+      return (n->str);
+  return (NULL);
+}
+
+// Return the interned copy of s, adding it to
+// the name table if this is the first time we see it
+/* 返回 s 的驻留副本，第一次出现时把它加入名字表 */
+char *internname(char *s) {
+  struct intern *n;
+  int h;
+
+  if (Namehash == NULL) {
+    Namehash =
+      (struct intern **) calloc(NAMEHASHSIZE, sizeof(struct intern *));
+    if (Namehash == NULL)
+      fatal("Unable to malloc the name table in internname");
+  }
+
+  h = strhash(s) & NAMEHASHMASK;
+  for (n = Namehash[h]; n != NULL; n = n->next)
+    if (!strcmp(s, n->str))
+      return (n->str);
+
+  n = (struct intern *) arenaalloc(&Symarena, sizeof(struct intern));
+  n->str = arenastrdup(&Symarena, s);
+  n->next = Namehash[h];
+  Namehash[h] = n;
+  return (n->str);
+}
+
+// Given an interned name, return its bucket in
+// a hash index with size buckets
+static int namebucket(char *name, int size) {
+  long x;
+  int h;
+
+  x = (long) name;
+  x = x ^ (x >> 9);
+  h = (int) (x >> 4);
+  return (h & (size - 1));
+}
+
+// Add a symbol to the front of its bucket in a hash index
+static void hashsym(struct symhash *h, struct symtable *sym) {
+  int b;
+
+  // Anonymous structs and unions can't be looked up
+  if (sym->name == NULL)
+    return;
+  b = namebucket(sym->name, h->size);
+  sym->hnext = h->bucket[b];
+  h->bucket[b] = sym;
+  h->count = h->count + 1;
+}
+
+// Empty a hash index, keeping its buckets
+static void clearsymhash(struct symhash *h) {
+  int i;
+
+  for (i = 0; i < h->size; i++)
+    h->bucket[i] = NULL;
+  h->count = 0;
+}
+
+// Rebuild a hash index from the list that it mirrors.
+// The list is walked in order, so later symbols end
+// up in front of earlier ones with the same name
+static void rebuildsymhash(struct symhash *h, struct symtable *list) {
+  clearsymhash(h);
+  for (; list != NULL; list = list->next)
+    hashsym(h, list);
+}
+
+// Add a symbol, which has just been appended to list,
+// to the hash index over that list. Double the number
+// of buckets and rebuild the index when it gets full
+/* 把刚加入 list 的符号加入对应的哈希索引，装满时把桶数翻倍并重建索引 */
+static void addsymhash(struct symhash *h, struct symtable *list,
+		       struct symtable *sym) {
+  if (h->count < h->size) {
+    hashsym(h, sym);
+    return;
+  }
+
+  if (h->bucket != NULL)
+    free(h->bucket);
+  if (h->size == 0)
+    h->size = SYMHASHSIZE;
+  else
+    h->size = h->size * 2;
+  h->bucket =
+    (struct symtable **) calloc(h->size, sizeof(struct symtable *));
+  if (h->bucket == NULL)
+    fatal("Unable to malloc a symbol hash index in addsymhash");
+  rebuildsymhash(h, list);
+}
+
+// Size a hash index for the symbols in list and rebuild it
+static void resizesymhash(struct symhash *h, struct symtable *list) {
+  struct symtable *sym;
+  int n = 0;
+
+  for (sym = list; sym != NULL; sym = sym->next)
+    n++;
+  if (h->size == 0)
+    h->size = SYMHASHSIZE;
+  if (h->size <= n) {
+    while (h->size <= n)
+      h->size = h->size * 2;
+    if (h->bucket != NULL)
+      free(h->bucket);
+    h->bucket = NULL;
+  }
+  if (h->bucket == NULL)
+    h->bucket =
+      (struct symtable **) calloc(h->size, sizeof(struct symtable *));
+  if (h->bucket == NULL)
+    fatal("Unable to malloc a symbol hash index in resizesymhash");
+  rebuildsymhash(h, list);
+}
+
 // Create a symbol node to be added to a symbol table list.
 // Set up the node's:
 // + type: char, int etc.
@@ -46,15 +211,15 @@ struct symtable *newsym(char *name, int type, struct symtable *ctype,
 			int stype, int class, int nelems, int posn) {
 
   // Get a new node
-  struct symtable *node = (struct symtable *) malloc(sizeof(struct symtable));
-  if (node == NULL)
-    fatal("Unable to malloc a symbol table node in newsym");
+  struct symtable *node =
+    (struct symtable *) arenaalloc(&Symarena, sizeof(struct symtable));
+  Nsymbols++;
 
   // Fill in the values
   if (name == NULL)
     node->name = NULL;
   else
-    node->name = strdup(name);
+    node->name = internname(name);
   node->type = type;
   node->ctype = ctype;
   node->stype = stype;
@@ -72,6 +237,9 @@ struct symtable *newsym(char *name, int type, struct symtable *ctype,
   node->next = NULL;
   node->member = NULL;
   node->initlist = NULL;
+  node->hnext = NULL;
+  node->st_defer = 0;
+  node->st_offset = 0;
   return (node);
 }
 
@@ -84,6 +252,7 @@ struct symtable *addglob(char *name, int type, struct symtable *ctype,
   if (type == P_STRUCT || type == P_UNION)
     sym->size = ctype->size;
   appendsym(&Globhead, &Globtail, sym);
+  addsymhash(&Globhash, Globhead, sym);
   return (sym);
 }
 
@@ -96,6 +265,7 @@ struct symtable *addlocl(char *name, int type, struct symtable *ctype,
   if (type == P_STRUCT || type == P_UNION)
     sym->size = ctype->size;
   appendsym(&Loclhead, &Locltail, sym);
+  addsymhash(&Loclhash, Loclhead, sym);
   return (sym);
 }
 
@@ -117,6 +287,7 @@ struct symtable *addmemb(char *name, int type, struct symtable *ctype,
   if (type == P_STRUCT || type == P_UNION)
     sym->size = ctype->size;
   appendsym(&Membhead, &Membtail, sym);
+  addsymhash(&Membhash, Membhead, sym);
   return (sym);
 }
 
@@ -126,6 +297,7 @@ struct symtable *addstruct(char *name) {
   // 创建一个新的结构体符号表节点（struct symtable）
   struct symtable *sym = newsym(name, P_STRUCT, NULL, 0, C_STRUCT, 0, 0);
   appendsym(&Structhead, &Structtail, sym);
+  addsymhash(&Structhash, Structhead, sym);
   return (sym);
 }
 
@@ -134,6 +306,7 @@ struct symtable *addstruct(char *name) {
 struct symtable *addunion(char *name) {
   struct symtable *sym = newsym(name, P_UNION, NULL, 0, C_UNION, 0, 0);
   appendsym(&Unionhead, &Uniontail, sym);
+  addsymhash(&Unionhash, Unionhead, sym);
   return (sym);
 }
 
@@ -143,6 +316,7 @@ struct symtable *addunion(char *name) {
 struct symtable *addenum(char *name, int class, int value) {
   struct symtable *sym = newsym(name, P_INT, NULL, 0, class, 0, value);
   appendsym(&Enumhead, &Enumtail, sym);
+  addsymhash(&Enumhash, Enumhead, sym);
   return (sym);
 }
 
@@ -150,14 +324,16 @@ struct symtable *addenum(char *name, int class, int value) {
 struct symtable *addtypedef(char *name, int type, struct symtable *ctype) {
   struct symtable *sym = newsym(name, type, ctype, 0, C_TYPEDEF, 0, 0);
   appendsym(&Typehead, &Typetail, sym);
+  addsymhash(&Typehash, Typehead, sym);
   return (sym);
 }
 
 // Search for a symbol in a specific list.
 // Return a pointer to the found node or NULL if not found.
-// If class is not zero, also match on the given class
+// If class is not zero, also match on the given class.
+// The name s must already be interned
 /*
-char *s: 这是一个字符串，表示要查找的符号的名称（标识符）。函数将遍历符号表链表，比较每个符号表节点的名称与这个参数是否匹配。
+char *s: 这是一个字符串，表示要查找的符号的名称（标识符）。必须是驻留后的名字，函数直接比较指针。
 struct symtable *list: 这是一个指向符号表链表的头部的指针。函数将在这个链表中查找符号。
 int class: 这是一个整数，表示符号表节点的存储类别。如果 class 不为零，
 函数将在查找时同时匹配给定的存储类别。如果 class 为零，函数将忽略存储类别，仅匹配符号名称。
@@ -165,16 +341,38 @@ int class: 这是一个整数，表示符号表节点的存储类别。如果 cl
 static struct symtable *findsyminlist(char *s, struct symtable *list,
 				      int class) {
   for (; list != NULL; list = list->next)
-    if ((list->name != NULL) && !strcmp(s, list->name))
+    if (list->name == s)
       if (class == 0 || class == list->class)
 	      return (list);
   return (NULL);
 }
 
+// Search for a symbol in a hash index, with the same
+// rules as findsyminlist(). The bucket is newest first,
+// so keep the last match to return the same symbol as
+// a walk of the list would
+/* 在哈希索引中查找符号。桶中较新的符号在前，所以取最后一个匹配，与遍历链表的结果一致。*/
+static struct symtable *findsyminhash(char *s, struct symhash *h,
+				      int class) {
+  struct symtable *sym, *found = NULL;
+
+  if (h->count == 0)
+    return (NULL);
+  for (sym = h->bucket[namebucket(s, h->size)]; sym != NULL;
+       sym = sym->hnext)
+    if (sym->name == s)
+      if (class == 0 || class == sym->class)
+	found = sym;
+  return (found);
+}
+
 // Determine if the symbol s is in the global symbol table.
 // Return a pointer to the found node or NULL if not found.
 struct symtable *findglob(char *s) {
-  return (findsyminlist(s, Globhead, 0));
+  s = findname(s);
+  if (s == NULL)
+    return (NULL);
+  return (findsyminhash(s, &Globhash, 0));
 }
 
 // Determine if the symbol s is in the local symbol table.
@@ -187,13 +385,18 @@ struct symtable *findglob(char *s) {
 struct symtable *findlocl(char *s) {
   struct symtable *node;
 
+  // A name we have never seen can't be a symbol
+  s = findname(s);
+  if (s == NULL)
+    return (NULL);
+
   // Look for a parameter if we are in a function's body
   if (Functionid) {
     node = findsyminlist(s, Functionid->member, 0);
     if (node)
       return (node);
   }
-  return (findsyminlist(s, Loclhead, 0));
+  return (findsyminhash(s, &Loclhash, 0));
 }
 
 // Determine if the symbol s is in the symbol table.
@@ -202,6 +405,11 @@ struct symtable *findlocl(char *s) {
 struct symtable *findsymbol(char *s) {
   struct symtable *node;
 
+  // A name we have never seen can't be a symbol
+  s = findname(s);
+  if (s == NULL)
+    return (NULL);
+
   // Look for a parameter if we are in a function's body
   if (Functionid) {
     node = findsyminlist(s, Functionid->member, 0);
@@ -209,55 +417,72 @@ struct symtable *findsymbol(char *s) {
       return (node);
   }
   // Otherwise, try the local and global symbol lists
-  node = findsyminlist(s, Loclhead, 0);
+  node = findsyminhash(s, &Loclhash, 0);
   if (node)
     return (node);
-  return (findsyminlist(s, Globhead, 0));
+  return (findsyminhash(s, &Globhash, 0));
+}
+
+// Search one of the hashed lists for the name s
+static struct symtable *findhashed(char *s, struct symhash *h, int class) {
+  s = findname(s);
+  if (s == NULL)
+    return (NULL);
+  return (findsyminhash(s, h, class));
 }
 
 // Find a member in the member list
 // Return a pointer to the found node or NULL if not found.
 
 struct symtable *findmember(char *s) {
-  return (findsyminlist(s, Membhead, 0));
+  return (findhashed(s, &Membhash, 0));
 }
 
 // Find a struct in the struct list
 // Return a pointer to the found node or NULL if not found.
 /*在结构体列表中找当前结构体*/
 struct symtable *findstruct(char *s) {
-  return (findsyminlist(s, Structhead, 0));
+  return (findhashed(s, &Structhash, 0));
 }
 
 // Find a struct in the union list
 // Return a pointer to the found node or NULL if not found.
 /*在联合体列表中找到当前的联合体*/
 struct symtable *findunion(char *s) {
-  return (findsyminlist(s, Unionhead, 0));
+  return (findhashed(s, &Unionhash, 0));
 }
 
 // Find an enum type in the enum list
 // Return a pointer to the found node or NULL if not found.
 struct symtable *findenumtype(char *s) {
-  return (findsyminlist(s, Enumhead, C_ENUMTYPE));
+  return (findhashed(s, &Enumhash, C_ENUMTYPE));
 }
 
 // Find an enum value in the enum list
 // Return a pointer to the found node or NULL if not found.
 struct symtable *findenumval(char *s) {
-  return (findsyminlist(s, Enumhead, C_ENUMVAL));
+  return (findhashed(s, &Enumhash, C_ENUMVAL));
 }
 
 // Find a type in the tyedef list
 // Return a pointer to the found node or NULL if not found.
 /*findtypedef 函数的作用是在 typedef 列表中查找指定名称的类型，并返回找到的类型的符号表节点指针。如果找不到匹配的类型，返回 NULL。*/
 struct symtable *findtypedef(char *s) {
-  return (findsyminlist(s, Typehead, 0));
+  return (findhashed(s, &Typehash, 0));
 }
 
 // Reset the contents of the symbol table
 //清空符号表
 void clear_symtable(void) {
+  int i;
+
+  // Forget the interned names, then
+  // free all the symbols and names
+  if (Namehash != NULL)
+    for (i = 0; i < NAMEHASHSIZE; i++)
+      Namehash[i] = NULL;
+  arenareset(&Symarena);
+
   Globhead = Globtail = NULL;
   Loclhead = Locltail = NULL;
   Parmhead = Parmtail = NULL;
@@ -266,6 +491,38 @@ void clear_symtable(void) {
   Unionhead = Uniontail = NULL;
   Enumhead = Enumtail = NULL;
   Typehead = Typetail = NULL;
+  clearsymhash(&Globhash);
+  clearsymhash(&Loclhash);
+  clearsymhash(&Membhash);
+  clearsymhash(&Structhash);
+  clearsymhash(&Unionhash);
+  clearsymhash(&Enumhash);
+  clearsymhash(&Typehash);
+}
+
+// Return the last symbol in a list
+static struct symtable *lastsym(struct symtable *list) {
+  if (list != NULL)
+    while (list->next != NULL)
+      list = list->next;
+  return (list);
+}
+
+// The global symbol lists have been filled in from a
+// precompiled header. Find their tails and rebuild
+// their hash indexes
+/* 全局符号链表已经从预编译头文件中填好。找到它们的尾部并重建哈希索引。*/
+void relinksymtable(void) {
+  Globtail = lastsym(Globhead);
+  Structtail = lastsym(Structhead);
+  Uniontail = lastsym(Unionhead);
+  Enumtail = lastsym(Enumhead);
+  Typetail = lastsym(Typehead);
+  resizesymhash(&Globhash, Globhead);
+  resizesymhash(&Structhash, Structhead);
+  resizesymhash(&Unionhash, Unionhead);
+  resizesymhash(&Enumhash, Enumhead);
+  resizesymhash(&Typehash, Typehead);
 }
 
 // Clear all the entries in the local symbol table
@@ -273,6 +530,14 @@ void freeloclsyms(void) {
   Loclhead = Locltail = NULL;
   Parmhead = Parmtail = NULL;
   Functionid = NULL;
+  clearsymhash(&Loclhash);
+}
+
+// Clear the temporary member list once its
+// members have been given to a struct or union
+void freemembsyms(void) {
+  Membhead = Membtail = NULL;
+  clearsymhash(&Membhash);
 }
 
 // Remove all static symbols from the global symbol table
@@ -307,6 +572,9 @@ void freestaticsyms(void) {
   // Point prev at g before we move up to the next node
   //prev是联系前一个节点。
   prev = g;
+
+  // Bring the global hash index back in line with the list
+  rebuildsymhash(&Globhash, Globhead);
 }
 
 // Dump a single symbol
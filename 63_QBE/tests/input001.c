@@ -0,0 +1,18 @@
+#include <stdio.h>
+
+// A store through one pointer parameter
+// can change what the other points at
+int alias1(int *p, int *q) {
+  *p = 1;
+  *q = 2;
+  return (*p);
+}
+
+int main() {
+  int a;
+  int b;
+
+  printf("%d\n", alias1(&a, &a));
+  printf("%d\n", alias1(&a, &b));
+  return (0);
+}
@@ -0,0 +1,18 @@
+#include <stdio.h>
+
+// A store through a pointer to a
+// local changes the local
+int addrl(void) {
+  int x;
+  int *p;
+
+  x = 3;
+  p = &x;
+  *p = 9;
+  return (x);
+}
+
+int main() {
+  printf("%d\n", addrl());
+  return (0);
+}
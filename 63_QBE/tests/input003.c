@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+int g;
+
+// A store through a pointer
+// can change a global
+int viaptr(int *p) {
+  g = 1;
+  *p = 5;
+  return (g);
+}
+
+int main() {
+  int x;
+
+  printf("%d\n", viaptr(&g));
+  printf("%d\n", viaptr(&x));
+  return (0);
+}
@@ -0,0 +1,15 @@
+#include <stdio.h>
+
+// The constant 5 is loaded once and shared by the first
+// and third arguments. More than 16 other constants push
+// it out of the cache, but the subtraction must not then
+// reuse its temporary
+int main() {
+  int a;
+
+  a = 1;
+  printf("%d %d %d\n", 5,
+	 5 - (a + 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 10 + 11 + 12 + 13 +
+	      14 + 15 + 16 + 17 + 18), 5);
+  return (0);
+}
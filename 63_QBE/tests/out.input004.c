@@ -0,0 +1 @@
+5 -167 5
@@ -5,6 +5,13 @@
 // AST tree functions
 // Copyright (c) 2019 Warren Toomey, GPL3
 
+// AST nodes are allocated from this arena. A function's
+// tree is finished with once its code has been generated,
+// so the arena is reset after each function
+/* AST 节点从这个内存池中分配。函数的代码生成之后它的树就没用了，
+所以每个函数之后都重置这个内存池。*/
+static struct arena Astarena;
+
 // Build and return a generic AST node
 /*
 op：表示该节点的操作符（operator）。操作符的值取自一组预定义的常量，用于标识节点表示的具体操作，如加法、减法、赋值等。
@@ -29,15 +36,15 @@ struct ASTnode *mkastnode(int op, int type,
 			  struct symtable *sym, int intvalue) {
   struct ASTnode *n;
 
-  // Malloc a new ASTnode
-  n = (struct ASTnode *) malloc(sizeof(struct ASTnode));
-  if (n == NULL)
-    fatal("Unable to malloc in mkastnode()");
+  // Get a new ASTnode from the AST arena
+  n = (struct ASTnode *) arenaalloc(&Astarena, sizeof(struct ASTnode));
+  Nastnodes++;
 
   // Copy in the field values and return it
   n->op = op;
   n->type = type;
   n->ctype = ctype;
+  n->rvalue = 0;
   n->left = left;
   n->mid = mid;
   n->right = right;
@@ -78,6 +85,11 @@ struct ASTnode *mkastunary(int op, int type,
   return (mkastnode(op, type, ctype, left, NULL, NULL, sym, intvalue));
 }
 
+// Free all the AST nodes built so far
+void freeastnodes(void) {
+  arenareset(&Astarena);
+}
+
 // Generate and return a new label number
 // just for AST dumping purposes
 static int dumpid = 1;
@@ -97,7 +109,8 @@ static char *astname[] = { NULL,
   "FUNCCALL", "DEREF", "ADDR", "SCALE",
   "PREINC", "PREDEC", "POSTINC", "POSTDEC",
   "NEGATE", "INVERT", "LOGNOT", "TOBOOL", "BREAK",
-  "CONTINUE", "SWITCH", "CASE", "DEFAULT", "CAST"
+  "CONTINUE", "SWITCH", "CASE", "DEFAULT", "CAST",
+  "TAILCALL"
 };
 
 // Given an AST tree, print it out and follow the
@@ -157,6 +170,7 @@ void dumpAST(struct ASTnode *n, int label, int level) {
     switch (n->op) {
       case A_FUNCTION:
       case A_FUNCCALL:
+      case A_TAILCALL:
       case A_ADDR:
       case A_PREINC:
       case A_PREDEC: